@@ -0,0 +1,248 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <cuda_runtime.h>
+#include <cusolverRf.h>
+
+#include <resolve/matrix/Csr.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Batched refactorization of same-pattern systems with cusolverRf.
+     *
+     * All systems in the batch share the sparsity pattern of matrix A and
+     * the pivot sequence and factor pattern of one host (KLU) factorization.
+     * Values of all systems are refactorized and solved in a single batched
+     * cusolverRf call sequence, so small systems together can occupy the GPU.
+     *
+     * Usage:
+     * ```
+     *   batch.setup(A, L, U, P, Q, batch_size); // once, on the host
+     *   batch.refactorize(values);              // device value array per system
+     *   batch.solve(x);                         // device rhs/solution per system
+     * ```
+     */
+    class BatchRefactorizationCuda
+    {
+    public:
+      BatchRefactorizationCuda()
+      {
+        cusolverRfCreate(&handle_);
+      }
+
+      ~BatchRefactorizationCuda()
+      {
+        releaseDeviceData();
+        cusolverRfDestroy(handle_);
+      }
+
+      BatchRefactorizationCuda(const BatchRefactorizationCuda&)            = delete;
+      BatchRefactorizationCuda& operator=(const BatchRefactorizationCuda&) = delete;
+
+      /**
+       * @brief Symbolic setup shared by all systems in the batch.
+       *
+       * Calling setup again, e.g. for a new pattern or batch size, releases
+       * the device data and cusolverRf state of the previous setup first.
+       *
+       * @param[in] A          - system matrix, host CSR data is used
+       * @param[in] L          - lower triangular factor, host CSR
+       * @param[in] U          - upper triangular factor, host CSR
+       * @param[in] P          - row permutation of the factorization
+       * @param[in] Q          - column permutation of the factorization
+       * @param[in] batch_size - number of systems in the batch
+       * @return 0 if successful, 1 otherwise
+       */
+      int setup(matrix::Csr* A,
+                matrix::Csr* L,
+                matrix::Csr* U,
+                index_type*  P,
+                index_type*  Q,
+                index_type   batch_size)
+      {
+        if (is_setup_)
+        {
+          // cusolverRf handles cannot be set up twice
+          releaseDeviceData();
+          cusolverRfDestroy(handle_);
+          cusolverRfCreate(&handle_);
+        }
+        is_setup_ = true;
+
+        n_          = A->getNumRows();
+        nnz_        = A->getNnz();
+        batch_size_ = batch_size;
+
+        // Initial values of all systems are those of A
+        std::vector<real_type*> h_values(batch_size_, A->getValues(memory::HOST));
+
+        cusolverRfSetResetValuesFastMode(handle_, CUSOLVERRF_RESET_VALUES_FAST_MODE_ON);
+        cusolverRfSetNumericProperties(handle_, 0.0, 0.0);
+
+        cusolverStatus_t status = cusolverRfBatchSetupHost(batch_size_,
+                                                           n_,
+                                                           nnz_,
+                                                           A->getRowData(memory::HOST),
+                                                           A->getColData(memory::HOST),
+                                                           h_values.data(),
+                                                           L->getNnz(),
+                                                           L->getRowData(memory::HOST),
+                                                           L->getColData(memory::HOST),
+                                                           L->getValues(memory::HOST),
+                                                           U->getNnz(),
+                                                           U->getRowData(memory::HOST),
+                                                           U->getColData(memory::HOST),
+                                                           U->getValues(memory::HOST),
+                                                           P,
+                                                           Q,
+                                                           handle_);
+        if (status != CUSOLVER_STATUS_SUCCESS)
+        {
+          std::cout << "Batched cusolverRf setup failed with status " << status << "\n";
+          return 1;
+        }
+        status = cusolverRfBatchAnalyze(handle_);
+        if (status != CUSOLVER_STATUS_SUCCESS)
+        {
+          std::cout << "Batched cusolverRf analysis failed with status " << status << "\n";
+          return 1;
+        }
+
+        // Device copies of the pattern and permutations used on every refactorization
+        size_t index_size = sizeof(index_type);
+        if (cudaMalloc((void**) &d_row_ptr_, (n_ + 1) * index_size) != cudaSuccess
+            || cudaMalloc((void**) &d_col_idx_, nnz_ * index_size) != cudaSuccess
+            || cudaMalloc((void**) &d_P_, n_ * index_size) != cudaSuccess
+            || cudaMalloc((void**) &d_Q_, n_ * index_size) != cudaSuccess
+            || cudaMalloc((void**) &d_pointers_, batch_size_ * sizeof(real_type*)) != cudaSuccess
+            || cudaMalloc((void**) &d_temp_, 2 * static_cast<size_t>(n_) * batch_size_ * sizeof(real_type)) != cudaSuccess)
+        {
+          std::cout << "Failed to allocate device memory for batched refactorization.\n";
+          return 1;
+        }
+        cudaMemcpy(d_row_ptr_, A->getRowData(memory::HOST), (n_ + 1) * index_size, cudaMemcpyHostToDevice);
+        cudaMemcpy(d_col_idx_, A->getColData(memory::HOST), nnz_ * index_size, cudaMemcpyHostToDevice);
+        cudaMemcpy(d_P_, P, n_ * index_size, cudaMemcpyHostToDevice);
+        cudaMemcpy(d_Q_, Q, n_ * index_size, cudaMemcpyHostToDevice);
+
+        zero_pivots_.resize(batch_size_);
+        return 0;
+      }
+
+      /**
+       * @brief Refactorize all systems in the batch.
+       *
+       * @param[in] values - host array of `batch_size` pointers to device
+       * values of the system matrices (in CSR order of A)
+       * @return 0 if successful, number of systems with a zero pivot or
+       * -1 on a cusolverRf failure otherwise
+       */
+      int refactorize(real_type** values)
+      {
+        cudaMemcpy(d_pointers_, values, batch_size_ * sizeof(real_type*), cudaMemcpyHostToDevice);
+        cusolverStatus_t status = cusolverRfBatchResetValues(batch_size_,
+                                                             n_,
+                                                             nnz_,
+                                                             d_row_ptr_,
+                                                             d_col_idx_,
+                                                             d_pointers_,
+                                                             d_P_,
+                                                             d_Q_,
+                                                             handle_);
+        if (status != CUSOLVER_STATUS_SUCCESS)
+        {
+          std::cout << "Batched cusolverRf value reset failed with status " << status << "\n";
+          return -1;
+        }
+        status = cusolverRfBatchRefactor(handle_);
+        if (status != CUSOLVER_STATUS_SUCCESS)
+        {
+          std::cout << "Batched cusolverRf refactorization failed with status " << status << "\n";
+          return -1;
+        }
+
+        // Report systems where refactorization hit a zero pivot
+        int num_zero_pivots = 0;
+        if (cusolverRfBatchZeroPivot(handle_, zero_pivots_.data()) == CUSOLVER_STATUS_ZERO_PIVOT)
+        {
+          for (index_type k = 0; k < batch_size_; ++k)
+          {
+            if (zero_pivots_[k] >= 0)
+            {
+              std::cout << "System " << k << " has a zero pivot at position " << zero_pivots_[k] << "\n";
+              ++num_zero_pivots;
+            }
+          }
+        }
+        return num_zero_pivots;
+      }
+
+      /**
+       * @brief Solve all systems in the batch in place.
+       *
+       * @param[in,out] x - host array of `batch_size` pointers to device
+       * vectors holding right-hand sides on input and solutions on output
+       * @return 0 if successful, 1 otherwise
+       */
+      int solve(real_type** x)
+      {
+        cudaMemcpy(d_pointers_, x, batch_size_ * sizeof(real_type*), cudaMemcpyHostToDevice);
+        cusolverStatus_t status = cusolverRfBatchSolve(handle_, d_P_, d_Q_, 1, d_temp_, n_, d_pointers_, n_);
+        cudaDeviceSynchronize();
+        if (status != CUSOLVER_STATUS_SUCCESS)
+        {
+          std::cout << "Batched cusolverRf solve failed with status " << status << "\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      /// Number of systems in the batch.
+      index_type getBatchSize() const
+      {
+        return batch_size_;
+      }
+
+    private:
+      /// Free device copies of the pattern, permutations and workspace.
+      void releaseDeviceData()
+      {
+        cudaFree(d_row_ptr_);
+        cudaFree(d_col_idx_);
+        cudaFree(d_P_);
+        cudaFree(d_Q_);
+        cudaFree(d_pointers_);
+        cudaFree(d_temp_);
+        d_row_ptr_  = nullptr;
+        d_col_idx_  = nullptr;
+        d_P_        = nullptr;
+        d_Q_        = nullptr;
+        d_pointers_ = nullptr;
+        d_temp_     = nullptr;
+      }
+
+    private:
+      cusolverRfHandle_t handle_{nullptr};
+      bool               is_setup_{false}; ///< setup was called, possibly failed halfway
+
+      index_type n_{0};
+      index_type nnz_{0};
+      index_type batch_size_{0};
+
+      index_type*  d_row_ptr_{nullptr};  ///< pattern of A on the device
+      index_type*  d_col_idx_{nullptr};  ///< pattern of A on the device
+      index_type*  d_P_{nullptr};        ///< row permutation on the device
+      index_type*  d_Q_{nullptr};        ///< column permutation on the device
+      real_type**  d_pointers_{nullptr}; ///< device array of per-system pointers
+      real_type*   d_temp_{nullptr};     ///< cusolverRf solve workspace
+
+      std::vector<index_type> zero_pivots_;
+    };
+
+  } // namespace examples
+} // namespace ReSolve
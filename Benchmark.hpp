@@ -0,0 +1,408 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <resolve/Common.hpp>
+
+#if defined(RESOLVE_USE_CUDA)
+#include <cuda_runtime.h>
+#elif defined(RESOLVE_USE_HIP)
+#include <hip/hip_runtime.h>
+#endif
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /// Wait for all work on the device to complete (no-op without GPU backend).
+    inline void deviceSynchronize()
+    {
+#if defined(RESOLVE_USE_CUDA)
+      cudaDeviceSynchronize();
+#elif defined(RESOLVE_USE_HIP)
+      hipDeviceSynchronize();
+#endif
+    }
+
+    /**
+     * @brief Wall-clock timer for solver phases.
+     *
+     * The device is synchronized when the timer is started and stopped, so
+     * asynchronous GPU work is attributed to the phase that launched it.
+     */
+    class PhaseTimer
+    {
+    public:
+      /// Start timing a phase.
+      void start()
+      {
+        deviceSynchronize();
+        start_ = std::chrono::steady_clock::now();
+      }
+
+      /// Stop timing and return elapsed time in seconds.
+      double stop()
+      {
+        deviceSynchronize();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+      }
+
+    private:
+      std::chrono::steady_clock::time_point start_;
+    };
+
+    /**
+     * @brief Collects phase timings over repetitions and reports statistics.
+     *
+     * Timings are grouped by system and phase. For each phase an additional
+     * entry (system -1 in the output) holds the time summed over all systems
+     * in a repetition. Statistics are minimum, median, 99th percentile and
+     * mean over the recorded repetitions. Results written as JSON can be
+     * used as a baseline of a later run, see compareWithBaseline().
+     */
+    class BenchmarkRecorder
+    {
+    public:
+      /// Add a key-value pair describing the run to the output.
+      void setInfo(const std::string& key, const std::string& value)
+      {
+        info_.emplace_back(key, value);
+      }
+
+      /// Enable or disable recording (e.g. disable for warmup repetitions).
+      void setRecording(bool is_recording)
+      {
+        is_recording_ = is_recording;
+      }
+
+      /// Start a new repetition of the benchmarked sequence.
+      void beginRepetition()
+      {
+        if (is_recording_)
+        {
+          ++num_repetitions_;
+        }
+      }
+
+      /// Record `seconds` spent in `phase` of system `system`.
+      void record(index_type system, const std::string& phase, double seconds)
+      {
+        if (!is_recording_ || num_repetitions_ == 0)
+        {
+          return;
+        }
+        getEntry(system, phase).samples.push_back(seconds);
+
+        // Accumulate the total over all systems in this repetition
+        std::vector<double>& total = getEntry(-1, phase).samples;
+        total.resize(num_repetitions_, 0.0);
+        total.back() += seconds;
+      }
+
+      /// Record relative residual norm of the solution of system `system`.
+      void setResidual(index_type system, real_type residual)
+      {
+        if (static_cast<size_t>(system) >= residuals_.size())
+        {
+          residuals_.resize(system + 1, 0.0);
+        }
+        residuals_[system] = residual;
+      }
+
+      /// Record number of iterative refinement iterations of system `system`.
+      void setIterations(index_type system, index_type num_iterations)
+      {
+        if (static_cast<size_t>(system) >= iterations_.size())
+        {
+          iterations_.resize(system + 1, 0);
+        }
+        iterations_[system] = num_iterations;
+      }
+
+      /// Print statistics as a table.
+      void printSummary() const
+      {
+        std::cout << std::left << std::setw(8) << "system" << std::setw(24) << "phase"
+                  << std::right << std::setw(8) << "samples" << std::setw(14) << "min [s]"
+                  << std::setw(14) << "median [s]" << std::setw(14) << "p99 [s]" << "\n";
+        for (const Entry& entry : entries_)
+        {
+          Stats stats = computeStats(entry.samples);
+          std::cout << std::left << std::setw(8) << systemLabel(entry.system) << std::setw(24) << entry.phase
+                    << std::right << std::setw(8) << entry.samples.size()
+                    << std::scientific << std::setprecision(3)
+                    << std::setw(14) << stats.min << std::setw(14) << stats.median
+                    << std::setw(14) << stats.p99 << "\n";
+        }
+      }
+
+      /// Write statistics and run information to JSON file `path`.
+      int writeJson(const std::string& path) const
+      {
+        std::ofstream out(path);
+        if (!out.is_open())
+        {
+          std::cout << "Failed to open file " << path << "\n";
+          return 1;
+        }
+        out << std::scientific << std::setprecision(6);
+        out << "{\n";
+        for (const auto& item : info_)
+        {
+          out << "  \"" << item.first << "\": \"" << item.second << "\",\n";
+        }
+        out << "  \"repetitions\": " << num_repetitions_ << ",\n";
+        out << "  \"phases\": [\n";
+        for (size_t k = 0; k < entries_.size(); ++k)
+        {
+          const Entry& entry = entries_[k];
+          Stats        stats = computeStats(entry.samples);
+          out << "    {\"system\": " << entry.system
+              << ", \"phase\": \"" << entry.phase << "\""
+              << ", \"samples\": " << entry.samples.size()
+              << ", \"min\": " << stats.min
+              << ", \"median\": " << stats.median
+              << ", \"p99\": " << stats.p99
+              << ", \"mean\": " << stats.mean << "}"
+              << (k + 1 < entries_.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n";
+        out << "  \"residuals\": [";
+        for (size_t k = 0; k < residuals_.size(); ++k)
+        {
+          out << (k > 0 ? ", " : "") << residuals_[k];
+        }
+        out << "],\n";
+        out << "  \"iterations\": [";
+        for (size_t k = 0; k < iterations_.size(); ++k)
+        {
+          out << (k > 0 ? ", " : "") << iterations_[k];
+        }
+        out << "]\n";
+        out << "}\n";
+        return 0;
+      }
+
+      /// Write statistics to CSV file `path`.
+      int writeCsv(const std::string& path) const
+      {
+        std::ofstream out(path);
+        if (!out.is_open())
+        {
+          std::cout << "Failed to open file " << path << "\n";
+          return 1;
+        }
+        out << std::scientific << std::setprecision(6);
+        out << "system,phase,samples,min,median,p99,mean\n";
+        for (const Entry& entry : entries_)
+        {
+          Stats stats = computeStats(entry.samples);
+          out << entry.system << "," << entry.phase << "," << entry.samples.size() << ","
+              << stats.min << "," << stats.median << "," << stats.p99 << "," << stats.mean << "\n";
+        }
+        return 0;
+      }
+
+      /**
+       * @brief Compare results with a baseline written by writeJson().
+       *
+       * For each phase of the baseline, the median time summed over all
+       * systems is compared, as per-system timings are too noisy for a pass
+       * or fail decision. Phases with baseline median below `min_time` are
+       * reported but not checked. Iterative refinement iterations are
+       * compared for each system, since more iterations mean a less accurate
+       * refactorization even if it got faster.
+       *
+       * @param[in] path                - baseline JSON file
+       * @param[in] time_tolerance      - allowed relative slowdown, e.g. 0.2 for 20%
+       * @param[in] iteration_tolerance - allowed additional iterations per system
+       * @param[in] min_time            - shortest baseline median [s] that is checked
+       * @return number of regressions, -1 if the baseline cannot be read
+       */
+      int compareWithBaseline(const std::string& path,
+                              double             time_tolerance,
+                              index_type         iteration_tolerance,
+                              double             min_time) const
+      {
+        std::ifstream in(path);
+        if (!in.is_open())
+        {
+          std::cout << "Failed to open baseline file " << path << "\n";
+          return -1;
+        }
+
+        // Files written by writeJson() have one phase entry per line
+        std::vector<std::pair<std::string, double>> baseline_medians;
+        std::vector<index_type>                     baseline_iterations;
+        std::string                                 line;
+        while (std::getline(in, line))
+        {
+          int    system = 0;
+          char   phase[64];
+          double median = 0.0;
+          if (std::sscanf(line.c_str(),
+                          " {\"system\": %d, \"phase\": \"%63[^\"]\", \"samples\": %*d, \"min\": %*f, \"median\": %lf",
+                          &system,
+                          phase,
+                          &median)
+              == 3)
+          {
+            if (system < 0)
+            {
+              baseline_medians.emplace_back(phase, median);
+            }
+          }
+          else if (line.find("\"iterations\": [") != std::string::npos)
+          {
+            std::istringstream list(line.substr(line.find('[') + 1));
+            std::string        item;
+            while (std::getline(list, item, ','))
+            {
+              if (item.find_first_of("0123456789") != std::string::npos)
+              {
+                baseline_iterations.push_back(static_cast<index_type>(std::stol(item)));
+              }
+            }
+          }
+        }
+        if (baseline_medians.empty())
+        {
+          std::cout << "No phase timings found in baseline file " << path << "\n";
+          return -1;
+        }
+
+        int num_regressions = 0;
+        std::cout << std::left << std::setw(24) << "phase" << std::right << std::setw(16) << "baseline [s]"
+                  << std::setw(16) << "current [s]" << std::setw(10) << "ratio" << "  status\n";
+        for (const auto& item : baseline_medians)
+        {
+          const Entry* entry = findEntry(-1, item.first);
+          std::cout << std::left << std::setw(24) << item.first << std::right
+                    << std::scientific << std::setprecision(3) << std::setw(16) << item.second;
+          if (entry == nullptr)
+          {
+            std::cout << std::setw(16) << "-" << std::setw(10) << "-" << "  missing\n";
+            ++num_regressions;
+            continue;
+          }
+          double median     = computeStats(entry->samples).median;
+          double ratio      = (item.second > 0.0) ? median / item.second : 1.0;
+          bool   is_checked = (item.second >= min_time);
+          bool   is_slower  = is_checked && (ratio > 1.0 + time_tolerance);
+          std::cout << std::setw(16) << median << std::fixed << std::setprecision(2) << std::setw(10) << ratio
+                    << (is_slower ? "  REGRESSION\n" : (is_checked ? "  ok\n" : "  not checked\n"));
+          num_regressions += is_slower ? 1 : 0;
+        }
+
+        if (baseline_iterations.size() != iterations_.size())
+        {
+          std::cout << "Iterations recorded for " << iterations_.size() << " systems, baseline has "
+                    << baseline_iterations.size() << ".\n";
+          ++num_regressions;
+        }
+        else
+        {
+          for (size_t k = 0; k < iterations_.size(); ++k)
+          {
+            if (iterations_[k] > baseline_iterations[k] + iteration_tolerance)
+            {
+              std::cout << "System " << k << ": " << iterations_[k] << " iterations, baseline "
+                        << baseline_iterations[k] << "  REGRESSION\n";
+              ++num_regressions;
+            }
+          }
+        }
+        return num_regressions;
+      }
+
+    private:
+      /// Timings of one phase of one system.
+      struct Entry
+      {
+        index_type          system;
+        std::string         phase;
+        std::vector<double> samples;
+      };
+
+      struct Stats
+      {
+        double min{0.0};
+        double median{0.0};
+        double p99{0.0};
+        double mean{0.0};
+      };
+
+      Entry& getEntry(index_type system, const std::string& phase)
+      {
+        for (Entry& entry : entries_)
+        {
+          if (entry.system == system && entry.phase == phase)
+          {
+            return entry;
+          }
+        }
+        entries_.push_back({system, phase, {}});
+        return entries_.back();
+      }
+
+      const Entry* findEntry(index_type system, const std::string& phase) const
+      {
+        for (const Entry& entry : entries_)
+        {
+          if (entry.system == system && entry.phase == phase)
+          {
+            return &entry;
+          }
+        }
+        return nullptr;
+      }
+
+      static std::string systemLabel(index_type system)
+      {
+        return system < 0 ? std::string("all") : std::to_string(system);
+      }
+
+      /// Statistics of `samples`; percentiles use the nearest-rank method.
+      static Stats computeStats(std::vector<double> samples)
+      {
+        Stats stats;
+        if (samples.empty())
+        {
+          return stats;
+        }
+        std::sort(samples.begin(), samples.end());
+        size_t size = samples.size();
+        stats.min   = samples.front();
+        stats.median = (size % 2 == 1) ? samples[size / 2] : 0.5 * (samples[size / 2 - 1] + samples[size / 2]);
+        size_t rank  = static_cast<size_t>(std::ceil(0.99 * static_cast<double>(size)));
+        stats.p99    = samples[std::max<size_t>(rank, 1) - 1];
+        for (double sample : samples)
+        {
+          stats.mean += sample;
+        }
+        stats.mean /= static_cast<double>(size);
+        return stats;
+      }
+
+    private:
+      std::vector<std::pair<std::string, std::string>> info_;
+      std::vector<Entry>                               entries_;
+      std::vector<real_type>                           residuals_;
+      std::vector<index_type>                          iterations_;
+
+      index_type num_repetitions_{0};
+      bool       is_recording_{true};
+    };
+
+  } // namespace examples
+} // namespace ReSolve
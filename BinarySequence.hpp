@@ -0,0 +1,487 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/vector/Vector.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Header of a binary linear system sequence file.
+     *
+     * The file stores the CSR sparsity pattern of the system matrix once,
+     * followed by one block per system consisting of the matrix values and
+     * the right-hand side vector. All blocks are 64-byte aligned so that the
+     * file can be memory-mapped and the data copied directly into a
+     * `matrix::Csr` or `vector::Vector` without any parsing.
+     *
+     * Layout:
+     * ```
+     *   [header][row_ptr (n+1)][col_idx (nnz)]
+     *   [values_0 (nnz)][rhs_0 (n)] ... [values_k (nnz)][rhs_k (n)]
+     * ```
+     */
+    struct BinarySequenceHeader
+    {
+      char     magic[8];     ///< File signature "RSBSEQ01"
+      uint32_t index_size;   ///< sizeof(index_type) used to write the file
+      uint32_t real_size;    ///< sizeof(real_type) used to write the file
+      uint32_t flags;        ///< bit 0: symmetric, bit 1: expanded
+      uint32_t reserved;     ///< Padding, always zero
+      int64_t  num_rows;     ///< Number of matrix rows
+      int64_t  num_columns;  ///< Number of matrix columns
+      int64_t  nnz;          ///< Number of stored nonzeros
+      int64_t  num_systems;  ///< Number of value/rhs blocks in the file
+      int64_t  data_offset;  ///< Byte offset of the first value block
+      int64_t  step_stride;  ///< Bytes between consecutive value blocks
+      int64_t  rhs_offset;   ///< Byte offset of rhs within a block
+      int64_t  pattern_size; ///< Bytes used by row_ptr + col_idx
+    };
+
+    namespace binary_sequence
+    {
+      static constexpr char    MAGIC[8]  = {'R', 'S', 'B', 'S', 'E', 'Q', '0', '1'};
+      static constexpr int64_t ALIGNMENT = 64;
+
+      static constexpr uint32_t SYMMETRIC = 1;
+      static constexpr uint32_t EXPANDED  = 2;
+
+      /// Round `bytes` up to the block alignment.
+      inline int64_t align(int64_t bytes)
+      {
+        return ((bytes + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+      }
+    } // namespace binary_sequence
+
+    /**
+     * @brief Writes a sequence of linear systems with the same sparsity
+     * pattern to a binary sequence file.
+     *
+     * Typical use is converting a family of Matrix Market files:
+     * ```
+     *   BinarySequenceWriter writer;
+     *   writer.open(pathname, A);
+     *   for each system: writer.append(A, rhs);
+     *   writer.close();
+     * ```
+     * Data is always taken from the host memory space.
+     */
+    class BinarySequenceWriter
+    {
+    public:
+      BinarySequenceWriter() = default;
+
+      ~BinarySequenceWriter()
+      {
+        close();
+      }
+
+      /**
+       * @brief Create the file and write the sparsity pattern of `A`.
+       *
+       * @param[in] pathname - output file name
+       * @param[in] A        - matrix defining the sparsity pattern
+       * @return 0 if successful, 1 otherwise
+       */
+      int open(const std::string& pathname, matrix::Csr* A)
+      {
+        using namespace binary_sequence;
+
+        file_ = std::fopen(pathname.c_str(), "wb");
+        if (file_ == nullptr)
+        {
+          std::cout << "Failed to open file " << pathname << " for writing.\n";
+          return 1;
+        }
+
+        const index_type n   = A->getNumRows();
+        const index_type nnz = A->getNnz();
+
+        std::memset(&header_, 0, sizeof(header_));
+        std::memcpy(header_.magic, MAGIC, sizeof(MAGIC));
+        header_.index_size   = sizeof(index_type);
+        header_.real_size    = sizeof(real_type);
+        header_.flags        = (A->symmetric() ? SYMMETRIC : 0) | (A->expanded() ? EXPANDED : 0);
+        header_.num_rows     = n;
+        header_.num_columns  = A->getNumColumns();
+        header_.nnz          = nnz;
+        header_.num_systems  = 0;
+        header_.pattern_size = static_cast<int64_t>(n + 1 + nnz) * sizeof(index_type);
+        header_.data_offset  = align(align(sizeof(header_)) + header_.pattern_size);
+        header_.rhs_offset   = align(static_cast<int64_t>(nnz) * sizeof(real_type));
+        header_.step_stride  = header_.rhs_offset + align(static_cast<int64_t>(n) * sizeof(real_type));
+
+        // Keep a copy of the pattern to verify appended systems against it
+        const index_type* row_ptr = A->getRowData(memory::HOST);
+        const index_type* col_idx = A->getColData(memory::HOST);
+        row_ptr_.assign(row_ptr, row_ptr + n + 1);
+        col_idx_.assign(col_idx, col_idx + nnz);
+
+        int status = writeAt(0, &header_, sizeof(header_));
+        status += writeAt(align(sizeof(header_)), row_ptr_.data(), row_ptr_.size() * sizeof(index_type));
+        status += writeAt(align(sizeof(header_)) + static_cast<int64_t>(row_ptr_.size() * sizeof(index_type)),
+                          col_idx_.data(),
+                          col_idx_.size() * sizeof(index_type));
+        return status == 0 ? 0 : 1;
+      }
+
+      /**
+       * @brief Append values of `A` and right-hand side `rhs` as a new system.
+       *
+       * @pre `A` has the same sparsity pattern as the matrix passed to open().
+       *
+       * @return 0 if successful, 1 otherwise
+       */
+      int append(matrix::Csr* A, vector::Vector* rhs)
+      {
+        if (file_ == nullptr)
+        {
+          std::cout << "Binary sequence file is not open.\n";
+          return 1;
+        }
+        if (!isSamePattern(A))
+        {
+          std::cout << "Sparsity pattern of system " << header_.num_systems
+                    << " differs from the first system in the sequence.\n";
+          return 1;
+        }
+        if (rhs->getSize() != header_.num_rows)
+        {
+          std::cout << "Right-hand side size does not match the matrix size.\n";
+          return 1;
+        }
+
+        const int64_t offset = header_.data_offset + header_.num_systems * header_.step_stride;
+
+        int status = writeAt(offset,
+                             A->getValues(memory::HOST),
+                             static_cast<size_t>(header_.nnz) * sizeof(real_type));
+        status += writeAt(offset + header_.rhs_offset,
+                          rhs->getData(memory::HOST),
+                          static_cast<size_t>(header_.num_rows) * sizeof(real_type));
+        if (status != 0)
+        {
+          return 1;
+        }
+        ++header_.num_systems;
+        return 0;
+      }
+
+      /**
+       * @brief Finalize the header (number of systems) and close the file.
+       *
+       * @return 0 if successful, 1 otherwise
+       */
+      int close()
+      {
+        if (file_ == nullptr)
+        {
+          return 0;
+        }
+        // Pad the file so that the last rhs block is fully aligned
+        int64_t end = header_.data_offset + header_.num_systems * header_.step_stride;
+        int     status = 0;
+        if (header_.num_systems > 0)
+        {
+          char zero = 0;
+          status += writeAt(end - 1, &zero, 1);
+        }
+        status += writeAt(0, &header_, sizeof(header_));
+        std::fclose(file_);
+        file_ = nullptr;
+        return status == 0 ? 0 : 1;
+      }
+
+      /// Number of systems written so far.
+      index_type getNumSystems() const
+      {
+        return static_cast<index_type>(header_.num_systems);
+      }
+
+    private:
+      int writeAt(int64_t offset, const void* data, size_t bytes)
+      {
+        if (std::fseek(file_, static_cast<long>(offset), SEEK_SET) != 0)
+        {
+          std::cout << "Failed to seek in binary sequence file.\n";
+          return 1;
+        }
+        if (std::fwrite(data, 1, bytes, file_) != bytes)
+        {
+          std::cout << "Failed to write to binary sequence file.\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      bool isSamePattern(matrix::Csr* A)
+      {
+        if (A->getNumRows() != header_.num_rows || A->getNnz() != header_.nnz)
+        {
+          return false;
+        }
+        const index_type* row_ptr = A->getRowData(memory::HOST);
+        const index_type* col_idx = A->getColData(memory::HOST);
+        return std::memcmp(row_ptr, row_ptr_.data(), row_ptr_.size() * sizeof(index_type)) == 0
+            && std::memcmp(col_idx, col_idx_.data(), col_idx_.size() * sizeof(index_type)) == 0;
+      }
+
+    private:
+      std::FILE*              file_{nullptr};
+      BinarySequenceHeader    header_;
+      std::vector<index_type> row_ptr_;
+      std::vector<index_type> col_idx_;
+    };
+
+    /**
+     * @brief Memory-mapped reader for binary linear system sequence files.
+     *
+     * The file is mapped read-only, so updating a matrix or a vector is just
+     * a copy from the mapping into the existing data arrays.
+     */
+    class BinarySequenceReader
+    {
+    public:
+      BinarySequenceReader() = default;
+
+      ~BinarySequenceReader()
+      {
+        close();
+      }
+
+      BinarySequenceReader(const BinarySequenceReader&)            = delete;
+      BinarySequenceReader& operator=(const BinarySequenceReader&) = delete;
+
+      /**
+       * @brief Map the binary sequence file and validate its header.
+       *
+       * @param[in] pathname - binary sequence file name
+       * @return 0 if successful, 1 otherwise
+       */
+      int open(const std::string& pathname)
+      {
+        using namespace binary_sequence;
+
+        close();
+        int fd = ::open(pathname.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+          std::cout << "Failed to open file " << pathname << "\n";
+          return 1;
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size < static_cast<off_t>(sizeof(BinarySequenceHeader)))
+        {
+          std::cout << "File " << pathname << " is not a binary sequence file.\n";
+          ::close(fd);
+          return 1;
+        }
+        map_size_ = static_cast<size_t>(file_stat.st_size);
+        void* map = mmap(nullptr, map_size_, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+          std::cout << "Failed to map file " << pathname << "\n";
+          map_size_ = 0;
+          return 1;
+        }
+        map_    = static_cast<const char*>(map);
+        header_ = reinterpret_cast<const BinarySequenceHeader*>(map_);
+
+        if (std::memcmp(header_->magic, MAGIC, sizeof(MAGIC)) != 0)
+        {
+          std::cout << "File " << pathname << " is not a binary sequence file.\n";
+          close();
+          return 1;
+        }
+        if (header_->index_size != sizeof(index_type) || header_->real_size != sizeof(real_type))
+        {
+          std::cout << "File " << pathname << " was written with different index or real type sizes.\n";
+          close();
+          return 1;
+        }
+        int64_t expected_size = header_->data_offset + header_->num_systems * header_->step_stride;
+        if (static_cast<int64_t>(map_size_) < expected_size)
+        {
+          std::cout << "File " << pathname << " is truncated.\n";
+          close();
+          return 1;
+        }
+        return 0;
+      }
+
+      /// Unmap the file.
+      void close()
+      {
+        if (map_ != nullptr)
+        {
+          munmap(const_cast<char*>(map_), map_size_);
+        }
+        map_      = nullptr;
+        header_   = nullptr;
+        map_size_ = 0;
+      }
+
+      index_type getNumRows() const
+      {
+        return static_cast<index_type>(header_->num_rows);
+      }
+
+      index_type getNumColumns() const
+      {
+        return static_cast<index_type>(header_->num_columns);
+      }
+
+      index_type getNnz() const
+      {
+        return static_cast<index_type>(header_->nnz);
+      }
+
+      index_type getNumSystems() const
+      {
+        return static_cast<index_type>(header_->num_systems);
+      }
+
+      bool symmetric() const
+      {
+        return header_->flags & binary_sequence::SYMMETRIC;
+      }
+
+      bool expanded() const
+      {
+        return header_->flags & binary_sequence::EXPANDED;
+      }
+
+      /// Pointer to the (mapped) CSR row pointers.
+      const index_type* getRowData() const
+      {
+        return reinterpret_cast<const index_type*>(map_ + binary_sequence::align(sizeof(BinarySequenceHeader)));
+      }
+
+      /// Pointer to the (mapped) CSR column indices.
+      const index_type* getColData() const
+      {
+        return getRowData() + header_->num_rows + 1;
+      }
+
+      /// Pointer to the (mapped) matrix values of system `i`.
+      const real_type* getValues(index_type i) const
+      {
+        return reinterpret_cast<const real_type*>(map_ + blockOffset(i));
+      }
+
+      /// Pointer to the (mapped) right-hand side of system `i`.
+      const real_type* getRhs(index_type i) const
+      {
+        return reinterpret_cast<const real_type*>(map_ + blockOffset(i) + header_->rhs_offset);
+      }
+
+      /// Hint the kernel to start paging in the data block of system `i`.
+      void prefetch(index_type i) const
+      {
+        if (i < 0 || i >= getNumSystems())
+        {
+          return;
+        }
+        madvise(const_cast<char*>(map_ + blockOffset(i)),
+                static_cast<size_t>(header_->step_stride),
+                MADV_WILLNEED);
+      }
+
+      /**
+       * @brief Create a new CSR matrix from system `i` (host memory).
+       *
+       * @return pointer to the new matrix, nullptr if `i` is out of range
+       */
+      matrix::Csr* createCsr(index_type i) const
+      {
+        if (!isValidSystem(i))
+        {
+          return nullptr;
+        }
+        matrix::Csr* A = new matrix::Csr(getNumRows(), getNumColumns(), getNnz(), symmetric(), expanded());
+        A->copyDataFrom(getRowData(), getColData(), getValues(i), memory::HOST, memory::HOST);
+        return A;
+      }
+
+      /**
+       * @brief Create a new vector from the right-hand side of system `i`.
+       *
+       * @return pointer to the new vector, nullptr if `i` is out of range
+       */
+      vector::Vector* createVector(index_type i) const
+      {
+        if (!isValidSystem(i))
+        {
+          return nullptr;
+        }
+        vector::Vector* vec = new vector::Vector(getNumRows());
+        vec->copyDataFrom(getRhs(i), memory::HOST, memory::HOST);
+        return vec;
+      }
+
+      /**
+       * @brief Copy values of system `i` into matrix `A`.
+       *
+       * @param[in]     i        - system index
+       * @param[in,out] A        - matrix with the same sparsity pattern
+       * @param[in]     memspace - memory space where to copy the values
+       * @return 0 if successful, 1 otherwise
+       */
+      int updateMatrix(index_type i, matrix::Csr* A, memory::MemorySpace memspace = memory::HOST) const
+      {
+        if (!isValidSystem(i) || A->getNnz() != getNnz())
+        {
+          std::cout << "Cannot update matrix from system " << i << " of the binary sequence.\n";
+          return 1;
+        }
+        return A->copyValues(getValues(i), memory::HOST, memspace);
+      }
+
+      /**
+       * @brief Copy right-hand side of system `i` into vector `vec`.
+       *
+       * @return 0 if successful, 1 otherwise
+       */
+      int updateVector(index_type i, vector::Vector* vec, memory::MemorySpace memspace = memory::HOST) const
+      {
+        if (!isValidSystem(i) || vec->getSize() != getNumRows())
+        {
+          std::cout << "Cannot update vector from system " << i << " of the binary sequence.\n";
+          return 1;
+        }
+        return vec->copyDataFrom(getRhs(i), memory::HOST, memspace);
+      }
+
+    private:
+      int64_t blockOffset(index_type i) const
+      {
+        return header_->data_offset + static_cast<int64_t>(i) * header_->step_stride;
+      }
+
+      bool isValidSystem(index_type i) const
+      {
+        return (map_ != nullptr) && (i >= 0) && (i < getNumSystems());
+      }
+
+    private:
+      const char*                 map_{nullptr};
+      const BinarySequenceHeader* header_{nullptr};
+      size_t                      map_size_{0};
+    };
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+#include <resolve/matrix/MatrixHandler.hpp>
+#include <resolve/matrix/Sparse.hpp>
+#include <resolve/vector/Vector.hpp>
+#include <resolve/vector/VectorHandler.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Warm start for iterative refinement from past corrections.
+     *
+     * Stores the corrections computed by iterative refinement for the last
+     * few systems in a sequence. Before the next system is refined, the
+     * initial guess is improved by the minimal residual combination of the
+     * stored corrections,
+     *
+     *   x0 = x + Z*y,  y = argmin || b - A*x - A*Z*y ||,
+     *
+     * where the columns of Z are the stored corrections. For slowly
+     * varying sequences the error left by the refactorization solver is
+     * dominated by the same modes from one system to the next, so FGMRES
+     * starts with a residual from which these modes are already removed.
+     *
+     * Usage:
+     * ```
+     *   recycler.warmStart(A, vec_rhs, vec_x);
+     *   FGMRES.solve(vec_rhs, vec_x);
+     *   recycler.record(vec_x);
+     * ```
+     *
+     * @note The warm start costs one matrix-vector product per stored
+     * correction and a few dot products; the small least squares problem
+     * is solved on the host.
+     */
+    class CorrectionRecycler
+    {
+    public:
+      using vector_type = vector::Vector;
+
+      /**
+       * @brief Constructor
+       *
+       * @param[in] matrix_handler  - handler for matrix-vector products
+       * @param[in] vector_handler  - handler for vector operations
+       * @param[in] max_corrections - number of corrections to keep
+       * @param[in] memspace        - memory space of system vectors
+       */
+      CorrectionRecycler(MatrixHandler*      matrix_handler,
+                         VectorHandler*      vector_handler,
+                         index_type          max_corrections,
+                         memory::MemorySpace memspace)
+        : matrix_handler_(matrix_handler),
+          vector_handler_(vector_handler),
+          max_corrections_(max_corrections),
+          memspace_(memspace)
+      {
+      }
+
+      ~CorrectionRecycler()
+      {
+        clear();
+      }
+
+      CorrectionRecycler(const CorrectionRecycler&)            = delete;
+      CorrectionRecycler& operator=(const CorrectionRecycler&) = delete;
+
+      /**
+       * @brief Improve initial guess `x` of A*x = rhs with stored corrections.
+       *
+       * @param[in]     A   - system matrix
+       * @param[in]     rhs - right-hand side
+       * @param[in,out] x   - initial guess, improved on output
+       * @return 0 if successful, 1 if the stored corrections were not usable
+       * (x is unchanged in that case)
+       *
+       * @post x on input is remembered, so record() can extract the
+       * correction computed by the iterative solver.
+       */
+      int warmStart(matrix::Sparse* A, vector_type* rhs, vector_type* x)
+      {
+        index_type n = x->getSize();
+        if (n != n_)
+        {
+          allocate(n);
+        }
+        x_start_->copyDataFrom(x, memspace_, memspace_);
+        if (num_corrections_ == 0)
+        {
+          return 0;
+        }
+
+        // r = rhs - A*x and w_j = A*z_j
+        r_->copyDataFrom(rhs, memspace_, memspace_);
+        matrix_handler_->matvec(A, x, r_, &constants::MINUS_ONE, &constants::ONE, memspace_);
+        index_type m = num_corrections_;
+        for (index_type j = 0; j < m; ++j)
+        {
+          matrix_handler_->matvec(A, Z_[j], W_[j], &constants::ONE, &constants::ZERO, memspace_);
+        }
+
+        // Normal equations (W^T W) y = W^T r
+        gram_.assign(m * m, 0.0);
+        coef_.assign(m, 0.0);
+        for (index_type j = 0; j < m; ++j)
+        {
+          coef_[j] = vector_handler_->dot(W_[j], r_, memspace_);
+          for (index_type k = 0; k <= j; ++k)
+          {
+            real_type g      = vector_handler_->dot(W_[j], W_[k], memspace_);
+            gram_[j * m + k] = g;
+            gram_[k * m + j] = g;
+          }
+        }
+        if (solveNormalEquations(m) != 0)
+        {
+          std::cout << "Stored corrections are linearly dependent, skipping warm start.\n";
+          return 1;
+        }
+
+        for (index_type j = 0; j < m; ++j)
+        {
+          vector_handler_->axpy(&coef_[j], Z_[j], x, memspace_);
+        }
+        return 0;
+      }
+
+      /**
+       * @brief Store the correction x - x0 computed since the last warmStart().
+       *
+       * @param[in] x - refined solution
+       */
+      void record(vector_type* x)
+      {
+        if (n_ != x->getSize() || max_corrections_ <= 0)
+        {
+          return;
+        }
+        vector_type* z = Z_[next_];
+        z->copyDataFrom(x, memspace_, memspace_);
+        vector_handler_->axpy(&constants::MINUS_ONE, x_start_, z, memspace_);
+
+        // Scale to unit norm to keep the normal equations well conditioned
+        real_type norm = std::sqrt(vector_handler_->dot(z, z, memspace_));
+        if (!(norm > 0.0) || !std::isfinite(norm))
+        {
+          return;
+        }
+        real_type scale = 1.0 / norm;
+        vector_handler_->scal(&scale, z, memspace_);
+
+        next_ = (next_ + 1) % max_corrections_;
+        if (num_corrections_ < max_corrections_)
+        {
+          ++num_corrections_;
+        }
+      }
+
+      /// Forget stored corrections, e.g. when the sparsity pattern changes.
+      void reset()
+      {
+        num_corrections_ = 0;
+        next_            = 0;
+      }
+
+      /// Number of corrections currently used for the warm start.
+      index_type getNumCorrections() const
+      {
+        return num_corrections_;
+      }
+
+    private:
+      void allocate(index_type n)
+      {
+        clear();
+        n_        = n;
+        x_start_  = new vector_type(n);
+        r_        = new vector_type(n);
+        x_start_->allocate(memspace_);
+        r_->allocate(memspace_);
+        for (index_type j = 0; j < max_corrections_; ++j)
+        {
+          Z_.push_back(new vector_type(n));
+          W_.push_back(new vector_type(n));
+          Z_.back()->allocate(memspace_);
+          W_.back()->allocate(memspace_);
+        }
+      }
+
+      void clear()
+      {
+        for (vector_type* z : Z_)
+        {
+          delete z;
+        }
+        for (vector_type* w : W_)
+        {
+          delete w;
+        }
+        Z_.clear();
+        W_.clear();
+        delete x_start_;
+        delete r_;
+        x_start_ = nullptr;
+        r_       = nullptr;
+        n_       = 0;
+        reset();
+      }
+
+      /// Cholesky solve of gram_ * y = coef_ in place, 1 if not positive definite.
+      int solveNormalEquations(index_type m)
+      {
+        for (index_type j = 0; j < m; ++j)
+        {
+          real_type d = gram_[j * m + j];
+          for (index_type k = 0; k < j; ++k)
+          {
+            d -= gram_[j * m + k] * gram_[j * m + k];
+          }
+          if (!(d > 1e-14 * gram_[j * m + j]))
+          {
+            return 1;
+          }
+          d                = std::sqrt(d);
+          gram_[j * m + j] = d;
+          for (index_type i = j + 1; i < m; ++i)
+          {
+            real_type s = gram_[i * m + j];
+            for (index_type k = 0; k < j; ++k)
+            {
+              s -= gram_[i * m + k] * gram_[j * m + k];
+            }
+            gram_[i * m + j] = s / d;
+          }
+        }
+        for (index_type i = 0; i < m; ++i)
+        {
+          for (index_type k = 0; k < i; ++k)
+          {
+            coef_[i] -= gram_[i * m + k] * coef_[k];
+          }
+          coef_[i] /= gram_[i * m + i];
+        }
+        for (index_type i = m - 1; i >= 0; --i)
+        {
+          for (index_type k = i + 1; k < m; ++k)
+          {
+            coef_[i] -= gram_[k * m + i] * coef_[k];
+          }
+          coef_[i] /= gram_[i * m + i];
+        }
+        return 0;
+      }
+
+    private:
+      MatrixHandler* matrix_handler_{nullptr};
+      VectorHandler* vector_handler_{nullptr};
+
+      index_type          max_corrections_{0}; ///< capacity of the correction store
+      index_type          num_corrections_{0}; ///< number of stored corrections
+      index_type          next_{0};            ///< slot for the next correction
+      index_type          n_{0};               ///< size of system vectors
+      memory::MemorySpace memspace_;
+
+      std::vector<vector_type*> Z_;                ///< stored corrections (unit norm)
+      std::vector<vector_type*> W_;                ///< A times stored corrections
+      vector_type*              x_start_{nullptr}; ///< initial guess before warm start
+      vector_type*              r_{nullptr};       ///< residual of the initial guess
+
+      std::vector<real_type> gram_; ///< normal equations matrix and its factor
+      std::vector<real_type> coef_; ///< right-hand side and combination weights
+    };
+
+  } // namespace examples
+} // namespace ReSolve
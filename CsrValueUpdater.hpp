@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <iostream>
+#include <istream>
+#include <string>
+#include <vector>
+
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/io.hpp>
+
+#include "MatrixMarketReader.hpp"
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Fast value-only update of a CSR matrix from Matrix Market files.
+     *
+     * When a series of matrices has a fixed sparsity pattern, the position
+     * of each file entry in the CSR value array is the same for all matrices
+     * in the series. This class records that scatter map (including positions
+     * of mirrored entries of expanded symmetric matrices) once and then
+     * updates the values in a single pass over the file, without building
+     * a COO matrix, sorting, or allocating memory. Numbers are parsed with
+     * the `std::from_chars` based parsers of MatrixMarketReader.
+     *
+     * Entry coordinates are hashed during each update. If the map has not
+     * been set up, or the file entries differ from those the map was built
+     * for, update() falls back to `io::updateMatrixFromFile`, rebuilds the
+     * map for the new pattern and returns PATTERN_CHANGED, so that callers
+     * holding state for the old pattern can tell.
+     */
+    class CsrValueUpdater
+    {
+    public:
+      /// update() status when `A` was read with a new sparsity pattern
+      static constexpr int PATTERN_CHANGED = 2;
+
+      CsrValueUpdater() = default;
+
+      /**
+       * @brief Record positions of file entries in the CSR matrix `A`.
+       *
+       * @param[in] file - Matrix Market file from which `A` was created
+       * @param[in] A    - CSR matrix created from `file`
+       * @return 0 if successful, 1 if the file does not match `A`
+       *
+       * @pre `file` is positioned at the start of the Matrix Market file.
+       */
+      int setup(std::istream& file, matrix::Csr* A)
+      {
+        is_setup_ = false;
+        if (readFile(file) != 0)
+        {
+          return 1;
+        }
+
+        const char* p         = buffer_.c_str();
+        const char* end       = p + buffer_.size();
+        index_type  n         = 0;
+        index_type  m         = 0;
+        index_type  nnz       = 0;
+        bool        symmetric = false;
+        if (parseHeader(p, end, n, m, nnz, symmetric) != 0)
+        {
+          return 1;
+        }
+        if (n != A->getNumRows() || m != A->getNumColumns())
+        {
+          std::cout << "Matrix file does not match the matrix size.\n";
+          return 1;
+        }
+
+        const index_type* row_ptr   = A->getRowData(memory::HOST);
+        const index_type* col_idx   = A->getColData(memory::HOST);
+        bool              is_sorted = isSorted(row_ptr, col_idx, n);
+        bool              is_mirror = symmetric && A->expanded();
+
+        slot_.resize(nnz);
+        mirror_.resize(nnz);
+        std::uint64_t hash = HASH_SEED;
+        for (index_type k = 0; k < nnz; ++k)
+        {
+          hashToken(hashToken(p, hash), hash);
+          index_type row   = 0;
+          index_type col   = 0;
+          real_type  value = 0.0;
+          if (MatrixMarketReader::parseIndex(p, end, row) != 0
+              || MatrixMarketReader::parseIndex(p, end, col) != 0
+              || MatrixMarketReader::parseReal(p, end, value) != 0
+              || row < 1 || row > n || col < 1 || col > m)
+          {
+            std::cout << "Failed to parse entry " << k << " of the matrix file.\n";
+            return 1;
+          }
+          --row;
+          --col;
+
+          slot_[k]   = findSlot(row_ptr, col_idx, row, col, is_sorted);
+          mirror_[k] = (is_mirror && row != col) ? findSlot(row_ptr, col_idx, col, row, is_sorted) : -1;
+          if (slot_[k] < 0 || (is_mirror && row != col && mirror_[k] < 0))
+          {
+            std::cout << "Matrix file entry (" << row + 1 << ", " << col + 1
+                      << ") is not in the matrix sparsity pattern.\n";
+            return 1;
+          }
+        }
+
+        num_entries_ = nnz;
+        entry_hash_  = hash;
+        is_setup_    = true;
+        return 0;
+      }
+
+      /// True if the scatter map has been successfully set up.
+      bool isSetup() const
+      {
+        return is_setup_;
+      }
+
+      /**
+       * @brief Update values of `A` from Matrix Market file `file`.
+       *
+       * @param[in]     file - Matrix Market file with the same pattern as `A`
+       * @param[in,out] A    - CSR matrix to update
+       * @return 0 if only values changed, PATTERN_CHANGED if the sparsity
+       * pattern of `A` was replaced with the one in `file` (or could not be
+       * compared, because the map was not set up), 1 on error
+       *
+       * @post Host data of `A` is updated.
+       */
+      int update(std::istream& file, matrix::Csr* A)
+      {
+        if (!is_setup_)
+        {
+          return reload(file, A);
+        }
+        if (readFile(file) != 0)
+        {
+          return 1;
+        }
+
+        const char* p         = buffer_.c_str();
+        const char* end       = p + buffer_.size();
+        index_type  n         = 0;
+        index_type  m         = 0;
+        index_type  nnz       = 0;
+        bool        symmetric = false;
+        if (parseHeader(p, end, n, m, nnz, symmetric) != 0)
+        {
+          return 1;
+        }
+        if (nnz != num_entries_ || n != A->getNumRows())
+        {
+          std::cout << "Matrix sparsity pattern changed, reading the full matrix.\n";
+          return reload(file, A);
+        }
+
+        // Accumulate, so that duplicate entries are summed
+        real_type* values = A->getValues(memory::HOST);
+        std::fill(values, values + A->getNnz(), 0.0);
+        std::uint64_t hash = HASH_SEED;
+        for (index_type k = 0; k < nnz; ++k)
+        {
+          p               = hashToken(hashToken(p, hash), hash);
+          real_type value = 0.0;
+          if (MatrixMarketReader::parseReal(p, end, value) != 0)
+          {
+            std::cout << "Failed to parse entry " << k << " of the matrix file.\n";
+            return 1;
+          }
+
+          values[slot_[k]] += value;
+          if (mirror_[k] >= 0)
+          {
+            values[mirror_[k]] += value;
+          }
+        }
+        if (hash != entry_hash_)
+        {
+          std::cout << "Matrix sparsity pattern changed, reading the full matrix.\n";
+          return reload(file, A);
+        }
+        A->setUpdated(memory::HOST);
+        return 0;
+      }
+
+    private:
+      static constexpr std::uint64_t HASH_SEED  = 14695981039346656037ULL; ///< FNV-1a offset basis
+      static constexpr std::uint64_t HASH_PRIME = 1099511628211ULL;        ///< FNV-1a prime
+
+      /// Read `A` with the Re::Solve reader and build the map for its pattern.
+      int reload(std::istream& file, matrix::Csr* A)
+      {
+        file.clear();
+        file.seekg(0, std::ios::beg);
+        io::updateMatrixFromFile(file, A);
+        if (file.bad())
+        {
+          std::cout << "Failed to read the matrix file.\n";
+          return 1;
+        }
+        if (setup(file, A) != 0)
+        {
+          return 1;
+        }
+        return PATTERN_CHANGED;
+      }
+
+      /// Read the entire stream into the reusable buffer.
+      int readFile(std::istream& file)
+      {
+        file.clear();
+        file.seekg(0, std::ios::end);
+        std::streamoff size = file.tellg();
+        file.seekg(0, std::ios::beg);
+        if (size <= 0)
+        {
+          std::cout << "Failed to read the matrix file.\n";
+          return 1;
+        }
+        buffer_.resize(static_cast<size_t>(size));
+        file.read(&buffer_[0], size);
+        if (file.gcount() != size)
+        {
+          std::cout << "Failed to read the matrix file.\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      /// Parse banner, comments and size line; `p` is left at the first entry.
+      static int parseHeader(const char*& p,
+                             const char*  end,
+                             index_type&  n,
+                             index_type&  m,
+                             index_type&  nnz,
+                             bool&        symmetric)
+      {
+        const char* eol = nextLine(p);
+        std::string banner(p, eol);
+        std::transform(banner.begin(), banner.end(), banner.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        if (banner.rfind("%%matrixmarket", 0) != 0
+            || banner.find("coordinate") == std::string::npos
+            || banner.find("pattern") != std::string::npos
+            || banner.find("complex") != std::string::npos)
+        {
+          std::cout << "Only real coordinate Matrix Market files are supported.\n";
+          return 1;
+        }
+        symmetric = (banner.find("symmetric") != std::string::npos);
+
+        // Skip comments
+        p = eol;
+        while (*p == '%')
+        {
+          p = nextLine(p);
+        }
+
+        if (MatrixMarketReader::parseIndex(p, end, n) != 0
+            || MatrixMarketReader::parseIndex(p, end, m) != 0
+            || MatrixMarketReader::parseIndex(p, end, nnz) != 0
+            || nnz <= 0)
+        {
+          std::cout << "Failed to parse the matrix size.\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      /// Pointer to the start of the next line.
+      static const char* nextLine(const char* p)
+      {
+        while (*p != '\0' && *p != '\n')
+        {
+          ++p;
+        }
+        return (*p == '\n') ? p + 1 : p;
+      }
+
+      /// Skip leading whitespace and add the next token to the FNV-1a `hash`.
+      static const char* hashToken(const char* p, std::uint64_t& hash)
+      {
+        while (std::isspace(static_cast<unsigned char>(*p)))
+        {
+          ++p;
+        }
+        while (*p != '\0' && !std::isspace(static_cast<unsigned char>(*p)))
+        {
+          hash = (hash ^ static_cast<unsigned char>(*p)) * HASH_PRIME;
+          ++p;
+        }
+        hash = (hash ^ static_cast<unsigned char>(' ')) * HASH_PRIME;
+        return p;
+      }
+
+      static bool isSorted(const index_type* row_ptr, const index_type* col_idx, index_type n)
+      {
+        for (index_type i = 0; i < n; ++i)
+        {
+          for (index_type j = row_ptr[i] + 1; j < row_ptr[i + 1]; ++j)
+          {
+            if (col_idx[j - 1] >= col_idx[j])
+            {
+              return false;
+            }
+          }
+        }
+        return true;
+      }
+
+      /// Position of entry (row, col) in the CSR value array, -1 if not found.
+      static index_type findSlot(const index_type* row_ptr,
+                                 const index_type* col_idx,
+                                 index_type        row,
+                                 index_type        col,
+                                 bool              is_sorted)
+      {
+        const index_type* first = col_idx + row_ptr[row];
+        const index_type* last  = col_idx + row_ptr[row + 1];
+        const index_type* it    = is_sorted ? std::lower_bound(first, last, col) : std::find(first, last, col);
+        return (it != last && *it == col) ? static_cast<index_type>(it - col_idx) : -1;
+      }
+
+    private:
+      std::string             buffer_;        ///< File contents, reused between updates
+      std::vector<index_type> slot_;          ///< CSR value position of each file entry
+      std::vector<index_type> mirror_;        ///< Position of the mirrored entry or -1
+      index_type              num_entries_{0}; ///< Number of entries in the file
+      std::uint64_t           entry_hash_{0};  ///< Hash of entry coordinates in the file
+      bool                    is_setup_{false};
+    };
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <resolve/Common.hpp>
+
+#if defined(RESOLVE_USE_CUDA)
+#include <cuda_runtime.h>
+#elif defined(RESOLVE_USE_HIP)
+#include <hip/hip_runtime.h>
+#endif
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Tracks device memory usage of an example.
+     *
+     * Device memory in use is sampled at points chosen by the caller and
+     * reported relative to the usage when the monitor was created. The
+     * monitor keeps the high-water mark, the usage at every labeled sample
+     * point, and counts samples where usage grew after a sample with the
+     * same label. Growth at a point that is reached once per system means
+     * allocations in the solve loop, which synchronize the device.
+     *
+     * Usage:
+     * ```
+     *   DeviceMemoryMonitor monitor;
+     *   for each system:
+     *     ...
+     *     monitor.sample("after solve");
+     *   monitor.printSummary();
+     * ```
+     *
+     * @note Usage is obtained from the runtime (free vs. total memory), so
+     * it includes allocations of other processes on the same device and
+     * memory held by the runtime itself. Without GPU backend all samples
+     * are zero.
+     */
+    class DeviceMemoryMonitor
+    {
+    public:
+      DeviceMemoryMonitor()
+      {
+        baseline_ = getUsedMemory();
+      }
+
+      /**
+       * @brief Record device memory in use at sample point `label`.
+       *
+       * @return memory in use relative to the baseline in bytes
+       */
+      long long sample(const std::string& label)
+      {
+        long long used = static_cast<long long>(getUsedMemory()) - static_cast<long long>(baseline_);
+        current_       = used;
+        peak_          = std::max(peak_, used);
+
+        Point& point = getPoint(label);
+        if (point.num_samples > 0 && used > point.last)
+        {
+          ++point.num_growths;
+        }
+        point.last = used;
+        point.peak = std::max(point.peak, used);
+        ++point.num_samples;
+        return used;
+      }
+
+      /// Memory in use at the last sample, relative to the baseline in bytes.
+      long long getCurrent() const
+      {
+        return current_;
+      }
+
+      /// Largest sampled memory in use, relative to the baseline in bytes.
+      long long getPeak() const
+      {
+        return peak_;
+      }
+
+      /// Print usage at all sample points and the high-water mark.
+      void printSummary() const
+      {
+        std::cout << "Device memory usage relative to startup [MB]:\n";
+        std::cout << std::left << std::setw(32) << "sample point" << std::right
+                  << std::setw(10) << "samples" << std::setw(12) << "last" << std::setw(12) << "peak"
+                  << std::setw(10) << "growths" << "\n";
+        for (const Point& point : points_)
+        {
+          std::cout << std::left << std::setw(32) << point.label << std::right
+                    << std::setw(10) << point.num_samples
+                    << std::fixed << std::setprecision(2)
+                    << std::setw(12) << toMegabytes(point.last)
+                    << std::setw(12) << toMegabytes(point.peak)
+                    << std::setw(10) << point.num_growths << "\n";
+        }
+        std::cout << "High-water mark: " << toMegabytes(peak_) << " MB\n";
+      }
+
+    private:
+      /// Usage statistics at one sample point.
+      struct Point
+      {
+        std::string label;
+        long long   last{0};
+        long long   peak{0};
+        int         num_samples{0};
+        int         num_growths{0}; ///< samples with more memory than the previous one
+      };
+
+      Point& getPoint(const std::string& label)
+      {
+        for (Point& point : points_)
+        {
+          if (point.label == label)
+          {
+            return point;
+          }
+        }
+        points_.push_back({label});
+        return points_.back();
+      }
+
+      static double toMegabytes(long long bytes)
+      {
+        return static_cast<double>(bytes) / (1024.0 * 1024.0);
+      }
+
+      /// Device memory in use in bytes.
+      static size_t getUsedMemory()
+      {
+        size_t free_bytes  = 0;
+        size_t total_bytes = 0;
+#if defined(RESOLVE_USE_CUDA)
+        cudaMemGetInfo(&free_bytes, &total_bytes);
+#elif defined(RESOLVE_USE_HIP)
+        hipMemGetInfo(&free_bytes, &total_bytes);
+#endif
+        return total_bytes - free_bytes;
+      }
+
+    private:
+      size_t             baseline_{0};
+      long long          current_{0};
+      long long          peak_{0};
+      std::vector<Point> points_;
+    };
+
+  } // namespace examples
+} // namespace ReSolve
@@ -1,10 +1,12 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <iostream>
 
 #include <resolve/LinSolverIterative.hpp>
+#include <resolve/matrix/Csr.hpp>
 #include <resolve/matrix/MatrixHandler.hpp>
 #include <resolve/matrix/Sparse.hpp>
 #include <resolve/vector/Vector.hpp>
@@ -145,6 +147,12 @@ namespace ReSolve
         A_ = A;
         r_ = r;
         x_ = x;
+        // The residual vector is reused unless the system size changes
+        if (res_ != nullptr && res_->getSize() != A->getNumRows())
+        {
+          delete res_;
+          res_ = nullptr;
+        }
         if (res_ == nullptr)
         {
           res_ = new ReSolve::vector::Vector(A->getNumRows());
@@ -153,6 +161,18 @@ namespace ReSolve
         computeNorms();
       }
 
+      /**
+       * @brief Mark values of the system matrix as changed.
+       *
+       * The infinity norm of the system matrix is cached between calls to
+       * (re)setSystem with the same matrix. Call this after the matrix values
+       * are updated in place, so the norm is recomputed.
+       */
+      void setValuesChanged()
+      {
+        is_inf_norm_A_current_ = false;
+      }
+
       /// Return L2 norm of the linear system residual.
       ReSolve::real_type getNormResidual()
       {
@@ -336,16 +356,90 @@ namespace ReSolve
       /// Compute error norms.
       void computeNorms()
       {
-        // Compute rhs and residual norms
-        res_->copyDataFrom(r_, memspace_, memspace_);
-        norm_rhs_ = norm2(*r_, memspace_);
-        norm_res_ = computeResidualNorm(*A_, *x_, *res_, memspace_);
+        ReSolve::matrix::Csr* A_csr = dynamic_cast<ReSolve::matrix::Csr*>(A_);
+        if (memspace_ == ReSolve::memory::HOST && A_csr != nullptr)
+        {
+          computeNormsHost(A_csr);
+        }
+        else
+        {
+          // Compute rhs and residual norms
+          res_->copyDataFrom(r_, memspace_, memspace_);
+          norm_rhs_ = norm2(*r_, memspace_);
+          norm_res_ = computeResidualNorm(*A_, *x_, *res_, memspace_);
+
+          // Matrix norm is recomputed only for new matrix values
+          if (!is_inf_norm_A_current_ || inf_norm_A_matrix_ != A_)
+          {
+            mh_.matrixInfNorm(A_, &inf_norm_A_, memspace_);
+            inf_norm_A_matrix_     = A_;
+            is_inf_norm_A_current_ = true;
+          }
+          inf_norm_x_   = vh_.infNorm(x_, memspace_);
+          inf_norm_res_ = vh_.infNorm(res_, memspace_);
+        }
 
         // Compute norm of scaled residuals
-        mh_.matrixInfNorm(A_, &inf_norm_A_, memspace_);
-        inf_norm_x_   = vh_.infNorm(x_, memspace_);
-        inf_norm_res_ = vh_.infNorm(res_, memspace_);
-        nsr_norm_     = inf_norm_res_ / (inf_norm_A_ * inf_norm_x_);
+        nsr_norm_ = inf_norm_res_ / (inf_norm_A_ * inf_norm_x_);
+      }
+
+      /**
+       * @brief Compute residual and all error norms in one pass over rows of A.
+       *
+       * Residual res = A*x - r, its 2- and infinity norms, 2-norm of r,
+       * infinity norm of x and row sum (infinity) norm of A are accumulated
+       * together, so A, x and r are each read only once.
+       *
+       * @param[in] A - system matrix in CSR format with current host data
+       *
+       * @pre A is square and stored in expanded form.
+       * @post res_ host data holds the residual.
+       */
+      void computeNormsHost(ReSolve::matrix::Csr* A)
+      {
+        using namespace ReSolve;
+        index_type        n       = A->getNumRows();
+        const index_type* row_ptr = A->getRowData(memory::HOST);
+        const index_type* col_idx = A->getColData(memory::HOST);
+        const real_type*  values  = A->getValues(memory::HOST);
+        const real_type*  x       = x_->getData(memory::HOST);
+        const real_type*  r       = r_->getData(memory::HOST);
+        if (res_->getData(memory::HOST) == nullptr)
+        {
+          res_->allocate(memory::HOST);
+        }
+        real_type* res = res_->getData(memory::HOST);
+
+        real_type sum_res   = 0.0;
+        real_type sum_rhs   = 0.0;
+        real_type max_res   = 0.0;
+        real_type max_x     = 0.0;
+        real_type max_row_A = 0.0;
+        for (index_type i = 0; i < n; ++i)
+        {
+          real_type ax      = 0.0;
+          real_type row_sum = 0.0;
+          for (index_type k = row_ptr[i]; k < row_ptr[i + 1]; ++k)
+          {
+            ax += values[k] * x[col_idx[k]];
+            row_sum += std::abs(values[k]);
+          }
+          res[i] = ax - r[i];
+          sum_res += res[i] * res[i];
+          sum_rhs += r[i] * r[i];
+          max_res   = std::max(max_res, std::abs(res[i]));
+          max_x     = std::max(max_x, std::abs(x[i]));
+          max_row_A = std::max(max_row_A, row_sum);
+        }
+        res_->setDataUpdated(memory::HOST);
+
+        norm_res_              = std::sqrt(sum_res);
+        norm_rhs_              = std::sqrt(sum_rhs);
+        inf_norm_res_          = max_res;
+        inf_norm_x_            = max_x;
+        inf_norm_A_            = max_row_A;
+        inf_norm_A_matrix_     = A;
+        is_inf_norm_A_current_ = true;
       }
 
       /**
@@ -395,6 +489,9 @@ namespace ReSolve
       real_type inf_norm_res_{0.0}; ///< infinity norm of res = A*x - r
       real_type nsr_norm_{0.0};     ///< norm of scaled residuals
 
+      ReSolve::matrix::Sparse* inf_norm_A_matrix_{nullptr};     ///< matrix of cached inf_norm_A_
+      bool                     is_inf_norm_A_current_{false}; ///< inf_norm_A_ matches its values
+
       ReSolve::memory::MemorySpace memspace_{ReSolve::memory::HOST};
       std::string                  hardware_backend_{"NONE"};
     };
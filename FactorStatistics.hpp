@@ -0,0 +1,135 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <resolve/matrix/Sparse.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /// Fill-reducing orderings of KLU, as accepted by LinSolverDirect::setOrdering().
+    inline const std::vector<std::string>& getOrderingNames()
+    {
+      static const std::vector<std::string> names = {"amd", "colamd"};
+      return names;
+    }
+
+    /**
+     * @brief Get KLU ordering from its name.
+     *
+     * @param[in]  name     - ordering name (see getOrderingNames())
+     * @param[out] ordering - KLU ordering code, position of `name` in the list
+     * @return 0 if `name` is a known ordering, 1 otherwise
+     */
+    inline int getOrdering(const std::string& name, int& ordering)
+    {
+      const std::vector<std::string>& names = getOrderingNames();
+      auto                            it    = std::find(names.begin(), names.end(), name);
+      if (it == names.end())
+      {
+        std::cout << "Unknown ordering " << name << ".\n";
+        return 1;
+      }
+      ordering = static_cast<int>(it - names.begin());
+      return 0;
+    }
+
+    /// Fill and parallelism of LU factors.
+    struct FactorStatistics
+    {
+      index_type nnz_factors{0};      ///< nnz(L) + nnz(U) - n, unit diagonal of L not counted
+      double     fill_ratio{0.0};     ///< nnz_factors over nnz(A)
+      index_type num_lower_levels{0}; ///< levels of forward substitution and refactorization
+      index_type num_upper_levels{0}; ///< levels of backward substitution
+      real_type  pivot_ratio{0.0};    ///< smallest over largest pivot magnitude, diagonal of U
+    };
+
+    /**
+     * @brief Compute fill and level counts of LU factors in CSC format.
+     *
+     * The number of levels of L is the depth of the elimination dependency
+     * graph, i.e. the number of sequential steps of a level-scheduled
+     * refactorization and forward substitution. Orderings with less fill
+     * (e.g. AMD) often give deeper graphs than those balancing fill and
+     * parallelism, which matters more on GPU than a few extra nonzeros.
+     *
+     * @param[in] A - system matrix
+     * @param[in] L - lower triangular factor in CSC format, host data is used
+     * @param[in] U - upper triangular factor in CSC format, host data is used
+     *
+     * The pivot ratio is the same measure as the one reported by
+     * ParallelRefactorizationCpu, so it can serve as the baseline of
+     * RefactorizationPolicy::checkPivotRatio().
+     */
+    inline FactorStatistics computeFactorStatistics(matrix::Sparse* A, matrix::Sparse* L, matrix::Sparse* U)
+    {
+      FactorStatistics  stats;
+      index_type        n     = L->getNumRows();
+      const index_type* L_col = L->getColData(memory::HOST);
+      const index_type* L_row = L->getRowData(memory::HOST);
+      const index_type* U_col = U->getColData(memory::HOST);
+      const index_type* U_row = U->getRowData(memory::HOST);
+      const real_type*  U_val = U->getValues(memory::HOST);
+
+      stats.nnz_factors = L->getNnz() + U->getNnz() - n;
+      stats.fill_ratio  = static_cast<double>(stats.nnz_factors) / static_cast<double>(A->getNnz());
+
+      // Row i of L*y = b waits for rows j with L(i,j) != 0, which are
+      // final once column j is reached
+      std::vector<index_type> level(n, 0);
+      for (index_type j = 0; j < n; ++j)
+      {
+        for (index_type p = L_col[j]; p < L_col[j + 1]; ++p)
+        {
+          index_type i = L_row[p];
+          if (i != j)
+          {
+            level[i] = std::max(level[i], level[j] + 1);
+          }
+        }
+        stats.num_lower_levels = std::max(stats.num_lower_levels, level[j] + 1);
+      }
+
+      // Same for U, from the last column backwards
+      std::fill(level.begin(), level.end(), 0);
+      real_type min_pivot = std::numeric_limits<real_type>::max();
+      real_type max_pivot = 0.0;
+      for (index_type j = n - 1; j >= 0; --j)
+      {
+        for (index_type p = U_col[j]; p < U_col[j + 1]; ++p)
+        {
+          index_type i = U_row[p];
+          if (i != j)
+          {
+            level[i] = std::max(level[i], level[j] + 1);
+          }
+          else
+          {
+            real_type pivot = std::abs(U_val[p]);
+            min_pivot       = std::min(min_pivot, pivot);
+            max_pivot       = std::max(max_pivot, pivot);
+          }
+        }
+        stats.num_upper_levels = std::max(stats.num_upper_levels, level[j] + 1);
+      }
+      stats.pivot_ratio = (max_pivot > 0.0) ? min_pivot / max_pivot : 0.0;
+      return stats;
+    }
+
+    /// Print fill and level counts of the factors.
+    inline void printFactorStatistics(const FactorStatistics& stats)
+    {
+      std::cout << "Factors: nnz(L+U) = " << stats.nnz_factors
+                << " (fill ratio " << stats.fill_ratio << "), levels: "
+                << stats.num_lower_levels << " (L), " << stats.num_upper_levels << " (U)"
+                << ", pivot ratio: " << stats.pivot_ratio << "\n";
+    }
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <resolve/GramSchmidt.hpp>
+#include <resolve/vector/Vector.hpp>
+#include <resolve/vector/VectorHandler.hpp>
+
+#include "Benchmark.hpp"
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /// Gram-Schmidt variant names, as accepted by SystemSolver::setRefinementMethod.
+    inline const std::vector<std::string>& getGramSchmidtVariantNames()
+    {
+      static const std::vector<std::string> names = {"cgs2", "mgs", "mgs_two_sync", "mgs_pm", "cgs1"};
+      return names;
+    }
+
+    /**
+     * @brief Get Gram-Schmidt variant from its name.
+     *
+     * Low-synchronization variants "mgs_two_sync" and "mgs_pm" fuse inner
+     * products with the basis into multi-dot kernels and need fewer global
+     * reductions per Arnoldi step than "cgs2". "mgs" needs one reduction
+     * per basis vector.
+     *
+     * @param[in]  name    - variant name (see getGramSchmidtVariantNames())
+     * @param[out] variant - Gram-Schmidt variant
+     * @return 0 if `name` is a known variant, 1 otherwise
+     */
+    inline int getGramSchmidtVariant(const std::string& name, GramSchmidt::GSVariant& variant)
+    {
+      if (name == "cgs2")
+      {
+        variant = GramSchmidt::CGS2;
+      }
+      else if (name == "mgs")
+      {
+        variant = GramSchmidt::MGS;
+      }
+      else if (name == "mgs_two_sync")
+      {
+        variant = GramSchmidt::MGS_TWO_SYNC;
+      }
+      else if (name == "mgs_pm")
+      {
+        variant = GramSchmidt::MGS_PM;
+      }
+      else if (name == "cgs1")
+      {
+        variant = GramSchmidt::CGS1;
+      }
+      else
+      {
+        std::cout << "Unknown Gram-Schmidt variant " << name << ".\n";
+        return 1;
+      }
+      return 0;
+    }
+
+    /// Results of orthogonalizing a random Krylov basis.
+    struct OrthogonalizationResult
+    {
+      double    time_per_step;      ///< average time of one orthogonalization step [s]
+      real_type orthogonality_loss; ///< max |v_j^T v_m - delta_jm| for the last vector v_m
+    };
+
+    /**
+     * @brief Time Gram-Schmidt orthogonalization of a full Krylov basis.
+     *
+     * The basis of `restart` + 1 random vectors of size `n` is orthogonalized
+     * column by column, as in one restart cycle of FGMRES. Loss of
+     * orthogonality is measured on the host for the last basis vector only,
+     * so the check costs O(n * restart).
+     *
+     * @param[in] vector_handler - handler for the memory space of the basis
+     * @param[in] variant        - Gram-Schmidt variant
+     * @param[in] n              - vector size
+     * @param[in] restart        - number of orthogonalization steps
+     * @param[in] memspace       - memory space of the basis
+     */
+    inline OrthogonalizationResult timeOrthogonalization(VectorHandler*         vector_handler,
+                                                         GramSchmidt::GSVariant variant,
+                                                         index_type             n,
+                                                         index_type             restart,
+                                                         memory::MemorySpace    memspace)
+    {
+      vector::Vector V(n, restart + 1);
+      V.allocate(memory::HOST);
+      std::mt19937                     generator(0);
+      std::uniform_real_distribution<> distribution(-1.0, 1.0);
+      real_type*                       data = V.getData(memory::HOST);
+      for (index_type k = 0; k < n * (restart + 1); ++k)
+      {
+        data[k] = distribution(generator);
+      }
+
+      // FGMRES starts from a normalized residual
+      real_type norm = 0.0;
+      for (index_type k = 0; k < n; ++k)
+      {
+        norm += data[k] * data[k];
+      }
+      norm = std::sqrt(norm);
+      for (index_type k = 0; k < n; ++k)
+      {
+        data[k] /= norm;
+      }
+      V.setDataUpdated(memory::HOST);
+      if (memspace == memory::DEVICE)
+      {
+        V.syncData(memspace);
+      }
+      std::vector<real_type> H((restart + 1) * (restart + 1), 0.0);
+
+      GramSchmidt GS(vector_handler, variant);
+      GS.setup(n, restart);
+
+      PhaseTimer timer;
+      timer.start();
+      for (index_type i = 0; i < restart; ++i)
+      {
+        GS.orthogonalize(n, &V, H.data(), i);
+      }
+      OrthogonalizationResult result;
+      result.time_per_step = timer.stop() / restart;
+
+      // Gram-Schmidt writes the basis in memspace without marking it updated
+      V.setDataUpdated(memspace);
+      V.syncData(memory::HOST);
+      data                      = V.getData(memory::HOST);
+      const real_type* v_last   = data + n * restart;
+      result.orthogonality_loss = 0.0;
+      for (index_type j = 0; j <= restart; ++j)
+      {
+        real_type dot = 0.0;
+        for (index_type k = 0; k < n; ++k)
+        {
+          dot += data[n * j + k] * v_last[k];
+        }
+        real_type expected        = (j == restart) ? 1.0 : 0.0;
+        result.orthogonality_loss = std::max(result.orthogonality_loss, std::abs(dot - expected));
+      }
+      return result;
+    }
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,557 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/vector/Vector.hpp>
+
+#include "ThreadTeam.hpp"
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Multithreaded reader of Matrix Market files.
+     *
+     * The file is memory-mapped and split into line-aligned chunks, one per
+     * thread, which are parsed concurrently with `std::from_chars`. The CSR
+     * matrix is then assembled with a counting sort over rows, including the
+     * mirrored entries of expanded symmetric matrices. Columns are sorted in
+     * each row and duplicate entries are summed, in an order that does not
+     * depend on the number of threads.
+     *
+     * Only real coordinate matrices and real array vectors are supported.
+     * Readers return nullptr for other files or on any error, so callers
+     * fall back to the stream-based `io::createCsrFromFile` and
+     * `io::createVectorFromFile`:
+     * ```
+     *   MatrixMarketReader reader;
+     *   A = reader.createCsr(pathname, is_expand_symmetric);
+     *   if (A == nullptr)
+     *   {
+     *     A = io::createCsrFromFile(file, is_expand_symmetric);
+     *   }
+     * ```
+     */
+    class MatrixMarketReader
+    {
+    public:
+      explicit MatrixMarketReader(int num_threads = static_cast<int>(std::thread::hardware_concurrency()))
+        : team_(num_threads)
+      {
+      }
+
+      ~MatrixMarketReader()
+      {
+        close();
+      }
+
+      MatrixMarketReader(const MatrixMarketReader&)            = delete;
+      MatrixMarketReader& operator=(const MatrixMarketReader&) = delete;
+
+      /// Set number of threads used for parsing and assembly (at least 1).
+      void setNumThreads(int num_threads)
+      {
+        team_.resize(num_threads);
+      }
+
+      /**
+       * @brief Create CSR matrix from Matrix Market file `pathname`.
+       *
+       * @param[in] pathname            - Matrix Market coordinate file
+       * @param[in] is_expand_symmetric - store both triangles of symmetric matrices
+       * @return new matrix with host data, nullptr if the file cannot be read
+       */
+      matrix::Csr* createCsr(const std::string& pathname, bool is_expand_symmetric = true)
+      {
+        if (open(pathname) != 0)
+        {
+          return nullptr;
+        }
+        const char* p         = map_;
+        const char* end       = map_ + map_size_;
+        bool        symmetric = false;
+        index_type  n         = 0;
+        index_type  m         = 0;
+        index_type  nnz       = 0;
+        if (parseBanner(p, end, true, symmetric) != 0
+            || parseIndex(p, end, n) != 0
+            || parseIndex(p, end, m) != 0
+            || parseIndex(p, end, nnz) != 0
+            || n <= 0 || m <= 0 || nnz <= 0)
+        {
+          std::cout << "Failed to parse the header of " << pathname << "\n";
+          close();
+          return nullptr;
+        }
+
+        // Parse entries of line-aligned chunks concurrently
+        int num_threads = team_.getNumThreads();
+        chunks_.resize(num_threads);
+        std::atomic<bool> has_error{false};
+        team_.run([&](int tid)
+                  {
+                    Chunk& chunk = chunks_[tid];
+                    chunk.clear();
+                    const char* q    = getChunkBegin(p, end, tid, num_threads);
+                    const char* stop = getChunkBegin(p, end, tid + 1, num_threads);
+                    while (skipToEntry(q, stop))
+                    {
+                      index_type row   = 0;
+                      index_type col   = 0;
+                      real_type  value = 0.0;
+                      if (parseIndex(q, stop, row) != 0 || parseIndex(q, stop, col) != 0
+                          || parseReal(q, stop, value) != 0
+                          || row < 1 || row > n || col < 1 || col > m)
+                      {
+                        has_error.store(true, std::memory_order_relaxed);
+                        return;
+                      }
+                      chunk.rows.push_back(row - 1);
+                      chunk.cols.push_back(col - 1);
+                      chunk.values.push_back(value);
+                    }
+                  });
+        close();
+
+        index_type num_entries = 0;
+        for (const Chunk& chunk : chunks_)
+        {
+          num_entries += static_cast<index_type>(chunk.rows.size());
+        }
+        if (has_error.load() || num_entries != nnz)
+        {
+          std::cout << "Failed to parse the entries of " << pathname << "\n";
+          return nullptr;
+        }
+
+        bool is_expanded = symmetric && is_expand_symmetric;
+        return assembleCsr(n, m, symmetric, is_expanded);
+      }
+
+      /**
+       * @brief Create vector from Matrix Market array file `pathname`.
+       *
+       * @return new vector with host data, nullptr if the file cannot be read
+       */
+      vector::Vector* createVector(const std::string& pathname)
+      {
+        index_type n = 0;
+        if (readArray(pathname, n) != 0)
+        {
+          return nullptr;
+        }
+        vector::Vector* vec = new vector::Vector(n);
+        vec->allocate(memory::HOST);
+        copyArray(vec->getData(memory::HOST));
+        vec->setDataUpdated(memory::HOST);
+        return vec;
+      }
+
+      /**
+       * @brief Create array from Matrix Market array file `pathname`.
+       *
+       * @return new array to be deleted with `delete[]`, nullptr if the file
+       * cannot be read
+       */
+      real_type* createArray(const std::string& pathname)
+      {
+        index_type n = 0;
+        if (readArray(pathname, n) != 0)
+        {
+          return nullptr;
+        }
+        real_type* array = new real_type[n];
+        copyArray(array);
+        return array;
+      }
+
+      /// Skip whitespace, including line breaks.
+      static void skipBlanks(const char*& p, const char* end)
+      {
+        while (p < end && std::isspace(static_cast<unsigned char>(*p)))
+        {
+          ++p;
+        }
+      }
+
+      /**
+       * @brief Parse an integer with `std::from_chars`.
+       *
+       * @param[in,out] p     - parse position, left after the integer
+       * @param[in]     end   - end of the text
+       * @param[out]    value - parsed integer
+       * @return 0 if successful, 1 otherwise
+       */
+      static int parseIndex(const char*& p, const char* end, index_type& value)
+      {
+        skipBlanks(p, end);
+        auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc())
+        {
+          return 1;
+        }
+        p = result.ptr;
+        return 0;
+      }
+
+      /**
+       * @brief Parse a real number with `std::from_chars`.
+       *
+       * @param[in,out] p     - parse position, left after the number
+       * @param[in]     end   - end of the text
+       * @param[out]    value - parsed number
+       * @return 0 if successful, 1 otherwise
+       */
+      static int parseReal(const char*& p, const char* end, real_type& value)
+      {
+        skipBlanks(p, end);
+        // from_chars does not accept an explicit plus sign
+        if (p < end && *p == '+')
+        {
+          ++p;
+        }
+        auto result = std::from_chars(p, end, value);
+        if (result.ec != std::errc())
+        {
+          return 1;
+        }
+        p = result.ptr;
+        return 0;
+      }
+
+    private:
+      /// Entries parsed by one thread.
+      struct Chunk
+      {
+        std::vector<index_type> rows;
+        std::vector<index_type> cols;
+        std::vector<real_type>  values;
+
+        void clear()
+        {
+          rows.clear();
+          cols.clear();
+          values.clear();
+        }
+      };
+
+      /// Parse values of an array file into the chunks.
+      int readArray(const std::string& pathname, index_type& n)
+      {
+        if (open(pathname) != 0)
+        {
+          return 1;
+        }
+        const char* p         = map_;
+        const char* end       = map_ + map_size_;
+        bool        symmetric = false;
+        index_type  m         = 0;
+        if (parseBanner(p, end, false, symmetric) != 0
+            || parseIndex(p, end, n) != 0
+            || parseIndex(p, end, m) != 0
+            || n <= 0 || m != 1 || symmetric)
+        {
+          std::cout << "Failed to parse the header of " << pathname << "\n";
+          close();
+          return 1;
+        }
+
+        int num_threads = team_.getNumThreads();
+        chunks_.resize(num_threads);
+        std::atomic<bool> has_error{false};
+        team_.run([&](int tid)
+                  {
+                    Chunk& chunk = chunks_[tid];
+                    chunk.clear();
+                    const char* q    = getChunkBegin(p, end, tid, num_threads);
+                    const char* stop = getChunkBegin(p, end, tid + 1, num_threads);
+                    while (skipToEntry(q, stop))
+                    {
+                      real_type value = 0.0;
+                      if (parseReal(q, stop, value) != 0)
+                      {
+                        has_error.store(true, std::memory_order_relaxed);
+                        return;
+                      }
+                      chunk.values.push_back(value);
+                    }
+                  });
+        close();
+
+        index_type num_values = 0;
+        for (const Chunk& chunk : chunks_)
+        {
+          num_values += static_cast<index_type>(chunk.values.size());
+        }
+        if (has_error.load() || num_values != n)
+        {
+          std::cout << "Failed to parse the values of " << pathname << "\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      /// Copy values of all chunks to `array`, in file order.
+      void copyArray(real_type* array) const
+      {
+        for (const Chunk& chunk : chunks_)
+        {
+          array = std::copy(chunk.values.begin(), chunk.values.end(), array);
+        }
+      }
+
+      /// Counting sort of the parsed entries into a new CSR matrix.
+      matrix::Csr* assembleCsr(index_type n, index_type m, bool symmetric, bool is_expanded)
+      {
+        // Count entries per row, mirrored entries included
+        std::unique_ptr<std::atomic<index_type>[]> count(new std::atomic<index_type>[n]);
+        for (index_type i = 0; i < n; ++i)
+        {
+          count[i].store(0, std::memory_order_relaxed);
+        }
+        team_.run([&](int tid)
+                  {
+                    const Chunk& chunk = chunks_[tid];
+                    for (size_t k = 0; k < chunk.rows.size(); ++k)
+                    {
+                      count[chunk.rows[k]].fetch_add(1, std::memory_order_relaxed);
+                      if (is_expanded && chunk.rows[k] != chunk.cols[k])
+                      {
+                        count[chunk.cols[k]].fetch_add(1, std::memory_order_relaxed);
+                      }
+                    }
+                  });
+        std::vector<index_type> start(n + 1, 0);
+        for (index_type i = 0; i < n; ++i)
+        {
+          start[i + 1] = start[i] + count[i].load(std::memory_order_relaxed);
+          count[i].store(start[i], std::memory_order_relaxed);
+        }
+
+        // Scatter entries to their rows
+        std::vector<std::pair<index_type, real_type>> entries(start[n]);
+        team_.run([&](int tid)
+                  {
+                    const Chunk& chunk = chunks_[tid];
+                    for (size_t k = 0; k < chunk.rows.size(); ++k)
+                    {
+                      index_type row = chunk.rows[k];
+                      index_type col = chunk.cols[k];
+                      entries[count[row].fetch_add(1, std::memory_order_relaxed)] = {col, chunk.values[k]};
+                      if (is_expanded && row != col)
+                      {
+                        entries[count[col].fetch_add(1, std::memory_order_relaxed)] = {row, chunk.values[k]};
+                      }
+                    }
+                  });
+
+        // Sort rows and sum duplicates in place; sorting by value too makes
+        // the summation order independent of the scatter order
+        std::vector<index_type> row_nnz(n);
+        forEachRowBlock(n, [&](index_type i)
+                        {
+                          auto first = entries.begin() + start[i];
+                          auto last  = entries.begin() + start[i + 1];
+                          std::sort(first, last);
+                          auto out = first;
+                          for (auto it = first; it != last; ++it)
+                          {
+                            if (out != first && (out - 1)->first == it->first)
+                            {
+                              (out - 1)->second += it->second;
+                            }
+                            else
+                            {
+                              *out++ = *it;
+                            }
+                          }
+                          row_nnz[i] = static_cast<index_type>(out - first);
+                        });
+
+        index_type nnz = 0;
+        for (index_type i = 0; i < n; ++i)
+        {
+          nnz += row_nnz[i];
+        }
+        matrix::Csr* A = new matrix::Csr(n, m, nnz, symmetric, is_expanded);
+        A->allocateMatrixData(memory::HOST);
+        index_type* row_ptr = A->getRowData(memory::HOST);
+        index_type* col_idx = A->getColData(memory::HOST);
+        real_type*  values  = A->getValues(memory::HOST);
+        row_ptr[0]          = 0;
+        for (index_type i = 0; i < n; ++i)
+        {
+          row_ptr[i + 1] = row_ptr[i] + row_nnz[i];
+        }
+        forEachRowBlock(n, [&](index_type i)
+                        {
+                          for (index_type k = 0; k < row_nnz[i]; ++k)
+                          {
+                            col_idx[row_ptr[i] + k] = entries[start[i] + k].first;
+                            values[row_ptr[i] + k]  = entries[start[i] + k].second;
+                          }
+                        });
+        A->setUpdated(memory::HOST);
+        return A;
+      }
+
+      /// Apply `op` to all rows, each thread taking a contiguous block.
+      template <class Op>
+      void forEachRowBlock(index_type n, Op op)
+      {
+        team_.run([&](int tid)
+                  {
+                    index_type num_threads = team_.getNumThreads();
+                    index_type begin       = static_cast<index_type>(static_cast<long long>(n) * tid / num_threads);
+                    index_type end         = static_cast<index_type>(static_cast<long long>(n) * (tid + 1) / num_threads);
+                    for (index_type i = begin; i < end; ++i)
+                    {
+                      op(i);
+                    }
+                  });
+      }
+
+      /// Map file `pathname` for reading.
+      int open(const std::string& pathname)
+      {
+        close();
+        int fd = ::open(pathname.c_str(), O_RDONLY);
+        if (fd < 0)
+        {
+          std::cout << "Failed to open file " << pathname << "\n";
+          return 1;
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0)
+        {
+          std::cout << "File " << pathname << " is empty.\n";
+          ::close(fd);
+          return 1;
+        }
+        map_size_ = static_cast<size_t>(file_stat.st_size);
+        void* map = mmap(nullptr, map_size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (map == MAP_FAILED)
+        {
+          std::cout << "Failed to map file " << pathname << "\n";
+          map_size_ = 0;
+          return 1;
+        }
+        // All threads touch their chunks at once
+        madvise(map, map_size_, MADV_WILLNEED);
+        map_ = static_cast<const char*>(map);
+        return 0;
+      }
+
+      /// Unmap the file.
+      void close()
+      {
+        if (map_ != nullptr)
+        {
+          munmap(const_cast<char*>(map_), map_size_);
+        }
+        map_      = nullptr;
+        map_size_ = 0;
+      }
+
+      /**
+       * @brief Parse the banner and skip comments.
+       *
+       * @param[in,out] p             - start of the file, left at the size line
+       * @param[in]     end           - end of the file
+       * @param[in]     is_coordinate - expect "coordinate" or "array" format
+       * @param[out]    symmetric     - true for symmetric matrices
+       * @return 0 for real files in the expected format, 1 otherwise
+       */
+      static int parseBanner(const char*& p, const char* end, bool is_coordinate, bool& symmetric)
+      {
+        const char* eol = nextLine(p, end);
+        std::string banner(p, eol);
+        std::transform(banner.begin(), banner.end(), banner.begin(), [](unsigned char c)
+                       { return static_cast<char>(std::tolower(c)); });
+        if (banner.rfind("%%matrixmarket", 0) != 0
+            || banner.find(is_coordinate ? "coordinate" : "array") == std::string::npos
+            || banner.find("real") == std::string::npos)
+        {
+          return 1;
+        }
+        symmetric = (banner.find("symmetric") != std::string::npos);
+
+        p = eol;
+        while (p < end && *p == '%')
+        {
+          p = nextLine(p, end);
+        }
+        return 0;
+      }
+
+      /// Start of chunk `k` of `num_chunks` of [begin, end), at a line start.
+      static const char* getChunkBegin(const char* begin, const char* end, int k, int num_chunks)
+      {
+        if (k == 0)
+        {
+          return begin;
+        }
+        if (k == num_chunks)
+        {
+          return end;
+        }
+        const char* p = begin + static_cast<size_t>(end - begin) * k / num_chunks;
+        // A chunk boundary right after a newline already is a line start
+        return (*(p - 1) == '\n') ? p : nextLine(p, end);
+      }
+
+      /// Pointer to the start of the next line.
+      static const char* nextLine(const char* p, const char* end)
+      {
+        const char* eol = static_cast<const char*>(std::memchr(p, '\n', static_cast<size_t>(end - p)));
+        return (eol == nullptr) ? end : eol + 1;
+      }
+
+      /// Skip whitespace and comment lines; false if no entry is left.
+      static bool skipToEntry(const char*& p, const char* end)
+      {
+        while (p < end)
+        {
+          if (*p == '%')
+          {
+            p = nextLine(p, end);
+          }
+          else if (std::isspace(static_cast<unsigned char>(*p)))
+          {
+            ++p;
+          }
+          else
+          {
+            return true;
+          }
+        }
+        return false;
+      }
+
+    private:
+      ThreadTeam         team_;
+      std::vector<Chunk> chunks_; ///< parsed entries per thread
+      const char*        map_{nullptr};
+      size_t             map_size_{0};
+    };
+
+  } // namespace examples
+} // namespace ReSolve
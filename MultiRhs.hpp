@@ -0,0 +1,205 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <resolve/matrix/Sparse.hpp>
+#include <resolve/vector/Vector.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Solve a factorized linear system for all columns of a multivector.
+     *
+     * All right-hand sides are solved with the same factorization. Columns
+     * of `B` and `X` are accessed in place through non-owning vector views,
+     * so no data is copied or allocated per right-hand side.
+     *
+     * Columns are solved one at a time with the single-vector `solve` of
+     * the solver. Use solveFactorsMultiRhs() when the LU factors are
+     * available on the host, e.g. from KLU.
+     *
+     * @tparam solver_type - solver with `solve(rhs, x)` method, e.g.
+     * SystemSolver or any LinSolverDirect
+     *
+     * @param[in]  solver   - solver with factorization already computed
+     * @param[in]  B        - right-hand sides, n x k multivector
+     * @param[out] X        - solutions, n x k multivector
+     * @param[in]  memspace - memory space where B and X data is current
+     * @return 0 if all solves were successful, number of failed solves otherwise
+     *
+     * @pre Data of `B` and `X` is allocated in `memspace`.
+     * @post Data of `X` in `memspace` is updated.
+     */
+    template <class solver_type>
+    int solveMultiRhs(solver_type&        solver,
+                      vector::Vector*     B,
+                      vector::Vector*     X,
+                      memory::MemorySpace memspace)
+    {
+      index_type n = B->getSize();
+      index_type k = B->getNumVectors();
+      if (X->getSize() != n || X->getNumVectors() != k)
+      {
+        std::cout << "Right-hand side and solution multivectors do not match.\n";
+        return 1;
+      }
+
+      vector::Vector rhs_view(n);
+      vector::Vector x_view(n);
+
+      int num_failed = 0;
+      for (index_type j = 0; j < k; ++j)
+      {
+        rhs_view.setData(B->getData(j, memspace), memspace);
+        x_view.setData(X->getData(j, memspace), memspace);
+        rhs_view.setDataUpdated(memspace);
+        x_view.setDataUpdated(memspace);
+        if (solver.solve(&rhs_view, &x_view) != 0)
+        {
+          ++num_failed;
+        }
+      }
+      X->setDataUpdated(memspace);
+
+      return num_failed;
+    }
+
+    /**
+     * @brief Solve with host LU factors for all columns of a multivector at once.
+     *
+     * Solves P*A*Q = L*U for all k right-hand sides with one forward and one
+     * backward sweep over the factors. The right-hand sides are gathered into
+     * a row-major n x k block, so each factor entry is loaded once and
+     * applied to k contiguous values, instead of the factors being streamed
+     * k times by column-at-a-time solves.
+     *
+     * @param[in]  L - lower triangular factor in CSC format, diagonal stored
+     * @param[in]  U - upper triangular factor in CSC format
+     * @param[in]  P - row permutation, row i of P*A is row P[i] of A
+     * @param[in]  Q - column permutation, column i of A*Q is column Q[i] of A
+     * @param[in]  B - right-hand sides, n x k multivector
+     * @param[out] X - solutions, n x k multivector
+     * @return 0 if successful, 1 otherwise
+     *
+     * @pre Host data of the factors, `B` and `X` is allocated and current,
+     * e.g. factors from LinSolverDirectKLU::getLFactor() and getUFactor().
+     * @post Host data of `X` is updated.
+     */
+    inline int solveFactorsMultiRhs(matrix::Sparse*   L,
+                                    matrix::Sparse*   U,
+                                    const index_type* P,
+                                    const index_type* Q,
+                                    vector::Vector*   B,
+                                    vector::Vector*   X)
+    {
+      index_type n = B->getSize();
+      index_type k = B->getNumVectors();
+      if (X->getSize() != n || X->getNumVectors() != k)
+      {
+        std::cout << "Right-hand side and solution multivectors do not match.\n";
+        return 1;
+      }
+      if (L == nullptr || U == nullptr || P == nullptr || Q == nullptr)
+      {
+        std::cout << "Block solve requires factors and permutations.\n";
+        return 1;
+      }
+
+      // Row-major block, row i holds entry i of all permuted right-hand sides
+      std::vector<real_type> block(static_cast<size_t>(n) * k);
+      for (index_type j = 0; j < k; ++j)
+      {
+        const real_type* b_j = B->getData(j, memory::HOST);
+        for (index_type i = 0; i < n; ++i)
+        {
+          block[i * k + j] = b_j[P[i]];
+        }
+      }
+
+      // Forward sweep, column c of L updates the rows below it
+      const index_type* L_col = L->getColData(memory::HOST);
+      const index_type* L_row = L->getRowData(memory::HOST);
+      const real_type*  L_val = L->getValues(memory::HOST);
+      for (index_type c = 0; c < n; ++c)
+      {
+        real_type* y_c = &block[c * k];
+        for (index_type p = L_col[c]; p < L_col[c + 1]; ++p)
+        {
+          if (L_row[p] == c)
+          {
+            for (index_type j = 0; j < k; ++j)
+            {
+              y_c[j] /= L_val[p];
+            }
+          }
+        }
+        for (index_type p = L_col[c]; p < L_col[c + 1]; ++p)
+        {
+          index_type r = L_row[p];
+          if (r > c)
+          {
+            real_type* y_r = &block[r * k];
+            for (index_type j = 0; j < k; ++j)
+            {
+              y_r[j] -= L_val[p] * y_c[j];
+            }
+          }
+        }
+      }
+
+      // Backward sweep, column c of U updates the rows above it
+      const index_type* U_col = U->getColData(memory::HOST);
+      const index_type* U_row = U->getRowData(memory::HOST);
+      const real_type*  U_val = U->getValues(memory::HOST);
+      for (index_type c = n - 1; c >= 0; --c)
+      {
+        real_type* y_c       = &block[c * k];
+        bool       has_pivot = false;
+        for (index_type p = U_col[c]; p < U_col[c + 1]; ++p)
+        {
+          if (U_row[p] == c && U_val[p] != 0.0)
+          {
+            has_pivot = true;
+            for (index_type j = 0; j < k; ++j)
+            {
+              y_c[j] /= U_val[p];
+            }
+          }
+        }
+        if (!has_pivot)
+        {
+          std::cout << "Zero pivot in row " << c << " of U.\n";
+          return 1;
+        }
+        for (index_type p = U_col[c]; p < U_col[c + 1]; ++p)
+        {
+          index_type r = U_row[p];
+          if (r < c)
+          {
+            real_type* y_r = &block[r * k];
+            for (index_type j = 0; j < k; ++j)
+            {
+              y_r[j] -= U_val[p] * y_c[j];
+            }
+          }
+        }
+      }
+
+      for (index_type j = 0; j < k; ++j)
+      {
+        real_type* x_j = X->getData(j, memory::HOST);
+        for (index_type i = 0; i < n; ++i)
+        {
+          x_j[Q[i]] = block[i * k + j];
+        }
+      }
+      X->setDataUpdated(memory::HOST);
+
+      return 0;
+    }
+
+  } // namespace examples
+} // namespace ReSolve
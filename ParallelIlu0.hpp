@@ -0,0 +1,483 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <resolve/LinSolverDirect.hpp>
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/vector/Vector.hpp>
+#include <resolve/workspace/LinAlgWorkspace.hpp>
+
+#include "ThreadTeam.hpp"
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Multithreaded incomplete LU factorization with zero fill-in.
+     *
+     * Computes ILU0 factors on the sparsity pattern of A and applies them as
+     * a preconditioner with level-scheduled triangular solves. Row i of the
+     * lower (upper) triangular solve depends only on rows j with L(i,j) != 0
+     * (U(i,j) != 0), so rows are grouped into levels, and rows within one
+     * level are processed concurrently by a persistent thread team. Level
+     * schedules are built once in setup(A) and reused by refactorize() and
+     * every solve.
+     *
+     * The factorization is either exact, level-scheduled with the schedule
+     * of the lower triangular solve, or computed with a given number of
+     * Chow-Patel fixed-point sweeps, which update all factor entries in
+     * parallel without any schedule.
+     *
+     * Usage:
+     * ```
+     *   ParallelIlu0Cpu ilu0;
+     *   ilu0.setNumThreads(8);
+     *   ilu0.setNumSweeps(3);  // 0 selects exact factorization
+     *   ilu0.setup(A);
+     *   FGMRES.setupPreconditioner("LU", &ilu0);
+     * ```
+     *
+     * @note The matrix has to be in CSR format with sorted column indices
+     * and a nonzero diagonal. Data is processed on the host.
+     */
+    class ParallelIlu0Cpu : public LinSolverDirect
+    {
+    public:
+      /**
+       * @brief Constructor
+       *
+       * The workspace is not used; it is accepted so the class can replace
+       * LinSolverDirectCpuILU0 in templated code.
+       */
+      explicit ParallelIlu0Cpu(LinAlgWorkspaceCpu* workspace = nullptr)
+      {
+        (void) workspace;
+        setNumThreads(static_cast<int>(std::thread::hardware_concurrency()));
+      }
+
+      ~ParallelIlu0Cpu() = default;
+
+      /// Set number of threads (at least 1).
+      void setNumThreads(int num_threads)
+      {
+        team_.resize(num_threads);
+        allocateWorkspace();
+      }
+
+      /// Number of threads used for factorization and solves.
+      int getNumThreads() const
+      {
+        return team_.getNumThreads();
+      }
+
+      /// Set number of Chow-Patel sweeps; 0 selects exact factorization.
+      void setNumSweeps(int num_sweeps)
+      {
+        num_sweeps_ = std::max(0, num_sweeps);
+      }
+
+      /// Number of Chow-Patel sweeps, 0 for exact factorization.
+      int getNumSweeps() const
+      {
+        return num_sweeps_;
+      }
+
+      /// Number of levels of the lower triangular solve.
+      index_type getNumLowerLevels() const
+      {
+        return lower_.getNumLevels();
+      }
+
+      /// Number of levels of the upper triangular solve.
+      index_type getNumUpperLevels() const
+      {
+        return upper_.getNumLevels();
+      }
+
+      /**
+       * @brief Analyze the pattern of A and compute ILU0 factors.
+       *
+       * @param[in] A - system matrix in CSR format, host data is used
+       * @return 0 if successful, 1 otherwise
+       */
+      int setup(matrix::Sparse* A   = nullptr,
+                matrix::Sparse* L   = nullptr,
+                matrix::Sparse* U   = nullptr,
+                index_type*     P   = nullptr,
+                index_type*     Q   = nullptr,
+                vector_type*    rhs = nullptr) override
+      {
+        (void) L;
+        (void) U;
+        (void) P;
+        (void) Q;
+        (void) rhs;
+        if (A == nullptr)
+        {
+          std::cout << "Parallel ILU0 setup requires a matrix.\n";
+          return 1;
+        }
+        A_       = A;
+        n_       = A->getNumRows();
+        row_ptr_ = A->getRowData(memory::HOST);
+        col_idx_ = A->getColData(memory::HOST);
+
+        diag_pos_.resize(n_);
+        for (index_type i = 0; i < n_; ++i)
+        {
+          const index_type* begin = col_idx_ + row_ptr_[i];
+          const index_type* end   = col_idx_ + row_ptr_[i + 1];
+          const index_type* diag  = std::lower_bound(begin, end, i);
+          if (diag == end || *diag != i)
+          {
+            std::cout << "Parallel ILU0 requires nonzero diagonal, missing in row " << i << ".\n";
+            return 1;
+          }
+          diag_pos_[i] = static_cast<index_type>(diag - col_idx_);
+        }
+
+        lower_.buildLower(n_, row_ptr_, col_idx_, diag_pos_.data());
+        upper_.buildUpper(n_, row_ptr_, col_idx_, diag_pos_.data());
+        values_.resize(row_ptr_[n_]);
+        values_old_.resize(row_ptr_[n_]);
+        allocateWorkspace();
+
+        return refactorize();
+      }
+
+      /**
+       * @brief Recompute factors for the current values of the matrix.
+       *
+       * The matrix must have the pattern it had in setup().
+       *
+       * @return 0 if successful, 1 if a zero pivot was encountered
+       */
+      int refactorize() override
+      {
+        if (A_ == nullptr)
+        {
+          std::cout << "Parallel ILU0 is not set up.\n";
+          return 1;
+        }
+        has_zero_pivot_.store(false);
+        if (num_sweeps_ == 0)
+        {
+          factorizeExact();
+        }
+        else
+        {
+          factorizeIterative();
+        }
+        if (has_zero_pivot_.load())
+        {
+          std::cout << "Parallel ILU0 encountered a zero pivot.\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      /// Apply the preconditioner: x = (L*U)^{-1} * rhs.
+      int solve(vector_type* rhs, vector_type* x) override
+      {
+        if (n_ == 0 || rhs->getSize() != n_ || x->getSize() != n_)
+        {
+          std::cout << "Parallel ILU0 is not set up for this system.\n";
+          return 1;
+        }
+        if (x->getData(memory::HOST) == nullptr)
+        {
+          x->allocate(memory::HOST);
+        }
+        const real_type* b = rhs->getData(memory::HOST);
+        real_type*       y = x->getData(memory::HOST);
+        if (y != b)
+        {
+          std::copy(b, b + n_, y);
+        }
+
+        if (is_parallel_solve_)
+        {
+          lower_.reset();
+          upper_.reset();
+          team_.run([this, y](int)
+                    {
+                      lower_.forEachRow([this, y](index_type i) { lowerSolveRow(i, y); });
+                      upper_.forEachRow([this, y](index_type i) { upperSolveRow(i, y); });
+                    });
+        }
+        else
+        {
+          for (index_type i = 0; i < n_; ++i)
+          {
+            lowerSolveRow(i, y);
+          }
+          for (index_type i = n_ - 1; i >= 0; --i)
+          {
+            upperSolveRow(i, y);
+          }
+        }
+        x->setDataUpdated(memory::HOST);
+        return 0;
+      }
+
+      /// Apply the preconditioner in place.
+      int solve(vector_type* x) override
+      {
+        return solve(x, x);
+      }
+
+      int setCliParam(const std::string id, const std::string value) override
+      {
+        if (id == "num_threads")
+        {
+          setNumThreads(atoi(value.c_str()));
+          return 0;
+        }
+        if (id == "sweeps")
+        {
+          setNumSweeps(atoi(value.c_str()));
+          return 0;
+        }
+        std::cout << "Parallel ILU0 has no parameter " << id << ".\n";
+        return 1;
+      }
+
+      std::string getCliParamString(const std::string /* id */) const override
+      {
+        return "";
+      }
+
+      index_type getCliParamInt(const std::string id) const override
+      {
+        if (id == "num_threads")
+        {
+          return getNumThreads();
+        }
+        if (id == "sweeps")
+        {
+          return getNumSweeps();
+        }
+        return -1;
+      }
+
+      real_type getCliParamReal(const std::string /* id */) const override
+      {
+        return 0.0;
+      }
+
+      bool getCliParamBool(const std::string /* id */) const override
+      {
+        return false;
+      }
+
+      int printCliParam(const std::string id) const override
+      {
+        index_type value = getCliParamInt(id);
+        if (value < 0)
+        {
+          std::cout << "Parallel ILU0 has no parameter " << id << ".\n";
+          return 1;
+        }
+        std::cout << id << " = " << value << "\n";
+        return 0;
+      }
+
+    private:
+      /// Rows a thread takes at once, as from a level of a LevelSchedule.
+      static constexpr index_type CHUNK_SIZE = LevelSchedule::CHUNK_SIZE;
+
+      /// Average level size below which solves run on a single thread.
+      static constexpr index_type MIN_ROWS_PER_LEVEL = 4 * CHUNK_SIZE;
+
+      /// Allocate per-thread work arrays and synchronization for the team.
+      void allocateWorkspace()
+      {
+        int num_threads = team_.getNumThreads();
+        position_.assign(num_threads, std::vector<index_type>(n_, -1));
+        barrier_.reset(new SpinBarrier(num_threads));
+        lower_.setBarrier(barrier_.get());
+        upper_.setBarrier(barrier_.get());
+
+        index_type max_levels = std::max(lower_.getNumLevels(), upper_.getNumLevels());
+        is_parallel_solve_    = num_threads > 1 && n_ >= MIN_ROWS_PER_LEVEL * max_levels;
+      }
+
+      /// Exact ILU0, rows of one level of the lower solve in parallel.
+      void factorizeExact()
+      {
+        const real_type* a = A_->getValues(memory::HOST);
+        std::copy(a, a + row_ptr_[n_], values_.begin());
+
+        lower_.reset();
+        team_.run([this](int tid)
+                  {
+                    index_type* position = position_[tid].data();
+                    lower_.forEachRow([this, position](index_type i) { factorizeRow(i, position); });
+                  });
+      }
+
+      /// Row i of L and U from row i of A and previous rows of U (IKJ variant).
+      void factorizeRow(index_type i, index_type* position)
+      {
+        for (index_type p = row_ptr_[i]; p < row_ptr_[i + 1]; ++p)
+        {
+          position[col_idx_[p]] = p;
+        }
+        for (index_type p = row_ptr_[i]; p < diag_pos_[i]; ++p)
+        {
+          index_type k = col_idx_[p];
+          real_type  l = values_[p] / values_[diag_pos_[k]];
+          values_[p]   = l;
+          for (index_type r = diag_pos_[k] + 1; r < row_ptr_[k + 1]; ++r)
+          {
+            index_type q = position[col_idx_[r]];
+            if (q >= 0)
+            {
+              values_[q] -= l * values_[r];
+            }
+          }
+        }
+        for (index_type p = row_ptr_[i]; p < row_ptr_[i + 1]; ++p)
+        {
+          position[col_idx_[p]] = -1;
+        }
+        if (values_[diag_pos_[i]] == 0.0)
+        {
+          has_zero_pivot_.store(true, std::memory_order_relaxed);
+        }
+      }
+
+      /**
+       * @brief ILU0 with Chow-Patel fixed-point sweeps.
+       *
+       * Starts from L = tril(A) * diag(A)^{-1} and U = triu(A). Each sweep
+       * updates all entries from the values of the previous sweep, so rows
+       * are independent and no level schedule is needed.
+       */
+      void factorizeIterative()
+      {
+        const real_type* a = A_->getValues(memory::HOST);
+        for (index_type i = 0; i < n_; ++i)
+        {
+          for (index_type p = row_ptr_[i]; p < row_ptr_[i + 1]; ++p)
+          {
+            index_type j = col_idx_[p];
+            values_[p]   = (j < i) ? a[p] / a[diag_pos_[j]] : a[p];
+          }
+        }
+
+        for (int sweep = 0; sweep < num_sweeps_; ++sweep)
+        {
+          values_.swap(values_old_);
+          next_row_.store(0, std::memory_order_relaxed);
+          team_.run([this, a](int)
+                    {
+                      for (index_type start = next_row_.fetch_add(CHUNK_SIZE, std::memory_order_relaxed);
+                           start < n_;
+                           start = next_row_.fetch_add(CHUNK_SIZE, std::memory_order_relaxed))
+                      {
+                        index_type stop = std::min(start + CHUNK_SIZE, n_);
+                        for (index_type i = start; i < stop; ++i)
+                        {
+                          sweepRow(i, a);
+                        }
+                      }
+                    });
+        }
+      }
+
+      /// One fixed-point update of row i of L and U.
+      void sweepRow(index_type i, const real_type* a)
+      {
+        for (index_type p = row_ptr_[i]; p < row_ptr_[i + 1]; ++p)
+        {
+          index_type j = col_idx_[p];
+          index_type m = std::min(i, j);
+
+          // s = a_ij - sum_{k < min(i,j)} l_ik * u_kj
+          real_type s = a[p];
+          for (index_type q = row_ptr_[i]; q < row_ptr_[i + 1] && col_idx_[q] < m; ++q)
+          {
+            index_type        k     = col_idx_[q];
+            const index_type* begin = col_idx_ + diag_pos_[k];
+            const index_type* end   = col_idx_ + row_ptr_[k + 1];
+            const index_type* u_kj  = std::lower_bound(begin, end, j);
+            if (u_kj != end && *u_kj == j)
+            {
+              s -= values_old_[q] * values_old_[u_kj - col_idx_];
+            }
+          }
+
+          if (j < i)
+          {
+            real_type u_jj = values_old_[diag_pos_[j]];
+            if (u_jj == 0.0)
+            {
+              has_zero_pivot_.store(true, std::memory_order_relaxed);
+              u_jj = 1.0;
+            }
+            values_[p] = s / u_jj;
+          }
+          else
+          {
+            values_[p] = s;
+          }
+        }
+      }
+
+      /// Forward substitution for row i, L has unit diagonal.
+      void lowerSolveRow(index_type i, real_type* y) const
+      {
+        real_type sum = y[i];
+        for (index_type p = row_ptr_[i]; p < diag_pos_[i]; ++p)
+        {
+          sum -= values_[p] * y[col_idx_[p]];
+        }
+        y[i] = sum;
+      }
+
+      /// Backward substitution for row i.
+      void upperSolveRow(index_type i, real_type* y) const
+      {
+        real_type sum = y[i];
+        for (index_type p = diag_pos_[i] + 1; p < row_ptr_[i + 1]; ++p)
+        {
+          sum -= values_[p] * y[col_idx_[p]];
+        }
+        y[i] = sum / values_[diag_pos_[i]];
+      }
+
+    private:
+      matrix::Sparse*   A_{nullptr};
+      index_type        n_{0};
+      const index_type* row_ptr_{nullptr}; ///< row pointers of A (and factors)
+      const index_type* col_idx_{nullptr}; ///< column indices of A (and factors)
+
+      std::vector<real_type>  values_;     ///< strictly lower part of L and U
+      std::vector<real_type>  values_old_; ///< factor values of the previous sweep
+      std::vector<index_type> diag_pos_;   ///< position of diagonal in each row
+
+      int num_sweeps_{0}; ///< Chow-Patel sweeps, 0 for exact factorization
+
+      LevelSchedule lower_; ///< schedule of forward substitution and factorization
+      LevelSchedule upper_; ///< schedule of backward substitution
+
+      ThreadTeam                           team_;
+      std::unique_ptr<SpinBarrier>         barrier_;
+      std::vector<std::vector<index_type>> position_; ///< factor row positions per thread
+      std::atomic<index_type>              next_row_{0};
+      bool                                 is_parallel_solve_{false};
+
+      std::atomic<bool> has_zero_pivot_{false};
+    };
+
+  } // namespace examples
+} // namespace ReSolve
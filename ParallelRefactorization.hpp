@@ -0,0 +1,529 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <resolve/LinSolverDirect.hpp>
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/vector/Vector.hpp>
+
+#include "ThreadTeam.hpp"
+#include "TriangularSolve.hpp"
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Multithreaded refactorization on the host.
+     *
+     * Refactorizes matrices with the sparsity pattern, pivot sequence and
+     * factor pattern of an initial (KLU) factorization, as refactorization
+     * solvers on GPU do. Rows of the permuted matrix P*A*Q are eliminated
+     * with the row-oriented (IKJ) LU variant. Row i depends only on rows k
+     * with L(i,k) != 0, so rows are grouped into levels of the elimination
+     * dependency graph and rows within one level are factorized concurrently.
+     * Threads take chunks of rows from a shared atomic counter, so work is
+     * balanced dynamically, and synchronize between levels. The threads are
+     * a persistent ThreadTeam reused by every refactorization and solve. Independent
+     * diagonal blocks of the matrix end up in the same levels and are
+     * processed in parallel without a separate block decomposition.
+     *
+     * Triangular solves are done by a TriangularSolveEngine, selected with
+     * setSolveMethod() or the "solve" parameter. Its level schedules are
+     * built in setup() and reused until the next setup.
+     *
+     * Usage:
+     * ```
+     *   KLU.factorize();
+     *   refactor.setup(A, KLU.getLFactorCsr(), KLU.getUFactorCsr(),
+     *                  KLU.getPOrdering(), KLU.getQOrdering());
+     *   ...                    // update values of A
+     *   refactor.refactorize();
+     *   refactor.solve(rhs, x);
+     * ```
+     *
+     * @note Factors have to satisfy P*A*Q = L*U and L has to have unit
+     * diagonal, which holds for KLU factors as configured in Re::Solve.
+     */
+    class ParallelRefactorizationCpu : public LinSolverDirect
+    {
+    public:
+      ParallelRefactorizationCpu()
+      {
+        setNumThreads(static_cast<int>(std::thread::hardware_concurrency()));
+      }
+
+      ~ParallelRefactorizationCpu() = default;
+
+      /// Set number of threads used for refactorization (at least 1).
+      void setNumThreads(int num_threads)
+      {
+        num_threads_ = std::max(1, num_threads);
+        team_.resize(num_threads_);
+        barrier_.reset(new SpinBarrier(num_threads_));
+        levels_.setBarrier(barrier_.get());
+        allocateWorkspace();
+        triangular_solve_.setThreadTeam(&team_);
+      }
+
+      /// Number of threads used for refactorization.
+      int getNumThreads() const
+      {
+        return num_threads_;
+      }
+
+      /// Number of levels in the elimination dependency graph.
+      index_type getNumLevels() const
+      {
+        return levels_.getNumLevels();
+      }
+
+      /// Select triangular solve method used by solve().
+      void setSolveMethod(TriangularSolveMethod method)
+      {
+        triangular_solve_.setMethod(method);
+      }
+
+      /// Triangular solve method used by solve().
+      TriangularSolveMethod getSolveMethod() const
+      {
+        return triangular_solve_.getMethod();
+      }
+
+      /// Levels of the forward plus backward substitution.
+      index_type getNumSolveLevels() const
+      {
+        return triangular_solve_.getNumLowerLevels() + triangular_solve_.getNumUpperLevels();
+      }
+
+      /**
+       * @brief Smallest over largest pivot magnitude of the current factors.
+       *
+       * Tracked during refactorization at the cost of a few comparisons per
+       * row. A drop by orders of magnitude relative to the ratio of the
+       * pivoting (KLU) factorization shows that the pivot sequence is no
+       * longer adequate, before the factors are used in a solve.
+       */
+      real_type getPivotRatio() const
+      {
+        return (pivot_stats_.max_pivot > 0.0) ? pivot_stats_.min_pivot / pivot_stats_.max_pivot : 0.0;
+      }
+
+      /// Largest magnitude in U over largest magnitude in A (element growth).
+      real_type getPivotGrowth() const
+      {
+        return (pivot_stats_.max_a > 0.0) ? pivot_stats_.max_u / pivot_stats_.max_a : 0.0;
+      }
+
+      /**
+       * @brief Analyze factor pattern and build the level schedule.
+       *
+       * @param[in] A   - system matrix in CSR format, host data is used
+       * @param[in] L   - lower triangular factor in CSR format, unit diagonal
+       * @param[in] U   - upper triangular factor in CSR format
+       * @param[in] P   - row permutation, row k of P*A is row P[k] of A
+       * @param[in] Q   - column permutation, column k of A*Q is column Q[k] of A
+       * @param[in] rhs - not used
+       * @return 0 if successful, 1 otherwise
+       *
+       * @post Factors hold the values of L and U, so the system can be solved
+       * before the first refactorization.
+       */
+      int setup(matrix::Sparse* A   = nullptr,
+                matrix::Sparse* L   = nullptr,
+                matrix::Sparse* U   = nullptr,
+                index_type*     P   = nullptr,
+                index_type*     Q   = nullptr,
+                vector_type*    rhs = nullptr) override
+      {
+        (void) rhs;
+        if (A == nullptr || L == nullptr || U == nullptr || P == nullptr || Q == nullptr)
+        {
+          std::cout << "Parallel refactorization setup requires matrix, factors and permutations.\n";
+          return 1;
+        }
+        A_ = A;
+        n_ = A->getNumRows();
+        P_.assign(P, P + n_);
+        Q_.assign(Q, Q + n_);
+
+        buildFactorPattern(L, U);
+        if (buildScatterMap() != 0)
+        {
+          return 1;
+        }
+        // Rows in one level of the forward substitution do not depend on each other
+        levels_.buildLower(n_, row_ptr_.data(), col_idx_.data(), diag_pos_.data());
+        allocateWorkspace();
+        triangular_solve_.analyze(n_, row_ptr_.data(), col_idx_.data(), diag_pos_.data());
+
+        // Pivot statistics of the factors passed in
+        pivot_stats_ = PivotStats();
+        for (index_type i = 0; i < n_; ++i)
+        {
+          pivot_stats_.addRow(values_.data(), diag_pos_[i], row_ptr_[i + 1]);
+        }
+        const real_type* a_values = A_->getValues(memory::HOST);
+        for (index_type p = 0; p < A_->getNnz(); ++p)
+        {
+          pivot_stats_.max_a = std::max(pivot_stats_.max_a, std::abs(a_values[p]));
+        }
+        return 0;
+      }
+
+      /**
+       * @brief Refactorize the current values of the system matrix.
+       *
+       * @return 0 if successful, 1 if a zero pivot was encountered
+       */
+      int refactorize() override
+      {
+        const real_type* a_values = A_->getValues(memory::HOST);
+
+        has_zero_pivot_.store(false);
+        levels_.reset();
+        team_.run([this, a_values](int tid)
+                  { eliminate(tid, a_values); });
+
+        pivot_stats_ = thread_stats_[0];
+        for (int t = 1; t < num_threads_; ++t)
+        {
+          pivot_stats_.merge(thread_stats_[t]);
+        }
+
+        if (has_zero_pivot_.load())
+        {
+          std::cout << "Parallel refactorization encountered a zero pivot.\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      /// Solve A*x = rhs with the current factors.
+      int solve(vector_type* rhs, vector_type* x) override
+      {
+        if (n_ == 0 || rhs->getSize() != n_ || x->getSize() != n_)
+        {
+          std::cout << "Parallel refactorization solver is not set up for this system.\n";
+          return 1;
+        }
+        std::vector<real_type>& y = work_[0];
+        const real_type*        b = rhs->getData(memory::HOST);
+        for (index_type k = 0; k < n_; ++k)
+        {
+          y[k] = b[P_[k]];
+        }
+
+        triangular_solve_.solve(values_.data(), y.data());
+
+        if (x->getData(memory::HOST) == nullptr)
+        {
+          x->allocate(memory::HOST);
+        }
+        real_type* x_data = x->getData(memory::HOST);
+        for (index_type k = 0; k < n_; ++k)
+        {
+          x_data[Q_[k]] = y[k];
+        }
+        x->setDataUpdated(memory::HOST);
+        return 0;
+      }
+
+      /// Solve A*x = x in place with the current factors.
+      int solve(vector_type* x) override
+      {
+        return solve(x, x);
+      }
+
+      /**
+       * @brief Set parameter `id` to `value`.
+       *
+       * Parameters:
+       * - "solve":  triangular solve method (see getTriangularSolveMethod())
+       * - "sweeps": Jacobi sweeps per triangular solve
+       */
+      int setCliParam(const std::string id, const std::string value) override
+      {
+        if (id == "solve")
+        {
+          TriangularSolveMethod method;
+          if (getTriangularSolveMethod(value, method) != 0)
+          {
+            return 1;
+          }
+          setSolveMethod(method);
+          return 0;
+        }
+        if (id == "sweeps")
+        {
+          triangular_solve_.setNumSweeps(atoi(value.c_str()));
+          return 0;
+        }
+        std::cout << "Parallel refactorization solver has no parameter " << id << ".\n";
+        return 1;
+      }
+
+      std::string getCliParamString(const std::string id) const override
+      {
+        if (id == "solve")
+        {
+          return getTriangularSolveMethodName(getSolveMethod());
+        }
+        return "";
+      }
+
+      index_type getCliParamInt(const std::string id) const override
+      {
+        if (id == "sweeps")
+        {
+          return triangular_solve_.getNumSweeps();
+        }
+        return -1;
+      }
+
+      real_type getCliParamReal(const std::string /* id */) const override
+      {
+        return 0.0;
+      }
+
+      bool getCliParamBool(const std::string /* id */) const override
+      {
+        return false;
+      }
+
+      int printCliParam(const std::string id) const override
+      {
+        if (id == "solve")
+        {
+          std::cout << id << " = " << getCliParamString(id) << "\n";
+          return 0;
+        }
+        if (id == "sweeps")
+        {
+          std::cout << id << " = " << getCliParamInt(id) << "\n";
+          return 0;
+        }
+        std::cout << "Parallel refactorization solver has no parameter " << id << ".\n";
+        return 1;
+      }
+
+    private:
+      /// Magnitudes of pivots and factor entries in the rows of one thread.
+      struct PivotStats
+      {
+        real_type min_pivot{std::numeric_limits<real_type>::max()};
+        real_type max_pivot{0.0};
+        real_type max_u{0.0}; ///< largest magnitude in U
+        real_type max_a{0.0}; ///< largest magnitude in A
+
+        /// Add U part of a row, stored in values[diag, end).
+        void addRow(const real_type* values, index_type diag, index_type end)
+        {
+          real_type pivot = std::abs(values[diag]);
+          min_pivot       = std::min(min_pivot, pivot);
+          max_pivot       = std::max(max_pivot, pivot);
+          for (index_type p = diag; p < end; ++p)
+          {
+            max_u = std::max(max_u, std::abs(values[p]));
+          }
+        }
+
+        void merge(const PivotStats& other)
+        {
+          min_pivot = std::min(min_pivot, other.min_pivot);
+          max_pivot = std::max(max_pivot, other.max_pivot);
+          max_u     = std::max(max_u, other.max_u);
+          max_a     = std::max(max_a, other.max_a);
+        }
+      };
+
+      /// Combine L (without its unit diagonal) and U into one CSR pattern.
+      void buildFactorPattern(matrix::Sparse* L, matrix::Sparse* U)
+      {
+        const index_type* L_row = L->getRowData(memory::HOST);
+        const index_type* L_col = L->getColData(memory::HOST);
+        const real_type*  L_val = L->getValues(memory::HOST);
+        const index_type* U_row = U->getRowData(memory::HOST);
+        const index_type* U_col = U->getColData(memory::HOST);
+        const real_type*  U_val = U->getValues(memory::HOST);
+
+        row_ptr_.assign(n_ + 1, 0);
+        diag_pos_.resize(n_);
+        col_idx_.clear();
+        values_.clear();
+        col_idx_.reserve(L->getNnz() + U->getNnz());
+        values_.reserve(L->getNnz() + U->getNnz());
+
+        std::vector<std::pair<index_type, real_type>> row;
+        for (index_type i = 0; i < n_; ++i)
+        {
+          row.clear();
+          for (index_type p = L_row[i]; p < L_row[i + 1]; ++p)
+          {
+            if (L_col[p] < i)
+            {
+              row.emplace_back(L_col[p], L_val[p]);
+            }
+          }
+          for (index_type p = U_row[i]; p < U_row[i + 1]; ++p)
+          {
+            row.emplace_back(U_col[p], U_val[p]);
+          }
+
+          // Elimination processes columns of L in ascending order
+          std::sort(row.begin(), row.end(), [](const auto& a, const auto& b)
+                    { return a.first < b.first; });
+          diag_pos_[i] = static_cast<index_type>(col_idx_.size());
+          for (const auto& entry : row)
+          {
+            if (entry.first < i)
+            {
+              ++diag_pos_[i];
+            }
+            col_idx_.push_back(entry.first);
+            values_.push_back(entry.second);
+          }
+          row_ptr_[i + 1] = static_cast<index_type>(col_idx_.size());
+        }
+      }
+
+      /// Map nonzeros of A to rows and columns of P*A*Q.
+      int buildScatterMap()
+      {
+        const index_type* A_row = A_->getRowData(memory::HOST);
+        const index_type* A_col = A_->getColData(memory::HOST);
+
+        std::vector<index_type> Q_inv(n_);
+        for (index_type k = 0; k < n_; ++k)
+        {
+          Q_inv[Q_[k]] = k;
+        }
+
+        scatter_ptr_.assign(n_ + 1, 0);
+        scatter_col_.clear();
+        scatter_src_.clear();
+        for (index_type i = 0; i < n_; ++i)
+        {
+          index_type row = P_[i];
+          for (index_type p = A_row[row]; p < A_row[row + 1]; ++p)
+          {
+            index_type j = Q_inv[A_col[p]];
+            if (!std::binary_search(col_idx_.begin() + row_ptr_[i], col_idx_.begin() + row_ptr_[i + 1], j))
+            {
+              std::cout << "Matrix entry outside the factor pattern, cannot refactorize.\n";
+              return 1;
+            }
+            scatter_col_.push_back(j);
+            scatter_src_.push_back(p);
+          }
+          scatter_ptr_[i + 1] = static_cast<index_type>(scatter_col_.size());
+        }
+        return 0;
+      }
+
+      /// Allocate per-thread dense work rows and markers.
+      void allocateWorkspace()
+      {
+        work_.assign(num_threads_, std::vector<real_type>(n_, 0.0));
+        mark_.assign(num_threads_, std::vector<index_type>(n_, -1));
+        thread_stats_.assign(num_threads_, PivotStats());
+      }
+
+      /// Work loop of thread `tid` over all levels.
+      void eliminate(int tid, const real_type* a_values)
+      {
+        real_type*  w     = work_[tid].data();
+        index_type* mark  = mark_[tid].data();
+        PivotStats& stats = thread_stats_[tid];
+        stats             = PivotStats();
+
+        levels_.forEachRow([this, a_values, w, mark, &stats](index_type i)
+                           { eliminateRow(i, a_values, w, mark, stats); });
+      }
+
+      /// Compute row i of L and U from row i of P*A*Q and previous rows of U.
+      void eliminateRow(index_type i, const real_type* a_values, real_type* w, index_type* mark, PivotStats& stats)
+      {
+        for (index_type p = row_ptr_[i]; p < row_ptr_[i + 1]; ++p)
+        {
+          w[col_idx_[p]]    = 0.0;
+          mark[col_idx_[p]] = i;
+        }
+        for (index_type q = scatter_ptr_[i]; q < scatter_ptr_[i + 1]; ++q)
+        {
+          w[scatter_col_[q]] += a_values[scatter_src_[q]];
+          stats.max_a = std::max(stats.max_a, std::abs(a_values[scatter_src_[q]]));
+        }
+
+        for (index_type p = row_ptr_[i]; p < diag_pos_[i]; ++p)
+        {
+          index_type k = col_idx_[p];
+          real_type  l = w[k] / values_[diag_pos_[k]];
+          w[k]         = l;
+          for (index_type r = diag_pos_[k] + 1; r < row_ptr_[k + 1]; ++r)
+          {
+            index_type j = col_idx_[r];
+            if (mark[j] == i)
+            {
+              w[j] -= l * values_[r];
+            }
+          }
+        }
+
+        for (index_type p = row_ptr_[i]; p < row_ptr_[i + 1]; ++p)
+        {
+          values_[p] = w[col_idx_[p]];
+        }
+        stats.addRow(values_.data(), diag_pos_[i], row_ptr_[i + 1]);
+        if (values_[diag_pos_[i]] == 0.0)
+        {
+          has_zero_pivot_.store(true, std::memory_order_relaxed);
+        }
+      }
+
+    private:
+      matrix::Sparse* A_{nullptr};
+      index_type      n_{0};
+      int             num_threads_{1};
+
+      std::vector<index_type> P_; ///< row permutation
+      std::vector<index_type> Q_; ///< column permutation
+
+      // Factors of P*A*Q: strictly lower part of L and U in one CSR matrix
+      std::vector<index_type> row_ptr_;
+      std::vector<index_type> col_idx_;
+      std::vector<real_type>  values_;
+      std::vector<index_type> diag_pos_; ///< position of diagonal in each row
+
+      // Positions of A nonzeros in rows and columns of P*A*Q
+      std::vector<index_type> scatter_ptr_;
+      std::vector<index_type> scatter_col_;
+      std::vector<index_type> scatter_src_;
+
+      LevelSchedule levels_; ///< schedule of the elimination
+
+      ThreadTeam                   team_;    ///< threads of refactorization and solves, kept between calls
+      std::unique_ptr<SpinBarrier> barrier_; ///< level barrier of team_
+
+      std::vector<std::vector<real_type>>  work_; ///< dense work row per thread
+      std::vector<std::vector<index_type>> mark_; ///< pattern marker per thread
+
+      std::vector<PivotStats> thread_stats_; ///< pivot statistics per thread
+      PivotStats              pivot_stats_;  ///< pivot statistics of the current factors
+
+      TriangularSolveEngine triangular_solve_; ///< forward and backward substitution
+
+      std::atomic<bool> has_zero_pivot_{false};
+    };
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+
+#include <resolve/matrix/Csr.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Cheap fingerprint of the sparsity pattern of a CSR matrix.
+     *
+     * The fingerprint is a 64-bit FNV-1a hash of matrix size, row pointers
+     * and column indices. It is used to choose between refactorization,
+     * numeric factorization that reuses the symbolic analysis, and full
+     * symbolic analysis when a matrix in a series is updated.
+     *
+     * The hash is computed from host data, which is current in the examples
+     * as matrices are always read on the host.
+     */
+    class PatternFingerprint
+    {
+    public:
+      PatternFingerprint() = default;
+
+      /// Compute fingerprint of the sparsity pattern of `A`.
+      static std::uint64_t compute(matrix::Csr* A)
+      {
+        const index_type  n       = A->getNumRows();
+        const index_type  nnz     = A->getNnz();
+        const index_type* row_ptr = A->getRowData(memory::HOST);
+        const index_type* col_idx = A->getColData(memory::HOST);
+
+        std::uint64_t hash = HASH_SEED;
+        mix(hash, static_cast<std::uint64_t>(n));
+        mix(hash, static_cast<std::uint64_t>(A->getNumColumns()));
+        mix(hash, static_cast<std::uint64_t>(nnz));
+        for (index_type i = 0; i <= n; ++i)
+        {
+          mix(hash, static_cast<std::uint64_t>(row_ptr[i]));
+        }
+        for (index_type k = 0; k < nnz; ++k)
+        {
+          mix(hash, static_cast<std::uint64_t>(col_idx[k]));
+        }
+        return hash;
+      }
+
+      /**
+       * @brief Update fingerprint with the current pattern of `A`.
+       *
+       * @return true if the pattern differs from the one seen in the previous
+       * call (or this is the first call), false otherwise.
+       */
+      bool update(matrix::Csr* A)
+      {
+        std::uint64_t hash       = compute(A);
+        bool          is_changed = !is_set_ || (hash != value_);
+        value_                   = hash;
+        is_set_                  = true;
+        return is_changed;
+      }
+
+      /// Fingerprint recorded by the last update() call.
+      std::uint64_t getValue() const
+      {
+        return value_;
+      }
+
+      /// Forget the recorded pattern, so the next update() reports a change.
+      void reset()
+      {
+        is_set_ = false;
+      }
+
+    private:
+      static constexpr std::uint64_t HASH_SEED  = 14695981039346656037ULL; ///< FNV-1a offset basis
+      static constexpr std::uint64_t HASH_PRIME = 1099511628211ULL;        ///< FNV-1a prime
+
+      /// Add 64-bit word `value` to `hash`.
+      static void mix(std::uint64_t& hash, std::uint64_t value)
+      {
+        hash = (hash ^ value) * HASH_PRIME;
+      }
+
+    private:
+      std::uint64_t value_{0};
+      bool          is_set_{false};
+    };
+
+  } // namespace examples
+} // namespace ReSolve
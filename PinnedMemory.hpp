@@ -0,0 +1,336 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/vector/Vector.hpp>
+
+#if defined(RESOLVE_USE_CUDA)
+#include <cuda_runtime.h>
+#elif defined(RESOLVE_USE_HIP)
+#include <hip/hip_runtime.h>
+#endif
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Page-locks host arrays of matrices and vectors.
+     *
+     * Host-to-device copies from page-locked memory run at full bandwidth
+     * and can be asynchronous. Host arrays owned by Re::Solve objects are
+     * registered in place, so existing `syncData` and `copyDataFrom` calls
+     * benefit without any change.
+     *
+     * Without a GPU backend this class does nothing.
+     *
+     * @pre unpinAll() must be called before pinned objects are deleted.
+     */
+    class HostMemoryPinner
+    {
+    public:
+      HostMemoryPinner() = default;
+
+      ~HostMemoryPinner()
+      {
+        unpinAll();
+      }
+
+      HostMemoryPinner(const HostMemoryPinner&)            = delete;
+      HostMemoryPinner& operator=(const HostMemoryPinner&) = delete;
+
+      /// Page-lock host values of matrix `A` (the sparsity pattern is not updated).
+      int pin(matrix::Csr* A)
+      {
+        return pin(A->getValues(memory::HOST), static_cast<size_t>(A->getNnz()) * sizeof(real_type));
+      }
+
+      /// Page-lock host data of vector `vec`.
+      int pin(vector::Vector* vec)
+      {
+        return pin(vec->getData(memory::HOST),
+                   static_cast<size_t>(vec->getSize()) * vec->getNumVectors() * sizeof(real_type));
+      }
+
+      /// Page-lock `bytes` of host memory starting at `ptr`.
+      int pin(void* ptr, size_t bytes)
+      {
+        if (ptr == nullptr || bytes == 0)
+        {
+          return 1;
+        }
+#if defined(RESOLVE_USE_CUDA)
+        if (cudaHostRegister(ptr, bytes, cudaHostRegisterDefault) != cudaSuccess)
+        {
+          std::cout << "Failed to page-lock host memory.\n";
+          return 1;
+        }
+#elif defined(RESOLVE_USE_HIP)
+        if (hipHostRegister(ptr, bytes, hipHostRegisterDefault) != hipSuccess)
+        {
+          std::cout << "Failed to page-lock host memory.\n";
+          return 1;
+        }
+#endif
+        pinned_.push_back(ptr);
+        return 0;
+      }
+
+      /**
+       * @brief Page-lock `bytes` at `ptr` in place of the region `pinned`.
+       *
+       * Reading a system into an existing matrix or array may reallocate
+       * its host data. Nothing is done while the pointer stays the same.
+       *
+       * @param[in,out] pinned - region pinned by the last call, set to `ptr`
+       * @param[in]     ptr    - current host data
+       * @param[in]     bytes  - size of the current host data
+       */
+      int repin(void*& pinned, void* ptr, size_t bytes)
+      {
+        if (ptr == pinned)
+        {
+          return 0;
+        }
+        unpin(pinned);
+        pinned = ptr;
+        return pin(ptr, bytes);
+      }
+
+      /// Release the page-locked region starting at `ptr`.
+      void unpin(void* ptr)
+      {
+        auto it = std::find(pinned_.begin(), pinned_.end(), ptr);
+        if (it == pinned_.end())
+        {
+          return;
+        }
+#if defined(RESOLVE_USE_CUDA)
+        cudaHostUnregister(ptr);
+#elif defined(RESOLVE_USE_HIP)
+        hipHostUnregister(ptr);
+#endif
+        pinned_.erase(it);
+      }
+
+      /// Release all page-locked regions.
+      void unpinAll()
+      {
+        for (void* ptr : pinned_)
+        {
+#if defined(RESOLVE_USE_CUDA)
+          cudaHostUnregister(ptr);
+#elif defined(RESOLVE_USE_HIP)
+          hipHostUnregister(ptr);
+#else
+          (void) ptr;
+#endif
+        }
+        pinned_.clear();
+      }
+
+    private:
+      std::vector<void*> pinned_;
+    };
+
+    /**
+     * @brief Stream for asynchronous host-to-device copies.
+     *
+     * The stream is non-blocking, so copies issued here do not synchronize
+     * with the solver work running on other streams. Call synchronize()
+     * before the copied data is used.
+     *
+     * Without a GPU backend there is no device memory to copy to, so
+     * copies fail and the helpers below use the ReSolve data transfers.
+     */
+    class AsyncCopyStream
+    {
+    public:
+      AsyncCopyStream()
+      {
+#if defined(RESOLVE_USE_CUDA)
+        cudaStreamCreateWithFlags(&stream_, cudaStreamNonBlocking);
+#elif defined(RESOLVE_USE_HIP)
+        hipStreamCreateWithFlags(&stream_, hipStreamNonBlocking);
+#endif
+      }
+
+      ~AsyncCopyStream()
+      {
+#if defined(RESOLVE_USE_CUDA)
+        cudaStreamSynchronize(stream_);
+        cudaStreamDestroy(stream_);
+#elif defined(RESOLVE_USE_HIP)
+        hipStreamSynchronize(stream_);
+        hipStreamDestroy(stream_);
+#endif
+      }
+
+      AsyncCopyStream(const AsyncCopyStream&)            = delete;
+      AsyncCopyStream& operator=(const AsyncCopyStream&) = delete;
+
+      /// True if copies can be issued, i.e. Re::Solve is built with a GPU backend.
+      static constexpr bool isAvailable()
+      {
+#if defined(RESOLVE_USE_CUDA) || defined(RESOLVE_USE_HIP)
+        return true;
+#else
+        return false;
+#endif
+      }
+
+      /// Enqueue copy of `bytes` from host `src` to device `dst`.
+      int copyHostToDevice(void* dst, const void* src, size_t bytes)
+      {
+#if defined(RESOLVE_USE_CUDA)
+        return cudaMemcpyAsync(dst, src, bytes, cudaMemcpyHostToDevice, stream_) == cudaSuccess ? 0 : 1;
+#elif defined(RESOLVE_USE_HIP)
+        return hipMemcpyAsync(dst, src, bytes, hipMemcpyHostToDevice, stream_) == hipSuccess ? 0 : 1;
+#else
+        (void) dst;
+        (void) src;
+        (void) bytes;
+        std::cout << "Asynchronous copy to device requested without GPU backend.\n";
+        return 1;
+#endif
+      }
+
+      /// Wait until all copies issued on this stream are completed.
+      int synchronize()
+      {
+#if defined(RESOLVE_USE_CUDA)
+        return cudaStreamSynchronize(stream_) == cudaSuccess ? 0 : 1;
+#elif defined(RESOLVE_USE_HIP)
+        return hipStreamSynchronize(stream_) == hipSuccess ? 0 : 1;
+#else
+        return 0;
+#endif
+      }
+
+    private:
+#if defined(RESOLVE_USE_CUDA)
+      cudaStream_t stream_{nullptr};
+#elif defined(RESOLVE_USE_HIP)
+      hipStream_t stream_{nullptr};
+#endif
+    };
+
+    /**
+     * @brief Asynchronously copy `data` from host to device data of `vec`.
+     *
+     * @pre Device data of `vec` is allocated.
+     * @post Device data is marked updated; it may be used only after
+     * `stream.synchronize()`.
+     */
+    inline int copyDataAsync(vector::Vector* vec, const real_type* data, AsyncCopyStream& stream)
+    {
+      real_type* d_data = vec->getData(memory::DEVICE);
+      if (d_data == nullptr || !AsyncCopyStream::isAvailable())
+      {
+        return vec->copyDataFrom(data, memory::HOST, memory::DEVICE);
+      }
+      int status = stream.copyHostToDevice(d_data,
+                                           data,
+                                           static_cast<size_t>(vec->getSize()) * sizeof(real_type));
+      vec->setDataUpdated(memory::DEVICE);
+      return status;
+    }
+
+    /**
+     * @brief Device buffers for the values and right-hand side of the next system.
+     *
+     * Host data of system i+1 is copied into the buffers on a non-blocking
+     * stream while system i is solved. commit() waits for the copies right
+     * before system i+1 is used and moves the data into the device arrays of
+     * the system matrix and right-hand side, which the solvers hold on to.
+     * The device-to-device copy is much faster than the host-to-device
+     * transfer it replaces.
+     *
+     * Usage:
+     * ```
+     *   staged.stage(A_next->getValues(memory::HOST), rhs_next); // before solving system i
+     *   ...                                                      // solve system i
+     *   staged.commit(A, vec_rhs);                               // system i+1 is used next
+     * ```
+     *
+     * @pre Host data passed to stage() is page-locked (see HostMemoryPinner)
+     * and is not modified before commit().
+     */
+    class StagedSystemCopy
+    {
+    public:
+      /**
+       * @brief Constructor
+       *
+       * @param[in] n   - number of matrix rows
+       * @param[in] nnz - number of matrix nonzeros
+       */
+      StagedSystemCopy(index_type n, index_type nnz)
+        : values_(nnz),
+          rhs_(n)
+      {
+        if (AsyncCopyStream::isAvailable())
+        {
+          values_.allocate(memory::DEVICE);
+          rhs_.allocate(memory::DEVICE);
+        }
+      }
+
+      StagedSystemCopy(const StagedSystemCopy&)            = delete;
+      StagedSystemCopy& operator=(const StagedSystemCopy&) = delete;
+
+      /**
+       * @brief Issue copies of host `values` and `rhs` to the device buffers.
+       *
+       * @return 0 if the copies were issued, 1 otherwise (then nothing is staged)
+       */
+      int stage(const real_type* values, const real_type* rhs)
+      {
+        is_staged_ = false;
+        if (!AsyncCopyStream::isAvailable())
+        {
+          return 1;
+        }
+        int status = copyDataAsync(&values_, values, stream_);
+        status += copyDataAsync(&rhs_, rhs, stream_);
+        is_staged_ = (status == 0);
+        return is_staged_ ? 0 : 1;
+      }
+
+      /// True if a stage() is waiting for commit().
+      bool isStaged() const
+      {
+        return is_staged_;
+      }
+
+      /**
+       * @brief Wait for the staged copies and move them into `A` and `vec_rhs`.
+       *
+       * @post Device values of `A` and device data of `vec_rhs` are updated.
+       */
+      int commit(matrix::Csr* A, vector::Vector* vec_rhs)
+      {
+        if (!is_staged_ || A->getNnz() != values_.getSize() || vec_rhs->getSize() != rhs_.getSize())
+        {
+          std::cout << "No staged data for this system.\n";
+          return 1;
+        }
+        is_staged_ = false;
+        int status = stream_.synchronize();
+        status += A->copyValues(values_.getData(memory::DEVICE), memory::DEVICE, memory::DEVICE);
+        status += vec_rhs->copyDataFrom(rhs_.getData(memory::DEVICE), memory::DEVICE, memory::DEVICE);
+        return (status == 0) ? 0 : 1;
+      }
+
+    private:
+      vector::Vector  values_;           ///< staged matrix values on the device
+      vector::Vector  rhs_;              ///< staged right-hand side on the device
+      AsyncCopyStream stream_;           ///< copies of the next system, finished before buffers are freed
+      bool            is_staged_{false}; ///< copies issued and not committed
+    };
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,444 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <resolve/Common.hpp>
+#include <resolve/Profiling.hpp>
+
+#if defined(RESOLVE_USE_CUDA)
+#include <cuda_runtime.h>
+#elif defined(RESOLVE_USE_HIP)
+#include <hip/hip_runtime.h>
+#endif
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Low-overhead recorder for nested profiling ranges.
+     *
+     * Each thread records ranges into its own preallocated ring buffer, so
+     * `push` and `pop` neither allocate nor lock. Aggregated host times per
+     * range name are kept for all ranges; the ring holds the most recent
+     * ranges for the trace output. In GPU builds each range also records
+     * start and stop events on the default stream, and device time of
+     * ranges still in the ring is resolved only when the report is written.
+     *
+     * The report is written at program exit. Its form is selected with the
+     * `RESOLVE_RANGE_TIMER` environment variable:
+     *   - unset or `table` - print per-range table to standard output,
+     *   - `off`            - no report,
+     *   - any other value  - print the table and write Chrome trace JSON
+     *                        (chrome://tracing, Perfetto) to that file.
+     * Ring size per thread is set with `RESOLVE_RANGE_TIMER_CAPACITY`.
+     *
+     * Examples use the recorder through `RESOLVE_RANGE_PUSH/POP` macros when
+     * built with `RESOLVE_EXAMPLES_RANGE_TIMER` defined.
+     */
+    class RangeTimer
+    {
+    public:
+      /// Open range `name`; `name` must outlive the program (e.g. a literal).
+      static void push(const char* name)
+      {
+        threadBuffer().push(name, now());
+      }
+
+      /// Close the innermost open range.
+      static void pop(const char* /* name */)
+      {
+        threadBuffer().pop(now());
+      }
+
+      /// Print the table and write the trace as configured. Called at exit.
+      static void report()
+      {
+        const char* config = std::getenv("RESOLVE_RANGE_TIMER");
+        std::string output = (config == nullptr) ? "table" : config;
+        if (output == "off")
+        {
+          return;
+        }
+
+        Registry&                   registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        for (auto& buffer : registry.buffers)
+        {
+          buffer->resolveDeviceTimes();
+        }
+        printTable(registry);
+        if (output != "table")
+        {
+          writeTrace(registry, output);
+        }
+      }
+
+    private:
+      static constexpr int     MAX_DEPTH        = 64;
+      static constexpr int64_t DEFAULT_CAPACITY = 4096;
+
+#if defined(RESOLVE_USE_CUDA)
+      using event_type = cudaEvent_t;
+#elif defined(RESOLVE_USE_HIP)
+      using event_type = hipEvent_t;
+#endif
+
+      /// Completed (or still open) range in the ring buffer.
+      struct Record
+      {
+        const char* name{nullptr};
+        int64_t     start_ns{0};
+        int64_t     stop_ns{-1}; ///< negative while the range is open
+        int         depth{0};
+        double      device_ms{-1.0}; ///< negative if not available
+      };
+
+      /// Aggregated timings of all ranges with the same name.
+      struct Statistics
+      {
+        const char* name{nullptr};
+        int64_t     count{0};
+        double      total{0.0};
+        double      min{0.0};
+        double      max{0.0};
+        int64_t     device_count{0};
+        double      device_total{0.0};
+      };
+
+      /// Range currently open on a thread.
+      struct OpenRange
+      {
+        const char* name;
+        int64_t     index;
+        int64_t     start_ns;
+      };
+
+      /// Per-thread ring buffer of ranges.
+      class ThreadBuffer
+      {
+      public:
+        ThreadBuffer(int id, int64_t capacity)
+          : id_(id),
+            capacity_(capacity),
+            records_(capacity)
+        {
+          stats_.reserve(64);
+#if defined(RESOLVE_USE_CUDA) || defined(RESOLVE_USE_HIP)
+          start_events_.resize(capacity_);
+          stop_events_.resize(capacity_);
+          for (int64_t k = 0; k < capacity_; ++k)
+          {
+#if defined(RESOLVE_USE_CUDA)
+            cudaEventCreate(&start_events_[k]);
+            cudaEventCreate(&stop_events_[k]);
+#else
+            hipEventCreate(&start_events_[k]);
+            hipEventCreate(&stop_events_[k]);
+#endif
+          }
+#endif
+        }
+
+        void push(const char* name, int64_t time_ns)
+        {
+          if (depth_ >= MAX_DEPTH)
+          {
+            ++depth_;
+            return;
+          }
+          int64_t index = count_++;
+          Record& record = records_[index % capacity_];
+          record         = {name, time_ns, -1, depth_, -1.0};
+          recordEvent(true, index);
+          stack_[depth_++] = {name, index, time_ns};
+        }
+
+        void pop(int64_t time_ns)
+        {
+          if (depth_ == 0)
+          {
+            return;
+          }
+          if (--depth_ >= MAX_DEPTH)
+          {
+            return;
+          }
+          const OpenRange& range = stack_[depth_];
+
+          // Slot may have been reused by newer ranges while this one was open
+          if (range.index + capacity_ >= count_)
+          {
+            recordEvent(false, range.index);
+            records_[range.index % capacity_].stop_ns = time_ns;
+          }
+          addSample(range.name, 1e-9 * static_cast<double>(time_ns - range.start_ns));
+        }
+
+        /// Compute device time of completed ranges still in the ring.
+        void resolveDeviceTimes()
+        {
+#if defined(RESOLVE_USE_CUDA) || defined(RESOLVE_USE_HIP)
+          for (int64_t index = firstIndex(); index < count_; ++index)
+          {
+            int64_t slot   = index % capacity_;
+            Record& record = records_[slot];
+            if (record.stop_ns < 0 || record.device_ms >= 0.0)
+            {
+              continue;
+            }
+            float ms = 0.0f;
+#if defined(RESOLVE_USE_CUDA)
+            bool is_valid = cudaEventSynchronize(stop_events_[slot]) == cudaSuccess
+                            && cudaEventElapsedTime(&ms, start_events_[slot], stop_events_[slot]) == cudaSuccess;
+#else
+            bool is_valid = hipEventSynchronize(stop_events_[slot]) == hipSuccess
+                            && hipEventElapsedTime(&ms, start_events_[slot], stop_events_[slot]) == hipSuccess;
+#endif
+            if (is_valid)
+            {
+              record.device_ms  = ms;
+              Statistics& stats = getStatistics(record.name);
+              stats.device_total += 1e-3 * ms;
+              stats.device_count += 1;
+            }
+          }
+#endif
+        }
+
+        /// Index of the oldest range still in the ring.
+        int64_t firstIndex() const
+        {
+          return std::max<int64_t>(0, count_ - capacity_);
+        }
+
+        int64_t count() const
+        {
+          return count_;
+        }
+
+        int id() const
+        {
+          return id_;
+        }
+
+        const Record& record(int64_t index) const
+        {
+          return records_[index % capacity_];
+        }
+
+        const std::vector<Statistics>& statistics() const
+        {
+          return stats_;
+        }
+
+      private:
+        void addSample(const char* name, double seconds)
+        {
+          Statistics& stats = getStatistics(name);
+          stats.min         = (stats.count == 0) ? seconds : std::min(stats.min, seconds);
+          stats.max         = (stats.count == 0) ? seconds : std::max(stats.max, seconds);
+          stats.total += seconds;
+          stats.count += 1;
+        }
+
+        Statistics& getStatistics(const char* name)
+        {
+          for (Statistics& stats : stats_)
+          {
+            if (stats.name == name || std::strcmp(stats.name, name) == 0)
+            {
+              return stats;
+            }
+          }
+          stats_.emplace_back();
+          stats_.back().name = name;
+          return stats_.back();
+        }
+
+        /// Record start or stop event of range `index` on the default stream.
+        void recordEvent(bool is_start, int64_t index)
+        {
+#if defined(RESOLVE_USE_CUDA)
+          cudaEventRecord(is_start ? start_events_[index % capacity_] : stop_events_[index % capacity_], 0);
+#elif defined(RESOLVE_USE_HIP)
+          hipEventRecord(is_start ? start_events_[index % capacity_] : stop_events_[index % capacity_], 0);
+#else
+          (void) is_start;
+          (void) index;
+#endif
+        }
+
+#if defined(RESOLVE_USE_CUDA) || defined(RESOLVE_USE_HIP)
+        std::vector<event_type> start_events_;
+        std::vector<event_type> stop_events_;
+#endif
+
+        int                               id_;
+        int64_t                           capacity_;
+        int64_t                           count_{0};
+        int                               depth_{0};
+        std::vector<Record>               records_;
+        std::array<OpenRange, MAX_DEPTH>  stack_;
+        std::vector<Statistics>           stats_;
+      };
+
+      /// Buffers of all threads; intentionally never destroyed.
+      struct Registry
+      {
+        std::mutex                                 mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+        std::chrono::steady_clock::time_point      epoch{std::chrono::steady_clock::now()};
+        bool                                       is_report_registered{false};
+      };
+
+      static Registry& getRegistry()
+      {
+        static Registry* registry = new Registry();
+        return *registry;
+      }
+
+      static int64_t now()
+      {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                 std::chrono::steady_clock::now() - getRegistry().epoch)
+          .count();
+      }
+
+      static ThreadBuffer& threadBuffer()
+      {
+        thread_local ThreadBuffer* buffer = createThreadBuffer();
+        return *buffer;
+      }
+
+      static ThreadBuffer* createThreadBuffer()
+      {
+        int64_t     capacity = DEFAULT_CAPACITY;
+        const char* config   = std::getenv("RESOLVE_RANGE_TIMER_CAPACITY");
+        if (config != nullptr && std::atoll(config) > 0)
+        {
+          capacity = std::atoll(config);
+        }
+
+        Registry&                   registry = getRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.buffers.emplace_back(new ThreadBuffer(static_cast<int>(registry.buffers.size()), capacity));
+
+        // Registered after the GPU runtime is initialized by event creation,
+        // so the report runs before the runtime is torn down at exit.
+        if (!registry.is_report_registered)
+        {
+          std::atexit(report);
+          registry.is_report_registered = true;
+        }
+        return registry.buffers.back().get();
+      }
+
+      static void printTable(const Registry& registry)
+      {
+        // Merge statistics of all threads by range name
+        std::vector<Statistics> table;
+        for (const auto& buffer : registry.buffers)
+        {
+          for (const Statistics& stats : buffer->statistics())
+          {
+            auto it = std::find_if(table.begin(), table.end(), [&stats](const Statistics& entry)
+                                   { return std::strcmp(entry.name, stats.name) == 0; });
+            if (it == table.end())
+            {
+              table.push_back(stats);
+              continue;
+            }
+            it->min = std::min(it->min, stats.min);
+            it->max = std::max(it->max, stats.max);
+            it->total += stats.total;
+            it->count += stats.count;
+            it->device_total += stats.device_total;
+            it->device_count += stats.device_count;
+          }
+        }
+        std::sort(table.begin(), table.end(), [](const Statistics& a, const Statistics& b)
+                  { return a.total > b.total; });
+
+        std::cout << "\nRange timings:\n";
+        std::cout << std::left << std::setw(32) << "range" << std::right << std::setw(10) << "calls"
+                  << std::setw(14) << "total [s]" << std::setw(14) << "mean [s]"
+                  << std::setw(14) << "min [s]" << std::setw(14) << "max [s]";
+#if defined(RESOLVE_USE_CUDA) || defined(RESOLVE_USE_HIP)
+        std::cout << std::setw(14) << "device [s]" << std::setw(10) << "ranges";
+#endif
+        std::cout << "\n";
+        for (const Statistics& stats : table)
+        {
+          std::cout << std::left << std::setw(32) << stats.name << std::right << std::setw(10) << stats.count
+                    << std::scientific << std::setprecision(3)
+                    << std::setw(14) << stats.total << std::setw(14) << stats.total / static_cast<double>(stats.count)
+                    << std::setw(14) << stats.min << std::setw(14) << stats.max;
+#if defined(RESOLVE_USE_CUDA) || defined(RESOLVE_USE_HIP)
+          std::cout << std::setw(14) << stats.device_total << std::setw(10) << stats.device_count;
+#endif
+          std::cout << "\n";
+        }
+        std::cout << std::defaultfloat;
+      }
+
+      static void writeTrace(const Registry& registry, const std::string& path)
+      {
+        std::ofstream out(path);
+        if (!out.is_open())
+        {
+          std::cout << "Failed to open file " << path << "\n";
+          return;
+        }
+        out << std::fixed << std::setprecision(3);
+        out << "{\"traceEvents\": [\n";
+        bool is_first = true;
+        for (const auto& buffer : registry.buffers)
+        {
+          for (int64_t index = buffer->firstIndex(); index < buffer->count(); ++index)
+          {
+            const Record& record = buffer->record(index);
+            if (record.stop_ns < 0)
+            {
+              continue;
+            }
+            out << (is_first ? "  " : ",\n  ")
+                << "{\"name\": \"" << record.name << "\", \"ph\": \"X\", \"pid\": 0"
+                << ", \"tid\": " << buffer->id()
+                << ", \"ts\": " << 1e-3 * static_cast<double>(record.start_ns)
+                << ", \"dur\": " << 1e-3 * static_cast<double>(record.stop_ns - record.start_ns)
+                << ", \"args\": {\"depth\": " << record.depth;
+            if (record.device_ms >= 0.0)
+            {
+              out << ", \"device_us\": " << 1e3 * record.device_ms;
+            }
+            out << "}}";
+            is_first = false;
+          }
+        }
+        out << "\n]}\n";
+        std::cout << "Range trace written to " << path << "\n";
+      }
+    };
+
+  } // namespace examples
+} // namespace ReSolve
+
+#ifdef RESOLVE_EXAMPLES_RANGE_TIMER
+#undef RESOLVE_RANGE_PUSH
+#undef RESOLVE_RANGE_POP
+#define RESOLVE_RANGE_PUSH(name) ReSolve::examples::RangeTimer::push(name)
+#define RESOLVE_RANGE_POP(name) ReSolve::examples::RangeTimer::pop(name)
+#endif
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <resolve/matrix/Csc.hpp>
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/MatrixHandler.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Persistent factor storage for refactorization solver setup.
+     *
+     * Keeps CSR copies of KLU factors that are reused across redone
+     * factorizations and reallocated only when the fill grows, so the
+     * CSC to CSR conversion writes into existing buffers. It also records
+     * the pivot sequence and factor pattern of the last refactorization
+     * setup. When a redone KLU factorization yields the same ones, the
+     * refactorization solver is already set up for it, and the expensive
+     * setup can be skipped.
+     *
+     * Usage:
+     * ```
+     *   KLU->factorize();
+     *   if (factors.update(L_csc, U_csc, P, Q))
+     *   {
+     *     factors.convert(matrix_handler, L_csc, U_csc, memory::DEVICE);
+     *     Rf->setup(A, factors.getL(), factors.getU(), P, Q);
+     *   }
+     *   Rf->refactorize();
+     * ```
+     */
+    class RefactorizationFactors
+    {
+    public:
+      RefactorizationFactors() = default;
+
+      ~RefactorizationFactors()
+      {
+        delete L_;
+        delete U_;
+      }
+
+      RefactorizationFactors(const RefactorizationFactors&)            = delete;
+      RefactorizationFactors& operator=(const RefactorizationFactors&) = delete;
+
+      /**
+       * @brief Record pivot sequence and factor pattern of a new factorization.
+       *
+       * @param[in] L - lower triangular factor in CSC format, host data current
+       * @param[in] U - upper triangular factor in CSC format, host data current
+       * @param[in] P - row permutation
+       * @param[in] Q - column permutation
+       * @return true if permutations or factor patterns differ from the last
+       * recorded ones (or none were recorded), false otherwise.
+       */
+      bool update(matrix::Csc* L, matrix::Csc* U, const index_type* P, const index_type* Q)
+      {
+        index_type n          = L->getNumRows();
+        bool       is_changed = !is_set_ || static_cast<index_type>(P_.size()) != n;
+        is_changed            = updatePattern(L, L_pattern_) || is_changed;
+        is_changed            = updatePattern(U, U_pattern_) || is_changed;
+        if (!is_changed)
+        {
+          is_changed = !std::equal(P, P + n, P_.begin()) || !std::equal(Q, Q + n, Q_.begin());
+        }
+        P_.assign(P, P + n);
+        Q_.assign(Q, Q + n);
+        is_set_ = true;
+        return is_changed;
+      }
+
+      /**
+       * @brief Convert CSC factors to CSR in persistent buffers.
+       *
+       * @param[in] matrix_handler - handler performing the conversion
+       * @param[in] L_csc          - lower triangular factor in CSC format
+       * @param[in] U_csc          - upper triangular factor in CSC format
+       * @param[in] memspace       - memory space where to convert
+       * @return 0 if successful, error code otherwise
+       *
+       * @post getL() and getU() hold the factors in CSR format.
+       */
+      int convert(MatrixHandler*      matrix_handler,
+                  matrix::Csc*        L_csc,
+                  matrix::Csc*        U_csc,
+                  memory::MemorySpace memspace)
+      {
+        reserve(L_, L_capacity_, L_csc);
+        reserve(U_, U_capacity_, U_csc);
+        L_csc->syncData(memspace);
+        U_csc->syncData(memspace);
+        int status = matrix_handler->csc2csr(L_csc, L_, memspace);
+        status += matrix_handler->csc2csr(U_csc, U_, memspace);
+        return status;
+      }
+
+      /// Lower triangular factor in CSR format.
+      matrix::Csr* getL()
+      {
+        return L_;
+      }
+
+      /// Upper triangular factor in CSR format.
+      matrix::Csr* getU()
+      {
+        return U_;
+      }
+
+      /// Forget the recorded setup, so the next update() reports a change.
+      void reset()
+      {
+        is_set_ = false;
+      }
+
+    private:
+      /// Pattern of a CSC factor (column pointers and row indices).
+      struct Pattern
+      {
+        std::vector<index_type> col_ptr;
+        std::vector<index_type> row_idx;
+      };
+
+      /// Store pattern of `M` in `pattern`, return true if it changed.
+      static bool updatePattern(matrix::Csc* M, Pattern& pattern)
+      {
+        index_type        m       = M->getNumColumns();
+        index_type        nnz     = M->getNnz();
+        const index_type* col_ptr = M->getColData(memory::HOST);
+        const index_type* row_idx = M->getRowData(memory::HOST);
+
+        bool is_changed = static_cast<index_type>(pattern.col_ptr.size()) != m + 1
+                          || static_cast<index_type>(pattern.row_idx.size()) != nnz
+                          || !std::equal(col_ptr, col_ptr + m + 1, pattern.col_ptr.begin())
+                          || !std::equal(row_idx, row_idx + nnz, pattern.row_idx.begin());
+        if (is_changed)
+        {
+          pattern.col_ptr.assign(col_ptr, col_ptr + m + 1);
+          pattern.row_idx.assign(row_idx, row_idx + nnz);
+        }
+        return is_changed;
+      }
+
+      /// Make sure `M` can hold the factor `M_csc`; grow only if fill grew.
+      static void reserve(matrix::Csr*& M, index_type& capacity, matrix::Csc* M_csc)
+      {
+        index_type nnz = M_csc->getNnz();
+        if (M == nullptr || nnz > capacity || M->getNumRows() != M_csc->getNumRows())
+        {
+          delete M;
+          M        = new matrix::Csr(M_csc->getNumRows(), M_csc->getNumColumns(), nnz);
+          capacity = nnz;
+        }
+        M->setNnz(nnz);
+      }
+
+    private:
+      matrix::Csr* L_{nullptr}; ///< lower triangular factor in CSR format
+      matrix::Csr* U_{nullptr}; ///< upper triangular factor in CSR format
+
+      index_type L_capacity_{0}; ///< number of nonzeros L_ storage can hold
+      index_type U_capacity_{0}; ///< number of nonzeros U_ storage can hold
+
+      Pattern                 L_pattern_; ///< pattern of L at the last setup
+      Pattern                 U_pattern_; ///< pattern of U at the last setup
+      std::vector<index_type> P_;         ///< row permutation at the last setup
+      std::vector<index_type> Q_;         ///< column permutation at the last setup
+
+      bool is_set_{false};
+    };
+
+    /**
+     * @brief Replace a refactorization solver before a new setup.
+     *
+     * Setup of cusolverRf and rocsolverRf creates library handles and device
+     * data for one pivot sequence, and a second setup of the same object does
+     * not release them. A new pivot sequence is therefore set up on a new
+     * solver object. KLU, which holds the symbolic analysis, is kept, so only
+     * the numeric factorization has to be redone.
+     *
+     * SystemSolver owns its refactorization solver and cannot replace it, so
+     * drivers using SystemSolver need a new SystemSolver instead.
+     *
+     * @param[in,out] solver - solver to replace
+     * @param[in]     args   - constructor arguments of the new solver
+     */
+    template <class solver_type, class... Args>
+    void renewRefactorizationSolver(std::unique_ptr<solver_type>& solver, Args&&... args)
+    {
+      solver.reset();
+      solver = std::make_unique<solver_type>(std::forward<Args>(args)...);
+    }
+
+    /// Overload for solvers owned through a raw pointer.
+    template <class solver_type, class... Args>
+    void renewRefactorizationSolver(solver_type*& solver, Args&&... args)
+    {
+      delete solver;
+      solver = new solver_type(std::forward<Args>(args)...);
+    }
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <resolve/Common.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Decides when to redo host factorization in a series of systems.
+     *
+     * Refactorization reuses the pivot sequence of the last host (KLU)
+     * factorization. As the matrix values drift, the refactorized factors
+     * become poorer preconditioners and iterative refinement needs more
+     * iterations. The policy tracks, for each step, the refactorization
+     * status, the relative residual, the number of refinement iterations
+     * and the effective stability of FGMRES, all of which the drivers
+     * already have.
+     *
+     * Host factorization is requested when
+     *  - the solution is not acceptable (refactorization failed, or the
+     *    residual is not finite or above the tolerance), or
+     *  - the refinement work spent since the last factorization in excess
+     *    of the work on the first refined step after it exceeds the
+     *    measured cost of that factorization, or
+     *  - the effective stability grew too large compared to its value right
+     *    after the last factorization.
+     *
+     * Without iterative refinement (zero iterations reported) only the
+     * first rule applies.
+     *
+     * Refactorization solvers that report a pivot ratio (smallest over
+     * largest pivot magnitude) can be checked with checkPivotRatio() right
+     * after refactorization, before the triangular solve and refinement
+     * are spent on inadequate factors.
+     */
+    class RefactorizationPolicy
+    {
+    public:
+      /**
+       * @brief Constructor
+       *
+       * @param[in] tolerance - largest acceptable relative residual norm
+       */
+      RefactorizationPolicy(real_type tolerance = 1e-7)
+        : tolerance_(tolerance)
+      {
+      }
+
+      /// Set largest acceptable relative residual norm.
+      void setTolerance(real_type tolerance)
+      {
+        tolerance_ = tolerance;
+      }
+
+      /// Set largest allowed growth of effective stability (0 disables the check).
+      void setStabilityGrowthLimit(real_type limit)
+      {
+        stability_growth_limit_ = limit;
+      }
+
+      /// Set largest allowed drop of the pivot ratio (0 disables the check).
+      void setPivotRatioDropLimit(real_type limit)
+      {
+        pivot_ratio_drop_limit_ = limit;
+      }
+
+      /**
+       * @brief Record a host factorization.
+       *
+       * @param[in] seconds - wall time of the factorization and the
+       * refactorization solver setup that follows it
+       */
+      void recordFactorization(double seconds)
+      {
+        factorization_cost_ = seconds;
+        excess_cost_        = 0.0;
+        baseline_iter_      = 0;
+        baseline_stability_ = 0.0;
+        is_acceptable_      = true;
+        is_needed_          = false;
+        reason_.clear();
+        resetPivotRatio();
+      }
+
+      /// Forget the pivot ratio baseline, e.g. after a new pivoting factorization.
+      void resetPivotRatio()
+      {
+        baseline_pivot_ratio_ = 0.0;
+      }
+
+      /**
+       * @brief Set the pivot ratio baseline of the current pivot sequence.
+       *
+       * Used when the factors of the pivoting factorization are not at hand,
+       * e.g. when the pivot sequence was loaded from a SymbolicAnalysisCache.
+       */
+      void setPivotRatioBaseline(real_type pivot_ratio)
+      {
+        baseline_pivot_ratio_ = pivot_ratio;
+      }
+
+      /**
+       * @brief Check pivot ratio of a refactorization before it is used.
+       *
+       * The first nonzero ratio after a host factorization is the baseline.
+       * A refactorization is rejected, and host factorization requested, if
+       * its ratio dropped below `limit * baseline` (see
+       * setPivotRatioDropLimit()).
+       *
+       * @param[in] pivot_ratio - smallest over largest pivot magnitude
+       * @return true if the factors can be used, false otherwise
+       */
+      bool checkPivotRatio(real_type pivot_ratio)
+      {
+        if (baseline_pivot_ratio_ <= 0.0)
+        {
+          baseline_pivot_ratio_ = pivot_ratio;
+          return pivot_ratio > 0.0;
+        }
+        if (pivot_ratio_drop_limit_ > 0.0
+            && !(pivot_ratio >= pivot_ratio_drop_limit_ * baseline_pivot_ratio_))
+        {
+          is_needed_ = true;
+          reason_    = "pivot ratio dropped";
+          return false;
+        }
+        return true;
+      }
+
+      /**
+       * @brief Record results of a step solved with refactorization.
+       *
+       * @param[in] status       - refactorization status (0 if successful)
+       * @param[in] rel_residual - relative residual norm of the final solution
+       * @param[in] num_iter     - number of refinement iterations (0 if none)
+       * @param[in] stability    - FGMRES effective stability (0 if none)
+       * @param[in] ir_seconds   - wall time of the refinement
+       */
+      void recordStep(int        status,
+                      real_type  rel_residual,
+                      index_type num_iter   = 0,
+                      real_type  stability  = 0.0,
+                      double     ir_seconds = 0.0)
+      {
+        // Steps that needed no refinement do not set the baseline, so any
+        // later refinement work is not compared against zero iterations
+        if (baseline_iter_ == 0 && num_iter > 0)
+        {
+          baseline_iter_      = num_iter;
+          baseline_stability_ = stability;
+        }
+        if (num_iter > 0)
+        {
+          time_per_iter_ = ir_seconds / static_cast<double>(num_iter);
+        }
+        if (baseline_iter_ > 0)
+        {
+          excess_cost_ += static_cast<double>(std::max(num_iter - baseline_iter_, 0)) * time_per_iter_;
+        }
+
+        is_acceptable_ = (status == 0) && std::isfinite(rel_residual) && (rel_residual <= tolerance_);
+        is_needed_     = true;
+        if (status != 0)
+        {
+          reason_ = "refactorization failed";
+        }
+        else if (!is_acceptable_)
+        {
+          reason_ = "residual norm is too large";
+        }
+        else if (factorization_cost_ > 0.0 && excess_cost_ > factorization_cost_)
+        {
+          reason_ = "refinement cost exceeds factorization cost";
+        }
+        else if (stability_growth_limit_ > 0.0 && baseline_stability_ > 0.0
+                 && stability > stability_growth_limit_ * baseline_stability_)
+        {
+          reason_ = "effective stability degraded";
+        }
+        else
+        {
+          is_needed_ = false;
+          reason_.clear();
+        }
+      }
+
+      /// True if the solution of the last recorded step meets the tolerance.
+      bool isSolutionAcceptable() const
+      {
+        return is_acceptable_;
+      }
+
+      /// True if host factorization should be redone.
+      bool isRefactorizationNeeded() const
+      {
+        return is_needed_;
+      }
+
+      /// Reason why host factorization is needed (empty if it is not).
+      const std::string& getReason() const
+      {
+        return reason_;
+      }
+
+      /// Print cost model state.
+      void printSummary() const
+      {
+        std::cout << std::scientific << std::setprecision(3)
+                  << "\t Refactorization policy: factorization cost " << factorization_cost_
+                  << " s, excess refinement cost " << excess_cost_ << " s\n";
+      }
+
+    private:
+      real_type tolerance_;                    ///< largest acceptable relative residual
+      real_type stability_growth_limit_{1e2};  ///< allowed effective stability growth
+      real_type pivot_ratio_drop_limit_{1e-3}; ///< allowed pivot ratio drop
+
+      double     factorization_cost_{0.0};   ///< time of the last host factorization
+      double     excess_cost_{0.0};          ///< refinement time above baseline since then
+      double     time_per_iter_{0.0};        ///< time of one refinement iteration
+      index_type baseline_iter_{0};          ///< iterations on the first refined step after factorization
+      real_type  baseline_stability_{0.0};   ///< effective stability on that step
+      real_type  baseline_pivot_ratio_{0.0}; ///< first pivot ratio after factorization
+
+      bool        is_acceptable_{true};
+      bool        is_needed_{false};
+      std::string reason_;
+    };
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <resolve/LinSolverDirect.hpp>
+#include <resolve/matrix/Sparse.hpp>
+#include <resolve/vector/Vector.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Triangular solves with single precision copies of LU factors.
+     *
+     * Factors computed in double precision (e.g. by KLU) are stored in single
+     * precision and used for forward and backward substitution, halving the
+     * memory traffic of the solve. Right-hand side and solution vectors stay
+     * in double precision, so the solver can be used as the "LU"
+     * preconditioner of double precision FGMRES, which recovers the accuracy
+     * lost in the factors.
+     *
+     * Usage:
+     * ```
+     *   KLU.factorize();  // or KLU.refactorize()
+     *   lu.setup(A, KLU.getLFactorCsr(), KLU.getUFactorCsr(),
+     *            KLU.getPOrdering(), KLU.getQOrdering());
+     *   FGMRES.setupPreconditioner("LU", &lu);
+     * ```
+     *
+     * @note Factors have to satisfy P*A*Q = L*U, which holds for KLU factors
+     * as configured in Re::Solve (no row scaling, no block triangular form).
+     * Data is processed on the host.
+     */
+    class SinglePrecisionLU : public LinSolverDirect
+    {
+    public:
+      SinglePrecisionLU()  = default;
+      ~SinglePrecisionLU() = default;
+
+      /**
+       * @brief Store single precision copies of factors of A.
+       *
+       * May be called again after the factors are recomputed; pattern
+       * storage is reused if the fill-in is unchanged.
+       *
+       * @param[in] A - system matrix (used for its size only)
+       * @param[in] L - lower triangular factor in CSR format, with diagonal
+       * @param[in] U - upper triangular factor in CSR format, with diagonal
+       * @param[in] P - row permutation, row k of P*A is row P[k] of A
+       * @param[in] Q - column permutation, column k of A*Q is column Q[k] of A
+       * @return 0 if successful, 1 otherwise
+       */
+      int setup(matrix::Sparse* A   = nullptr,
+                matrix::Sparse* L   = nullptr,
+                matrix::Sparse* U   = nullptr,
+                index_type*     P   = nullptr,
+                index_type*     Q   = nullptr,
+                vector_type*    rhs = nullptr) override
+      {
+        (void) rhs;
+        if (A == nullptr || L == nullptr || U == nullptr || P == nullptr || Q == nullptr)
+        {
+          std::cout << "Single precision LU setup requires matrix, factors and permutations.\n";
+          return 1;
+        }
+        n_ = A->getNumRows();
+        copyFactor(L, L_);
+        copyFactor(U, U_);
+        P_.assign(P, P + n_);
+        Q_.assign(Q, Q + n_);
+        work_.resize(n_);
+        return 0;
+      }
+
+      /// Solve A*x = rhs with single precision factors.
+      int solve(vector_type* rhs, vector_type* x) override
+      {
+        if (n_ == 0 || rhs->getSize() != n_ || x->getSize() != n_)
+        {
+          std::cout << "Single precision LU solver is not set up for this system.\n";
+          return 1;
+        }
+        const real_type* b = rhs->getData(memory::HOST);
+        for (index_type k = 0; k < n_; ++k)
+        {
+          work_[k] = static_cast<float>(b[P_[k]]);
+        }
+        lowerSolve();
+        upperSolve();
+
+        if (x->getData(memory::HOST) == nullptr)
+        {
+          x->allocate(memory::HOST);
+        }
+        real_type* y = x->getData(memory::HOST);
+        for (index_type k = 0; k < n_; ++k)
+        {
+          y[Q_[k]] = static_cast<real_type>(work_[k]);
+        }
+        x->setDataUpdated(memory::HOST);
+        return 0;
+      }
+
+      /// Solve A*x = x in place with single precision factors.
+      int solve(vector_type* x) override
+      {
+        return solve(x, x);
+      }
+
+      /// Memory used by single precision factor values in bytes.
+      size_t getFactorValuesSize() const
+      {
+        return (L_.values.size() + U_.values.size()) * sizeof(float);
+      }
+
+      int setCliParam(const std::string /* id */, const std::string /* value */) override
+      {
+        return 1;
+      }
+
+      std::string getCliParamString(const std::string /* id */) const override
+      {
+        return "";
+      }
+
+      index_type getCliParamInt(const std::string /* id */) const override
+      {
+        return -1;
+      }
+
+      real_type getCliParamReal(const std::string /* id */) const override
+      {
+        return 0.0;
+      }
+
+      bool getCliParamBool(const std::string /* id */) const override
+      {
+        return false;
+      }
+
+      int printCliParam(const std::string /* id */) const override
+      {
+        std::cout << "Single precision LU solver has no parameters.\n";
+        return 0;
+      }
+
+    private:
+      /// Triangular factor in CSR format with single precision values.
+      struct Factor
+      {
+        std::vector<index_type> row_ptr;
+        std::vector<index_type> col_idx;
+        std::vector<float>      values;
+      };
+
+      static void copyFactor(matrix::Sparse* M, Factor& factor)
+      {
+        index_type        n       = M->getNumRows();
+        index_type        nnz     = M->getNnz();
+        const index_type* row_ptr = M->getRowData(memory::HOST);
+        const index_type* col_idx = M->getColData(memory::HOST);
+        const real_type*  values  = M->getValues(memory::HOST);
+
+        factor.row_ptr.assign(row_ptr, row_ptr + n + 1);
+        factor.col_idx.assign(col_idx, col_idx + nnz);
+        factor.values.resize(nnz);
+        for (index_type k = 0; k < nnz; ++k)
+        {
+          factor.values[k] = static_cast<float>(values[k]);
+        }
+      }
+
+      /// Forward substitution L*z = work_ in place; diagonal of L is stored.
+      void lowerSolve()
+      {
+        for (index_type i = 0; i < n_; ++i)
+        {
+          float sum  = work_[i];
+          float diag = 1.0f;
+          for (index_type k = L_.row_ptr[i]; k < L_.row_ptr[i + 1]; ++k)
+          {
+            index_type j = L_.col_idx[k];
+            if (j < i)
+            {
+              sum -= L_.values[k] * work_[j];
+            }
+            else if (j == i)
+            {
+              diag = L_.values[k];
+            }
+          }
+          work_[i] = sum / diag;
+        }
+      }
+
+      /// Backward substitution U*w = work_ in place.
+      void upperSolve()
+      {
+        for (index_type i = n_ - 1; i >= 0; --i)
+        {
+          float sum  = work_[i];
+          float diag = 1.0f;
+          for (index_type k = U_.row_ptr[i]; k < U_.row_ptr[i + 1]; ++k)
+          {
+            index_type j = U_.col_idx[k];
+            if (j > i)
+            {
+              sum -= U_.values[k] * work_[j];
+            }
+            else if (j == i)
+            {
+              diag = U_.values[k];
+            }
+          }
+          work_[i] = sum / diag;
+        }
+      }
+
+    private:
+      index_type n_{0};
+
+      Factor L_; ///< lower triangular factor
+      Factor U_; ///< upper triangular factor
+
+      std::vector<index_type> P_; ///< row permutation
+      std::vector<index_type> Q_; ///< column permutation
+
+      std::vector<float> work_; ///< permuted right-hand side and solution
+    };
+
+  } // namespace examples
+} // namespace ReSolve
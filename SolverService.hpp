@@ -0,0 +1,449 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/vector/Vector.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /// Types of messages exchanged with the solver service.
+    enum class ServiceMessageType : uint32_t
+    {
+      pattern  = 1, ///< sparsity pattern: row pointers, column indices
+      system   = 2, ///< matrix values and right-hand side
+      solution = 3, ///< solver status, residual norm and solution
+      shutdown = 4  ///< stop the service
+    };
+
+    /**
+     * @brief Header preceding every solver service message.
+     *
+     * Message layouts:
+     * ```
+     *   pattern:  [header][row_ptr (num_rows+1)][col_idx (nnz)]
+     *   system:   [header][values (nnz)][rhs (num_rows)]
+     *   solution: [header][x (num_rows)]
+     *   shutdown: [header]
+     * ```
+     */
+    struct ServiceMessageHeader
+    {
+      char     magic[4];      ///< Message signature "RSVC"
+      uint32_t type;          ///< ServiceMessageType
+      uint32_t index_size;    ///< sizeof(index_type) of the sender
+      uint32_t real_size;     ///< sizeof(real_type) of the sender
+      int64_t  num_rows;      ///< Number of matrix rows
+      int64_t  nnz;           ///< Number of matrix nonzeros
+      int32_t  status;        ///< Solver status (solution messages)
+      uint32_t reserved;      ///< Padding, always zero
+      double   residual_norm; ///< Relative residual norm (solution messages)
+    };
+
+    /**
+     * @brief Channel to a solver service over a pair of pipes.
+     *
+     * Requests (patterns, systems, shutdown) and solutions are sent over
+     * two named pipes (FIFOs), `<basename>.req` and `<basename>.sol`. The
+     * pipes may also be replaced by any pair of connected file descriptors
+     * (e.g. a socket). Data is read directly into the arrays of the matrix
+     * and vectors, so no intermediate copies are made, and the solver keeps
+     * its factorization state between requests.
+     *
+     * The service opens the request pipe first and the client must do the
+     * same, otherwise both sides block opening the pipes.
+     *
+     * Service usage:
+     * ```
+     *   channel.openService(basename);
+     *   while (channel.receiveHeader(header) == 0)
+     *   {
+     *     switch (header.type) ...  // receivePattern(), receiveSystem()
+     *     channel.sendSolution(status, residual_norm, x);
+     *   }
+     * ```
+     *
+     * Client usage:
+     * ```
+     *   channel.openClient(basename);
+     *   channel.sendPattern(n, nnz, row_ptr, col_idx);
+     *   for each system:
+     *     channel.sendSystem(n, nnz, values, rhs);
+     *     channel.receiveSolution(n, x, status, residual_norm);
+     *   channel.sendShutdown();
+     * ```
+     */
+    class ServiceChannel
+    {
+    public:
+      ServiceChannel() = default;
+
+      ~ServiceChannel()
+      {
+        close();
+      }
+
+      ServiceChannel(const ServiceChannel&)            = delete;
+      ServiceChannel& operator=(const ServiceChannel&) = delete;
+
+      /// Request pipe name for channel `basename`.
+      static std::string getRequestPipeName(const std::string& basename)
+      {
+        return basename + ".req";
+      }
+
+      /// Solution pipe name for channel `basename`.
+      static std::string getSolutionPipeName(const std::string& basename)
+      {
+        return basename + ".sol";
+      }
+
+      /**
+       * @brief Create the pipes if needed and wait for a client to connect.
+       *
+       * @return 0 if successful, 1 otherwise
+       */
+      int openService(const std::string& basename)
+      {
+        std::string request_pipe  = getRequestPipeName(basename);
+        std::string solution_pipe = getSolutionPipeName(basename);
+        if (createPipe(request_pipe) != 0 || createPipe(solution_pipe) != 0)
+        {
+          return 1;
+        }
+        return open(request_pipe, O_RDONLY, input_fd_) || open(solution_pipe, O_WRONLY, output_fd_);
+      }
+
+      /**
+       * @brief Connect to a running service.
+       *
+       * @return 0 if successful, 1 otherwise
+       */
+      int openClient(const std::string& basename)
+      {
+        return open(getRequestPipeName(basename), O_WRONLY, output_fd_)
+               || open(getSolutionPipeName(basename), O_RDONLY, input_fd_);
+      }
+
+      /// Use already connected file descriptors (not closed by the channel).
+      void attach(int input_fd, int output_fd)
+      {
+        close();
+        input_fd_  = input_fd;
+        output_fd_ = output_fd;
+        is_owner_  = false;
+      }
+
+      /// Close the pipes.
+      void close()
+      {
+        if (is_owner_)
+        {
+          if (input_fd_ >= 0)
+          {
+            ::close(input_fd_);
+          }
+          if (output_fd_ >= 0)
+          {
+            ::close(output_fd_);
+          }
+        }
+        input_fd_  = -1;
+        output_fd_ = -1;
+        is_owner_  = true;
+      }
+
+      /**
+       * @brief Read the header of the next message.
+       *
+       * @return 0 if a valid header was read, 1 if the peer closed the
+       * channel or the header is invalid
+       */
+      int receiveHeader(ServiceMessageHeader& header)
+      {
+        if (!read(&header, 1))
+        {
+          return 1;
+        }
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+            || header.index_size != sizeof(index_type)
+            || header.real_size != sizeof(real_type)
+            || header.num_rows < 0
+            || header.nnz < 0)
+        {
+          std::cout << "Received invalid solver service message.\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      /**
+       * @brief Read the body of a pattern message into a new CSR matrix.
+       *
+       * Matrix values are set to zero; they are received with the next
+       * system message. The pattern comes from an untrusted client, so it is
+       * checked before it reaches the solvers. An invalid pattern is
+       * answered with an error reply, and the client should disconnect.
+       *
+       * @param[in] header - header of the pattern message
+       * @return new matrix, nullptr if the pattern could not be read or is invalid
+       */
+      matrix::Csr* receivePattern(const ServiceMessageHeader& header)
+      {
+        constexpr int64_t max_index = std::numeric_limits<index_type>::max();
+        if (header.num_rows < 1 || header.num_rows >= max_index
+            || header.nnz < 1 || header.nnz > max_index
+            || header.nnz > header.num_rows * header.num_rows)
+        {
+          std::cout << "Received pattern with invalid size " << header.num_rows
+                    << " x " << header.num_rows << ", " << header.nnz << " nonzeros.\n";
+          sendError(1);
+          return nullptr;
+        }
+
+        index_type   n   = static_cast<index_type>(header.num_rows);
+        index_type   nnz = static_cast<index_type>(header.nnz);
+        matrix::Csr* A   = new matrix::Csr(n, n, nnz);
+        A->allocateMatrixData(memory::HOST);
+        index_type* row_ptr = A->getRowData(memory::HOST);
+        index_type* col_idx = A->getColData(memory::HOST);
+        if (!read(row_ptr, n + 1) || !read(col_idx, nnz))
+        {
+          delete A;
+          return nullptr;
+        }
+        if (!isValidPattern(n, nnz, row_ptr, col_idx))
+        {
+          std::cout << "Received invalid sparsity pattern.\n";
+          sendError(1);
+          delete A;
+          return nullptr;
+        }
+        std::memset(A->getValues(memory::HOST), 0, nnz * sizeof(real_type));
+        A->setUpdated(memory::HOST);
+        return A;
+      }
+
+      /**
+       * @brief Read the body of a system message into `A` and `rhs`.
+       *
+       * @param[in]  header - header of the system message
+       * @param[out] A      - matrix with the pattern of the system
+       * @param[out] rhs    - right-hand side vector
+       * @return 0 if successful, 1 otherwise
+       */
+      int receiveSystem(const ServiceMessageHeader& header, matrix::Csr* A, vector::Vector* rhs)
+      {
+        if (A == nullptr || header.num_rows != A->getNumRows() || header.nnz != A->getNnz())
+        {
+          std::cout << "System does not match the sparsity pattern received by the service.\n";
+          return 1;
+        }
+        if (!read(A->getValues(memory::HOST), header.nnz) || !read(rhs->getData(memory::HOST), header.num_rows))
+        {
+          return 1;
+        }
+        A->setUpdated(memory::HOST);
+        rhs->setDataUpdated(memory::HOST);
+        return 0;
+      }
+
+      /**
+       * @brief Send solution `x` (host data) with solver status.
+       *
+       * @return 0 if successful, 1 otherwise
+       */
+      int sendSolution(int status, double residual_norm, vector::Vector* x)
+      {
+        ServiceMessageHeader header = makeHeader(ServiceMessageType::solution, x->getSize(), 0);
+        header.status               = status;
+        header.residual_norm        = residual_norm;
+        return !(write(&header, 1) && write(x->getData(memory::HOST), x->getSize()));
+      }
+
+      /**
+       * @brief Send a solution message without solution, reporting `status`.
+       *
+       * Clients expecting a solution fail on its size and report the error.
+       *
+       * @return 0 if successful, 1 otherwise
+       */
+      int sendError(int status)
+      {
+        ServiceMessageHeader header = makeHeader(ServiceMessageType::solution, 0, 0);
+        header.status               = status;
+        return !write(&header, 1);
+      }
+
+      /// Send sparsity pattern of the following systems.
+      int sendPattern(index_type n, index_type nnz, const index_type* row_ptr, const index_type* col_idx)
+      {
+        ServiceMessageHeader header = makeHeader(ServiceMessageType::pattern, n, nnz);
+        return !(write(&header, 1) && write(row_ptr, n + 1) && write(col_idx, nnz));
+      }
+
+      /// Send matrix values and right-hand side of a system.
+      int sendSystem(index_type n, index_type nnz, const real_type* values, const real_type* rhs)
+      {
+        ServiceMessageHeader header = makeHeader(ServiceMessageType::system, n, nnz);
+        return !(write(&header, 1) && write(values, nnz) && write(rhs, n));
+      }
+
+      /// Ask the service to stop.
+      int sendShutdown()
+      {
+        ServiceMessageHeader header = makeHeader(ServiceMessageType::shutdown, 0, 0);
+        return !write(&header, 1);
+      }
+
+      /**
+       * @brief Receive solution of the last system sent.
+       *
+       * @param[in]  n             - system size
+       * @param[out] x             - solution array of size n
+       * @param[out] status        - solver status reported by the service
+       * @param[out] residual_norm - relative residual norm of the solution
+       * @return 0 if successful, 1 otherwise
+       */
+      int receiveSolution(index_type n, real_type* x, int& status, double& residual_norm)
+      {
+        ServiceMessageHeader header;
+        if (receiveHeader(header) != 0
+            || header.type != static_cast<uint32_t>(ServiceMessageType::solution)
+            || header.num_rows != n
+            || !read(x, n))
+        {
+          std::cout << "Failed to receive solution from the solver service.\n";
+          return 1;
+        }
+        status        = header.status;
+        residual_norm = header.residual_norm;
+        return 0;
+      }
+
+    private:
+      static constexpr char MAGIC[4] = {'R', 'S', 'V', 'C'};
+
+      static ServiceMessageHeader makeHeader(ServiceMessageType type, int64_t num_rows, int64_t nnz)
+      {
+        ServiceMessageHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.type       = static_cast<uint32_t>(type);
+        header.index_size = sizeof(index_type);
+        header.real_size  = sizeof(real_type);
+        header.num_rows   = num_rows;
+        header.nnz        = nnz;
+        return header;
+      }
+
+      /// Check that row pointers are monotone from 0 to nnz and columns are in [0, n).
+      static bool isValidPattern(index_type n, index_type nnz, const index_type* row_ptr, const index_type* col_idx)
+      {
+        if (row_ptr[0] != 0 || row_ptr[n] != nnz)
+        {
+          return false;
+        }
+        for (index_type i = 0; i < n; ++i)
+        {
+          if (row_ptr[i + 1] < row_ptr[i])
+          {
+            return false;
+          }
+        }
+        for (index_type k = 0; k < nnz; ++k)
+        {
+          if (col_idx[k] < 0 || col_idx[k] >= n)
+          {
+            return false;
+          }
+        }
+        return true;
+      }
+
+      static int createPipe(const std::string& pathname)
+      {
+        if (mkfifo(pathname.c_str(), 0600) != 0 && errno != EEXIST)
+        {
+          std::cout << "Failed to create pipe " << pathname << ": " << std::strerror(errno) << "\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      static int open(const std::string& pathname, int flags, int& fd)
+      {
+        fd = ::open(pathname.c_str(), flags);
+        if (fd < 0)
+        {
+          std::cout << "Failed to open pipe " << pathname << ": " << std::strerror(errno) << "\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      /// Read `count` items, retrying partial reads.
+      template <typename T>
+      bool read(T* data, int64_t count)
+      {
+        char*  buffer = reinterpret_cast<char*>(data);
+        size_t size   = static_cast<size_t>(count) * sizeof(T);
+        while (size > 0)
+        {
+          ssize_t bytes = ::read(input_fd_, buffer, size);
+          if (bytes < 0 && errno == EINTR)
+          {
+            continue;
+          }
+          if (bytes <= 0)
+          {
+            return false;
+          }
+          buffer += bytes;
+          size -= static_cast<size_t>(bytes);
+        }
+        return true;
+      }
+
+      /// Write `count` items, retrying partial writes.
+      template <typename T>
+      bool write(const T* data, int64_t count)
+      {
+        const char* buffer = reinterpret_cast<const char*>(data);
+        size_t      size   = static_cast<size_t>(count) * sizeof(T);
+        while (size > 0)
+        {
+          ssize_t bytes = ::write(output_fd_, buffer, size);
+          if (bytes < 0 && errno == EINTR)
+          {
+            continue;
+          }
+          if (bytes <= 0)
+          {
+            return false;
+          }
+          buffer += bytes;
+          size -= static_cast<size_t>(bytes);
+        }
+        return true;
+      }
+
+    private:
+      int  input_fd_{-1};  ///< requests (service) or solutions (client)
+      int  output_fd_{-1}; ///< solutions (service) or requests (client)
+      bool is_owner_{true};
+    };
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/Sparse.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Header of a symbolic analysis cache file.
+     *
+     * Layout:
+     * ```
+     *   [header][P (n)][Q (n)]
+     *   [L row_ptr (n+1)][L col_idx (L_nnz)]
+     *   [U row_ptr (n+1)][U col_idx (U_nnz)]
+     * ```
+     */
+    struct SymbolicAnalysisHeader
+    {
+      char     magic[8];    ///< File signature "RSSYMB02"
+      uint32_t index_size;  ///< sizeof(index_type) used to write the file
+      uint32_t reserved;    ///< Padding, always zero
+      uint64_t fingerprint; ///< Fingerprint of the sparsity pattern of A
+      int64_t  num_rows;    ///< Number of matrix rows
+      int64_t  nnz;         ///< Number of nonzeros of A
+      int64_t  L_nnz;       ///< Number of nonzeros of L
+      int64_t  U_nnz;       ///< Number of nonzeros of U
+      double   pivot_ratio; ///< Pivot ratio of the KLU factors
+    };
+
+    /**
+     * @brief On-disk cache of orderings and factor patterns.
+     *
+     * Stores the row and column permutations and the patterns of the L and
+     * U factors of a KLU factorization in a file named after the fingerprint
+     * of the sparsity pattern of A. A later run with the same pattern loads
+     * the file and computes the numeric factorization with the cached pivot
+     * sequence (e.g. with ParallelRefactorizationCpu), skipping the symbolic
+     * analysis and the pivoting factorization. The pivot ratio of the KLU
+     * factors is stored as well, since factors loaded from the cache have
+     * no values to take a pivot ratio baseline from.
+     *
+     * Usage:
+     * ```
+     *   std::string file = SymbolicAnalysisCache::getFileName(dir, fingerprint);
+     *   if (cache.load(file, fingerprint, A) == 0)
+     *   {
+     *     refactor.setup(A, cache.getL(), cache.getU(), cache.getP(), cache.getQ());
+     *     policy.setPivotRatioBaseline(cache.getPivotRatio());
+     *     refactor.refactorize();
+     *   }
+     *   else
+     *   {
+     *     ...  // KLU analysis and factorization
+     *     cache.save(file, fingerprint, A, L_csr, U_csr, P, Q, pivot_ratio);
+     *   }
+     * ```
+     *
+     * @note Factor values are not stored; matrices returned by getL() and
+     * getU() have zero values.
+     */
+    class SymbolicAnalysisCache
+    {
+    public:
+      SymbolicAnalysisCache() = default;
+
+      ~SymbolicAnalysisCache()
+      {
+        delete L_;
+        delete U_;
+      }
+
+      SymbolicAnalysisCache(const SymbolicAnalysisCache&)            = delete;
+      SymbolicAnalysisCache& operator=(const SymbolicAnalysisCache&) = delete;
+
+      /**
+       * @brief Cache file name in `directory` for the pattern with `fingerprint`.
+       *
+       * Analyses with different orderings of the same pattern are kept
+       * apart by the file name `prefix`.
+       */
+      static std::string getFileName(const std::string& directory,
+                                     std::uint64_t      fingerprint,
+                                     const std::string& prefix = "klu")
+      {
+        std::ostringstream name;
+        name << directory << "/" << prefix << "_" << std::hex << std::setfill('0') << std::setw(16)
+             << fingerprint << ".sym";
+        return name.str();
+      }
+
+      /**
+       * @brief Write orderings and factor patterns to `pathname`.
+       *
+       * The file is written under a temporary name and renamed, so that
+       * concurrently started processes never read a partial file.
+       *
+       * @param[in] pathname    - cache file name
+       * @param[in] fingerprint - fingerprint of the sparsity pattern of A
+       * @param[in] A           - system matrix
+       * @param[in] L           - lower triangular factor in CSR format
+       * @param[in] U           - upper triangular factor in CSR format
+       * @param[in] P           - row permutation
+       * @param[in] Q           - column permutation
+       * @param[in] pivot_ratio - smallest over largest pivot magnitude of U
+       * @return 0 if successful, 1 otherwise
+       */
+      static int save(const std::string& pathname,
+                      std::uint64_t      fingerprint,
+                      matrix::Sparse*    A,
+                      matrix::Sparse*    L,
+                      matrix::Sparse*    U,
+                      const index_type*  P,
+                      const index_type*  Q,
+                      real_type          pivot_ratio)
+      {
+        std::string temporary = pathname + ".tmp";
+        FILE*       file      = std::fopen(temporary.c_str(), "wb");
+        if (file == nullptr)
+        {
+          std::cout << "Failed to open file " << temporary << " for writing.\n";
+          return 1;
+        }
+
+        index_type             n = A->getNumRows();
+        SymbolicAnalysisHeader header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.index_size  = sizeof(index_type);
+        header.fingerprint = fingerprint;
+        header.num_rows    = n;
+        header.nnz         = A->getNnz();
+        header.L_nnz       = L->getNnz();
+        header.U_nnz       = U->getNnz();
+        header.pivot_ratio = pivot_ratio;
+
+        bool is_ok = write(file, &header, 1);
+        is_ok      = is_ok && write(file, P, n) && write(file, Q, n);
+        is_ok      = is_ok && write(file, L->getRowData(memory::HOST), n + 1);
+        is_ok      = is_ok && write(file, L->getColData(memory::HOST), header.L_nnz);
+        is_ok      = is_ok && write(file, U->getRowData(memory::HOST), n + 1);
+        is_ok      = is_ok && write(file, U->getColData(memory::HOST), header.U_nnz);
+        is_ok      = (std::fclose(file) == 0) && is_ok;
+
+        if (!is_ok || std::rename(temporary.c_str(), pathname.c_str()) != 0)
+        {
+          std::cout << "Failed to write symbolic analysis cache " << pathname << ".\n";
+          std::remove(temporary.c_str());
+          return 1;
+        }
+        return 0;
+      }
+
+      /**
+       * @brief Read orderings and factor patterns for matrix `A`.
+       *
+       * @param[in] pathname    - cache file name
+       * @param[in] fingerprint - fingerprint of the sparsity pattern of A
+       * @param[in] A           - system matrix
+       * @return 0 if a valid cache for A was read, 1 otherwise
+       */
+      int load(const std::string& pathname, std::uint64_t fingerprint, matrix::Sparse* A)
+      {
+        FILE* file = std::fopen(pathname.c_str(), "rb");
+        if (file == nullptr)
+        {
+          return 1;
+        }
+
+        index_type             n = A->getNumRows();
+        SymbolicAnalysisHeader header;
+
+        bool is_ok = read(file, &header, 1)
+                     && std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0
+                     && header.index_size == sizeof(index_type)
+                     && header.fingerprint == fingerprint
+                     && header.num_rows == n
+                     && header.nnz == A->getNnz()
+                     && header.L_nnz >= n
+                     && header.U_nnz >= n
+                     && header.pivot_ratio > 0.0;
+        if (is_ok)
+        {
+          P_.resize(n);
+          Q_.resize(n);
+          is_ok = read(file, P_.data(), n) && read(file, Q_.data(), n);
+          is_ok = is_ok && readFactor(file, L_, n, header.L_nnz);
+          is_ok = is_ok && readFactor(file, U_, n, header.U_nnz);
+          is_ok        = is_ok && isPermutation(P_) && isPermutation(Q_);
+          pivot_ratio_ = header.pivot_ratio;
+        }
+        std::fclose(file);
+
+        if (!is_ok)
+        {
+          std::cout << "Ignoring invalid symbolic analysis cache " << pathname << ".\n";
+          return 1;
+        }
+        return 0;
+      }
+
+      /// Lower triangular factor pattern from the last load().
+      matrix::Csr* getL()
+      {
+        return L_;
+      }
+
+      /// Upper triangular factor pattern from the last load().
+      matrix::Csr* getU()
+      {
+        return U_;
+      }
+
+      /// Pivot ratio of the KLU factors from the last load().
+      real_type getPivotRatio() const
+      {
+        return pivot_ratio_;
+      }
+
+      /// Row permutation from the last load().
+      index_type* getP()
+      {
+        return P_.data();
+      }
+
+      /// Column permutation from the last load().
+      index_type* getQ()
+      {
+        return Q_.data();
+      }
+
+    private:
+      static constexpr char MAGIC[8] = {'R', 'S', 'S', 'Y', 'M', 'B', '0', '2'};
+
+      template <typename T>
+      static bool write(FILE* file, const T* data, int64_t count)
+      {
+        return std::fwrite(data, sizeof(T), count, file) == static_cast<size_t>(count);
+      }
+
+      template <typename T>
+      static bool read(FILE* file, T* data, int64_t count)
+      {
+        return std::fread(data, sizeof(T), count, file) == static_cast<size_t>(count);
+      }
+
+      /// Read CSR pattern of an n x n factor and check that it is consistent.
+      static bool readFactor(FILE* file, matrix::Csr*& M, index_type n, index_type nnz)
+      {
+        delete M;
+        M = new matrix::Csr(n, n, nnz);
+        M->allocateMatrixData(memory::HOST);
+        index_type* row_ptr = M->getRowData(memory::HOST);
+        index_type* col_idx = M->getColData(memory::HOST);
+        if (!read(file, row_ptr, n + 1) || !read(file, col_idx, nnz))
+        {
+          return false;
+        }
+        if (row_ptr[0] != 0 || row_ptr[n] != nnz)
+        {
+          return false;
+        }
+        for (index_type i = 0; i < n; ++i)
+        {
+          if (row_ptr[i + 1] < row_ptr[i])
+          {
+            return false;
+          }
+        }
+        for (index_type k = 0; k < nnz; ++k)
+        {
+          if (col_idx[k] < 0 || col_idx[k] >= n)
+          {
+            return false;
+          }
+        }
+        std::fill(M->getValues(memory::HOST), M->getValues(memory::HOST) + nnz, 0.0);
+        M->setUpdated(memory::HOST);
+        return true;
+      }
+
+      static bool isPermutation(const std::vector<index_type>& perm)
+      {
+        std::vector<bool> is_seen(perm.size(), false);
+        for (index_type k : perm)
+        {
+          if (k < 0 || k >= static_cast<index_type>(perm.size()) || is_seen[k])
+          {
+            return false;
+          }
+          is_seen[k] = true;
+        }
+        return true;
+      }
+
+    private:
+      matrix::Csr*            L_{nullptr};       ///< lower triangular factor pattern
+      matrix::Csr*            U_{nullptr};       ///< upper triangular factor pattern
+      std::vector<index_type> P_;                ///< row permutation
+      std::vector<index_type> Q_;                ///< column permutation
+      real_type               pivot_ratio_{0.0}; ///< pivot ratio of the KLU factors
+    };
+
+  } // namespace examples
+} // namespace ReSolve
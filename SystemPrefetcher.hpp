@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <fstream>
+#include <future>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "CsrValueUpdater.hpp"
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/io.hpp>
+#include <resolve/vector/Vector.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /**
+     * @brief Reads the next linear system of a series in the background.
+     *
+     * System matrices and right-hand sides are read from files named
+     * <pathname>XX.<ext>, the same way as in the examples. Two host staging
+     * buffers are used: while the caller copies values of system i from one
+     * buffer and solves it, system i+1 is parsed into the other buffer on a
+     * background thread.
+     *
+     * Only file input and parsing run off the main thread; staging buffers are
+     * host-only, so no device calls are made from the background thread.
+     *
+     * Usage:
+     * ```
+     *   prefetcher.prefetch(i + 1); // start reading next system
+     *   prefetcher.update(i, A, b); // wait for system i, copy it into A and b
+     * ```
+     */
+    class SystemPrefetcher
+    {
+    public:
+      /**
+       * @brief Constructor
+       *
+       * @param[in] matrix_pathname - matrix file family pathname
+       * @param[in] rhs_pathname    - right-hand side file family pathname
+       * @param[in] file_extension  - file extension (e.g. "mtx")
+       */
+      SystemPrefetcher(const std::string& matrix_pathname,
+                       const std::string& rhs_pathname,
+                       const std::string& file_extension)
+        : matrix_pathname_(matrix_pathname),
+          rhs_pathname_(rhs_pathname),
+          file_extension_(file_extension)
+      {
+      }
+
+      /**
+       * @brief Destructor
+       *
+       * @post Pending reads are completed and staging buffers are deleted.
+       */
+      ~SystemPrefetcher()
+      {
+        for (Slot& slot : slots_)
+        {
+          if (slot.pending.valid())
+          {
+            slot.pending.wait();
+          }
+          delete slot.A;
+          delete slot.rhs;
+        }
+      }
+
+      SystemPrefetcher(const SystemPrefetcher&)            = delete;
+      SystemPrefetcher& operator=(const SystemPrefetcher&) = delete;
+
+      /// Matrix file name for system `i`.
+      std::string getMatrixFileName(index_type i) const
+      {
+        return fileName(matrix_pathname_, i);
+      }
+
+      /// Right-hand side file name for system `i`.
+      std::string getRhsFileName(index_type i) const
+      {
+        return fileName(rhs_pathname_, i);
+      }
+
+      /**
+       * @brief Start reading system `i` on a background thread.
+       *
+       * @pre No more than one other system is being read or waiting to be
+       * picked up by update().
+       */
+      void prefetch(index_type i)
+      {
+        Slot& slot = slots_[i % NUM_SLOTS];
+        if (slot.pending.valid())
+        {
+          slot.pending.wait();
+        }
+        slot.id      = i;
+        slot.pending = std::async(std::launch::async, [this, &slot, i]()
+                                  { return read(i, slot); });
+      }
+
+      /**
+       * @brief Wait for system `i` and copy it into `A` and `rhs`.
+       *
+       * Only values are copied if system `i` has the sparsity pattern of `A`.
+       * Otherwise, if it has the same size and number of nonzeros, its
+       * pattern is copied as well.
+       *
+       * @param[in]     i   - system index, must have been prefetched
+       * @param[in,out] A   - matrix of the previous system
+       * @param[in,out] rhs - right-hand side vector
+       * @return 0 if only values changed, CsrValueUpdater::PATTERN_CHANGED
+       * if the sparsity pattern of `A` was replaced, 1 otherwise
+       *
+       * @post Host data of `A` and `rhs` is updated.
+       */
+      int update(index_type i, matrix::Csr* A, vector::Vector* rhs)
+      {
+        Slot& slot = slots_[i % NUM_SLOTS];
+        if (slot.id != i || !slot.pending.valid())
+        {
+          std::cout << "System " << i << " has not been prefetched.\n";
+          return 1;
+        }
+        if (slot.pending.get() != 0)
+        {
+          return 1;
+        }
+        if (slot.A->getNumRows() != A->getNumRows() || slot.A->getNnz() != A->getNnz()
+            || slot.rhs->getSize() != rhs->getSize())
+        {
+          std::cout << "System " << i << " does not match the size of the first system.\n";
+          return 1;
+        }
+        rhs->copyDataFrom(slot.rhs->getData(memory::HOST), memory::HOST, memory::HOST);
+        if (!isSamePattern(slot.A, A))
+        {
+          std::cout << "Sparsity pattern of system " << i << " changed.\n";
+          A->copyDataFrom(slot.A->getRowData(memory::HOST),
+                          slot.A->getColData(memory::HOST),
+                          slot.A->getValues(memory::HOST),
+                          memory::HOST,
+                          memory::HOST);
+          return CsrValueUpdater::PATTERN_CHANGED;
+        }
+        A->copyValues(slot.A->getValues(memory::HOST), memory::HOST, memory::HOST);
+        return 0;
+      }
+
+    private:
+      static constexpr int NUM_SLOTS = 2;
+
+      /// Staging buffer for one system.
+      struct Slot
+      {
+        index_type       id{-1};
+        matrix::Csr*     A{nullptr};
+        vector::Vector*  rhs{nullptr};
+        CsrValueUpdater  value_updater;
+        std::future<int> pending;
+      };
+
+      /// True if `A` and `B` of the same size have the same row pointers and column indices.
+      static bool isSamePattern(matrix::Csr* A, matrix::Csr* B)
+      {
+        index_type        n     = A->getNumRows();
+        const index_type* A_row = A->getRowData(memory::HOST);
+        const index_type* B_row = B->getRowData(memory::HOST);
+        const index_type* A_col = A->getColData(memory::HOST);
+        const index_type* B_col = B->getColData(memory::HOST);
+        return std::equal(A_row, A_row + n + 1, B_row) && std::equal(A_col, A_col + A->getNnz(), B_col);
+      }
+
+      std::string fileName(const std::string& pathname, index_type i) const
+      {
+        std::ostringstream name;
+        name << pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension_;
+        return name.str();
+      }
+
+      /// Runs on the background thread.
+      int read(index_type i, Slot& slot)
+      {
+        std::string   matrix_file_name = getMatrixFileName(i);
+        std::string   rhs_file_name    = getRhsFileName(i);
+        std::ifstream mat_file(matrix_file_name);
+        if (!mat_file.is_open())
+        {
+          std::cout << "Failed to open file " << matrix_file_name << "\n";
+          return 1;
+        }
+        std::ifstream rhs_file(rhs_file_name);
+        if (!rhs_file.is_open())
+        {
+          std::cout << "Failed to open file " << rhs_file_name << "\n";
+          return 1;
+        }
+
+        // Refactorization is LU-based, so need to expand symmetric matrices
+        bool is_expand_symmetric = true;
+        if (slot.A == nullptr)
+        {
+          slot.A   = io::createCsrFromFile(mat_file, is_expand_symmetric);
+          slot.rhs = io::createVectorFromFile(rhs_file);
+          slot.value_updater.setup(mat_file, slot.A);
+        }
+        else
+        {
+          // Pattern changes are detected when the system is picked up
+          int status = slot.value_updater.update(mat_file, slot.A);
+          if (status != 0 && status != CsrValueUpdater::PATTERN_CHANGED)
+          {
+            return 1;
+          }
+          io::updateVectorFromFile(rhs_file, slot.rhs);
+        }
+        return 0;
+      }
+
+    private:
+      std::string matrix_pathname_;
+      std::string rhs_pathname_;
+      std::string file_extension_;
+
+      Slot slots_[NUM_SLOTS];
+    };
+
+  } // namespace examples
+} // namespace ReSolve
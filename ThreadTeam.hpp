@@ -0,0 +1,340 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <resolve/Common.hpp>
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /// Reusable barrier synchronizing a fixed number of threads.
+    class SpinBarrier
+    {
+    public:
+      explicit SpinBarrier(int num_threads)
+        : num_threads_(num_threads)
+      {
+      }
+
+      void wait()
+      {
+        int generation = generation_.load(std::memory_order_acquire);
+        if (count_.fetch_add(1, std::memory_order_acq_rel) + 1 == num_threads_)
+        {
+          count_.store(0, std::memory_order_relaxed);
+          generation_.fetch_add(1, std::memory_order_release);
+          return;
+        }
+        while (generation_.load(std::memory_order_acquire) == generation)
+        {
+          std::this_thread::yield();
+        }
+      }
+
+    private:
+      int              num_threads_;
+      std::atomic<int> count_{0};
+      std::atomic<int> generation_{0};
+    };
+
+    /**
+     * @brief Reusable barrier whose waiting threads sleep.
+     *
+     * For threads that may wait long, e.g. while others set up GPU solvers,
+     * where SpinBarrier would keep cores busy.
+     */
+    class BlockingBarrier
+    {
+    public:
+      explicit BlockingBarrier(int num_threads)
+        : num_threads_(num_threads)
+      {
+      }
+
+      void wait()
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        int                          generation = generation_;
+        if (++count_ == num_threads_)
+        {
+          count_ = 0;
+          ++generation_;
+          released_.notify_all();
+          return;
+        }
+        released_.wait(lock, [&]
+                       { return generation_ != generation; });
+      }
+
+    private:
+      int                     num_threads_;
+      int                     count_{0};
+      int                     generation_{0};
+      std::mutex              mutex_;
+      std::condition_variable released_;
+    };
+
+    /**
+     * @brief Rows grouped into levels, processed level by level.
+     *
+     * Threads take chunks of rows of the current level from a shared
+     * counter and wait for each other before moving to the next level.
+     */
+    class LevelSchedule
+    {
+    public:
+      /// Number of rows a thread takes from a level at once.
+      static constexpr index_type CHUNK_SIZE = 16;
+
+      /// Build schedule from the level of each row.
+      void build(const std::vector<index_type>& level, index_type num_levels)
+      {
+        index_type n = static_cast<index_type>(level.size());
+        level_ptr_.assign(num_levels + 1, 0);
+        for (index_type i = 0; i < n; ++i)
+        {
+          ++level_ptr_[level[i] + 1];
+        }
+        for (index_type l = 0; l < num_levels; ++l)
+        {
+          level_ptr_[l + 1] += level_ptr_[l];
+        }
+        rows_.resize(n);
+        std::vector<index_type> position(level_ptr_.begin(), level_ptr_.end() - 1);
+        for (index_type i = 0; i < n; ++i)
+        {
+          rows_[position[level[i]]++] = i;
+        }
+        next_row_.reset(new std::atomic<index_type>[num_levels]);
+        reset();
+      }
+
+      /**
+       * @brief Build schedule of the forward substitution with LU factors.
+       *
+       * Factors are in one CSR pattern, the strictly lower part of L before
+       * the diagonal of U in each row. The level of row i is one more than
+       * the highest level of the rows it uses.
+       *
+       * @param[in] n        - number of rows
+       * @param[in] row_ptr  - row pointers of the factors
+       * @param[in] col_idx  - column indices of the factors
+       * @param[in] diag_pos - position of the diagonal in each row
+       */
+      void buildLower(index_type n, const index_type* row_ptr, const index_type* col_idx, const index_type* diag_pos)
+      {
+        std::vector<index_type> level(n, 0);
+        index_type              num_levels = 0;
+        for (index_type i = 0; i < n; ++i)
+        {
+          for (index_type p = row_ptr[i]; p < diag_pos[i]; ++p)
+          {
+            level[i] = std::max(level[i], level[col_idx[p]] + 1);
+          }
+          num_levels = std::max(num_levels, level[i] + 1);
+        }
+        build(level, num_levels);
+      }
+
+      /// Same as buildLower() for the backward substitution, rows use entries right of the diagonal.
+      void buildUpper(index_type n, const index_type* row_ptr, const index_type* col_idx, const index_type* diag_pos)
+      {
+        std::vector<index_type> level(n, 0);
+        index_type              num_levels = 0;
+        for (index_type i = n - 1; i >= 0; --i)
+        {
+          for (index_type p = diag_pos[i] + 1; p < row_ptr[i + 1]; ++p)
+          {
+            level[i] = std::max(level[i], level[col_idx[p]] + 1);
+          }
+          num_levels = std::max(num_levels, level[i] + 1);
+        }
+        build(level, num_levels);
+      }
+
+      index_type getNumLevels() const
+      {
+        return static_cast<index_type>(level_ptr_.size()) - 1;
+      }
+
+      /// Set barrier of the thread team traversing the schedule, waited at after each level.
+      void setBarrier(SpinBarrier* barrier)
+      {
+        barrier_ = barrier;
+      }
+
+      /// Prepare counters for the next traversal; call before team.run().
+      void reset()
+      {
+        for (index_type l = 0; l < getNumLevels(); ++l)
+        {
+          next_row_[l].store(0, std::memory_order_relaxed);
+        }
+      }
+
+      /// Apply `op` to rows taken by the calling thread, level by level.
+      template <class Op>
+      void forEachRow(Op op)
+      {
+        index_type num_levels = getNumLevels();
+        for (index_type l = 0; l < num_levels; ++l)
+        {
+          index_type begin = level_ptr_[l];
+          index_type size  = level_ptr_[l + 1] - begin;
+          for (index_type start = next_row_[l].fetch_add(CHUNK_SIZE, std::memory_order_relaxed);
+               start < size;
+               start = next_row_[l].fetch_add(CHUNK_SIZE, std::memory_order_relaxed))
+          {
+            index_type stop = std::min(start + CHUNK_SIZE, size);
+            for (index_type r = start; r < stop; ++r)
+            {
+              op(rows_[begin + r]);
+            }
+          }
+          barrier_->wait();
+        }
+      }
+
+    private:
+      SpinBarrier*                               barrier_{nullptr}; ///< barrier of the thread team
+      std::vector<index_type>                    level_ptr_{0};
+      std::vector<index_type>                    rows_;
+      std::unique_ptr<std::atomic<index_type>[]> next_row_;
+    };
+
+    /**
+     * @brief Persistent team of threads running a task together.
+     *
+     * Worker threads are created once and sleep between tasks, so kernels
+     * called on every solver iteration (e.g. preconditioner applications)
+     * do not pay for thread creation. The calling thread takes part in the
+     * task as thread 0.
+     *
+     * Usage:
+     * ```
+     *   ThreadTeam team(4);
+     *   team.run([&](int tid) { work(tid, team.getNumThreads()); });
+     * ```
+     */
+    class ThreadTeam
+    {
+    public:
+      explicit ThreadTeam(int num_threads = 1)
+      {
+        resize(num_threads);
+      }
+
+      ~ThreadTeam()
+      {
+        stop();
+      }
+
+      ThreadTeam(const ThreadTeam&)            = delete;
+      ThreadTeam& operator=(const ThreadTeam&) = delete;
+
+      /// Replace worker threads with a team of `num_threads` (at least 1).
+      void resize(int num_threads)
+      {
+        stop();
+        num_threads_ = std::max(1, num_threads);
+        for (int tid = 1; tid < num_threads_; ++tid)
+        {
+          workers_.emplace_back([this, tid, generation = generation_]()
+                                { workLoop(tid, generation); });
+        }
+      }
+
+      /// Number of threads in the team, including the calling thread.
+      int getNumThreads() const
+      {
+        return num_threads_;
+      }
+
+      /// Run `task(tid)` on all threads and wait until all of them return.
+      void run(const std::function<void(int)>& task)
+      {
+        if (num_threads_ == 1)
+        {
+          task(0);
+          return;
+        }
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          task_     = &task;
+          num_done_ = 0;
+          ++generation_;
+        }
+        start_.notify_all();
+
+        task(0);
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        done_.wait(lock, [this]()
+                   { return num_done_ == num_threads_ - 1; });
+        task_ = nullptr;
+      }
+
+    private:
+      void workLoop(int tid, long generation)
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true)
+        {
+          start_.wait(lock, [this, generation]()
+                      { return is_stopping_ || generation_ != generation; });
+          if (is_stopping_)
+          {
+            return;
+          }
+          const std::function<void(int)>* task = task_;
+          generation                           = generation_;
+          lock.unlock();
+
+          (*task)(tid);
+
+          lock.lock();
+          if (++num_done_ == num_threads_ - 1)
+          {
+            done_.notify_one();
+          }
+        }
+      }
+
+      void stop()
+      {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          is_stopping_ = true;
+        }
+        start_.notify_all();
+        for (std::thread& worker : workers_)
+        {
+          worker.join();
+        }
+        workers_.clear();
+        is_stopping_ = false;
+      }
+
+    private:
+      int                      num_threads_{1};
+      std::vector<std::thread> workers_;
+
+      std::mutex                      mutex_;
+      std::condition_variable         start_;         ///< wakes workers for a new task
+      std::condition_variable         done_;          ///< signals the calling thread
+      const std::function<void(int)>* task_{nullptr}; ///< task being run
+      long                            generation_{0}; ///< number of tasks started
+      int                             num_done_{0};   ///< workers done with the task
+      bool                            is_stopping_{false};
+    };
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <resolve/Common.hpp>
+
+#include "ThreadTeam.hpp"
+
+namespace ReSolve
+{
+  namespace examples
+  {
+    /// Algorithms of the triangular solves with LU factors.
+    enum class TriangularSolveMethod
+    {
+      sequential, ///< row by row on one thread
+      levels,     ///< rows of one level of the dependency graph in parallel
+      jacobi,     ///< fixed number of Jacobi sweeps, approximate
+      fastest     ///< time sequential and levels on the first solve, keep faster
+    };
+
+    /// Name of triangular solve method `method`.
+    inline std::string getTriangularSolveMethodName(TriangularSolveMethod method)
+    {
+      switch (method)
+      {
+      case TriangularSolveMethod::sequential:
+        return "sequential";
+      case TriangularSolveMethod::levels:
+        return "levels";
+      case TriangularSolveMethod::jacobi:
+        return "jacobi";
+      case TriangularSolveMethod::fastest:
+        return "fastest";
+      }
+      return "";
+    }
+
+    /**
+     * @brief Get triangular solve method from its name.
+     *
+     * @param[in]  name   - "sequential", "levels", "jacobi" or "fastest"
+     * @param[out] method - triangular solve method
+     * @return 0 if `name` is a known method, 1 otherwise
+     */
+    inline int getTriangularSolveMethod(const std::string& name, TriangularSolveMethod& method)
+    {
+      for (TriangularSolveMethod m : {TriangularSolveMethod::sequential,
+                                      TriangularSolveMethod::levels,
+                                      TriangularSolveMethod::jacobi,
+                                      TriangularSolveMethod::fastest})
+      {
+        if (name == getTriangularSolveMethodName(m))
+        {
+          method = m;
+          return 0;
+        }
+      }
+      std::cout << "Unknown triangular solve method " << name << ".\n";
+      return 1;
+    }
+
+    /**
+     * @brief Forward and backward substitution with LU factors on the host.
+     *
+     * Factors are stored in one CSR matrix: the strictly lower part of a unit
+     * lower triangular L followed by the diagonal and upper part of U in
+     * each row, with the position of the diagonal given separately. The
+     * pattern is analyzed once with analyze() and the level schedules are
+     * reused for all solves with that pattern, whatever the factor values.
+     *
+     * The "levels" method pays a barrier per level, so it is faster than the
+     * sequential solve only if levels are wide. "jacobi" replaces each
+     * triangular solve with a fixed number of Jacobi sweeps over contiguous
+     * row blocks, with one barrier per sweep. It is exact only with at least
+     * as many sweeps as levels and is meant for factors used within
+     * iterative refinement or as a preconditioner. "fastest" times the two
+     * exact methods on the first solve after analyze() and keeps the faster.
+     *
+     * Usage:
+     * ```
+     *   engine.setMethod(TriangularSolveMethod::fastest);
+     *   engine.analyze(n, row_ptr, col_idx, diag_pos);
+     *   for each system:
+     *     ...                         // update factor values
+     *     engine.solve(values, y);    // y = U^{-1} L^{-1} y
+     * ```
+     */
+    class TriangularSolveEngine
+    {
+    public:
+      explicit TriangularSolveEngine(int num_threads = 1)
+        : own_team_(new ThreadTeam),
+          team_(own_team_.get())
+      {
+        setNumThreads(num_threads);
+      }
+
+      TriangularSolveEngine(const TriangularSolveEngine&)            = delete;
+      TriangularSolveEngine& operator=(const TriangularSolveEngine&) = delete;
+
+      /// Set number of threads used for solves (at least 1), resizes the team in use.
+      void setNumThreads(int num_threads)
+      {
+        team_->resize(num_threads);
+        setupTeam();
+      }
+
+      /**
+       * @brief Run solves on `team` instead of a team of the engine.
+       *
+       * Lets a solver share its threads with the engine. The team is not
+       * owned, and has to outlive the engine. Call again after the team is
+       * resized.
+       */
+      void setThreadTeam(ThreadTeam* team)
+      {
+        team_ = team;
+        own_team_.reset();
+        setupTeam();
+      }
+
+      /// Number of threads used for solves.
+      int getNumThreads() const
+      {
+        return team_->getNumThreads();
+      }
+
+      /// Select triangular solve method; "fastest" is resolved on the next solve.
+      void setMethod(TriangularSolveMethod method)
+      {
+        method_      = method;
+        is_selected_ = false;
+      }
+
+      /// Method used for solves, "fastest" until the first solve has selected one.
+      TriangularSolveMethod getMethod() const
+      {
+        return (method_ == TriangularSolveMethod::fastest && is_selected_) ? selected_ : method_;
+      }
+
+      /// Set number of sweeps per triangular factor of the "jacobi" method.
+      void setNumSweeps(int num_sweeps)
+      {
+        num_sweeps_ = std::max(1, num_sweeps);
+      }
+
+      /// Number of sweeps per triangular factor of the "jacobi" method.
+      int getNumSweeps() const
+      {
+        return num_sweeps_;
+      }
+
+      /// Number of levels of the forward substitution.
+      index_type getNumLowerLevels() const
+      {
+        return lower_.getNumLevels();
+      }
+
+      /// Number of levels of the backward substitution.
+      index_type getNumUpperLevels() const
+      {
+        return upper_.getNumLevels();
+      }
+
+      /**
+       * @brief Build level schedules of the factor pattern.
+       *
+       * Arrays are not copied and have to stay valid until the next call.
+       *
+       * @param[in] n        - number of rows
+       * @param[in] row_ptr  - row pointers of the factors
+       * @param[in] col_idx  - column indices of the factors, sorted in each row
+       * @param[in] diag_pos - position of the diagonal in each row
+       */
+      void analyze(index_type n, const index_type* row_ptr, const index_type* col_idx, const index_type* diag_pos)
+      {
+        n_        = n;
+        row_ptr_  = row_ptr;
+        col_idx_  = col_idx;
+        diag_pos_ = diag_pos;
+
+        lower_.buildLower(n_, row_ptr_, col_idx_, diag_pos_);
+        upper_.buildUpper(n_, row_ptr_, col_idx_, diag_pos_);
+
+        work_.resize(2 * n_);
+        is_selected_ = false;
+      }
+
+      /**
+       * @brief Solve L*U*x = y in place.
+       *
+       * @param[in]     values - factor values in the analyzed pattern
+       * @param[in,out] y      - right-hand side on input, solution on output
+       */
+      void solve(const real_type* values, real_type* y)
+      {
+        switch (getMethod())
+        {
+        case TriangularSolveMethod::sequential:
+          solveSequential(values, y);
+          break;
+        case TriangularSolveMethod::levels:
+          solveLevels(values, y);
+          break;
+        case TriangularSolveMethod::jacobi:
+          solveJacobi(values, y);
+          break;
+        case TriangularSolveMethod::fastest:
+          selectFastest(values, y);
+          break;
+        }
+      }
+
+    private:
+      /// Barrier and schedules for the threads of the team in use.
+      void setupTeam()
+      {
+        barrier_.reset(new SpinBarrier(team_->getNumThreads()));
+        lower_.setBarrier(barrier_.get());
+        upper_.setBarrier(barrier_.get());
+        is_selected_ = false;
+      }
+
+      /// Solve with both exact methods, keep the faster one for later solves.
+      void selectFastest(const real_type* values, real_type* y)
+      {
+        using clock = std::chrono::steady_clock;
+
+        std::vector<real_type> y_copy(y, y + n_);
+        auto                   start = clock::now();
+        solveSequential(values, y);
+        std::chrono::duration<double> sequential_time = clock::now() - start;
+
+        start = clock::now();
+        solveLevels(values, y_copy.data());
+        std::chrono::duration<double> levels_time = clock::now() - start;
+
+        selected_    = (levels_time < sequential_time) ? TriangularSolveMethod::levels : TriangularSolveMethod::sequential;
+        is_selected_ = true;
+        std::cout << "Triangular solve: sequential " << sequential_time.count()
+                  << " s, levels " << levels_time.count() << " s ("
+                  << lower_.getNumLevels() << " + " << upper_.getNumLevels() << " levels, "
+                  << team_->getNumThreads() << " threads), using "
+                  << getTriangularSolveMethodName(selected_) << ".\n";
+      }
+
+      void solveSequential(const real_type* values, real_type* y) const
+      {
+        for (index_type i = 0; i < n_; ++i)
+        {
+          lowerSolveRow(i, values, y);
+        }
+        for (index_type i = n_ - 1; i >= 0; --i)
+        {
+          upperSolveRow(i, values, y);
+        }
+      }
+
+      void solveLevels(const real_type* values, real_type* y)
+      {
+        lower_.reset();
+        upper_.reset();
+        team_->run([this, values, y](int)
+                  {
+                    lower_.forEachRow([this, values, y](index_type i) { lowerSolveRow(i, values, y); });
+                    upper_.forEachRow([this, values, y](index_type i) { upperSolveRow(i, values, y); });
+                  });
+      }
+
+      /// Jacobi sweeps x <- y - L*x, then x <- D^{-1} (y - U*x), starting from y.
+      void solveJacobi(const real_type* values, real_type* y)
+      {
+        team_->run([this, values, y](int tid)
+                  {
+                    index_type num_threads = team_->getNumThreads();
+                    index_type begin       = n_ * tid / num_threads;
+                    index_type end         = n_ * (tid + 1) / num_threads;
+
+                    // Every thread swaps its own copies of the pointers in the same way
+                    real_type* b     = y;
+                    real_type* x_old = work_.data();
+                    real_type* x_new = work_.data() + n_;
+
+                    std::copy(b + begin, b + end, x_old + begin);
+                    for (int sweep = 0; sweep < num_sweeps_; ++sweep)
+                    {
+                      barrier_->wait();
+                      for (index_type i = begin; i < end; ++i)
+                      {
+                        real_type sum = b[i];
+                        for (index_type p = row_ptr_[i]; p < diag_pos_[i]; ++p)
+                        {
+                          sum -= values[p] * x_old[col_idx_[p]];
+                        }
+                        x_new[i] = sum;
+                      }
+                      std::swap(x_old, x_new);
+                    }
+
+                    // Lower solve result becomes right-hand side of the upper solve
+                    std::copy(x_old + begin, x_old + end, b + begin);
+                    for (index_type i = begin; i < end; ++i)
+                    {
+                      x_old[i] = b[i] / values[diag_pos_[i]];
+                    }
+                    for (int sweep = 0; sweep < num_sweeps_; ++sweep)
+                    {
+                      barrier_->wait();
+                      for (index_type i = begin; i < end; ++i)
+                      {
+                        real_type sum = b[i];
+                        for (index_type p = diag_pos_[i] + 1; p < row_ptr_[i + 1]; ++p)
+                        {
+                          sum -= values[p] * x_old[col_idx_[p]];
+                        }
+                        x_new[i] = sum / values[diag_pos_[i]];
+                      }
+                      std::swap(x_old, x_new);
+                    }
+                    std::copy(x_old + begin, x_old + end, y + begin);
+                  });
+      }
+
+      /// Forward substitution for row i, L has unit diagonal.
+      void lowerSolveRow(index_type i, const real_type* values, real_type* y) const
+      {
+        real_type sum = y[i];
+        for (index_type p = row_ptr_[i]; p < diag_pos_[i]; ++p)
+        {
+          sum -= values[p] * y[col_idx_[p]];
+        }
+        y[i] = sum;
+      }
+
+      /// Backward substitution for row i.
+      void upperSolveRow(index_type i, const real_type* values, real_type* y) const
+      {
+        real_type sum = y[i];
+        for (index_type p = diag_pos_[i] + 1; p < row_ptr_[i + 1]; ++p)
+        {
+          sum -= values[p] * y[col_idx_[p]];
+        }
+        y[i] = sum / values[diag_pos_[i]];
+      }
+
+    private:
+      index_type        n_{0};
+      const index_type* row_ptr_{nullptr};
+      const index_type* col_idx_{nullptr};
+      const index_type* diag_pos_{nullptr};
+
+      TriangularSolveMethod method_{TriangularSolveMethod::sequential};
+      TriangularSolveMethod selected_{TriangularSolveMethod::sequential}; ///< result of "fastest"
+      bool                  is_selected_{false};
+      int                   num_sweeps_{4};
+
+      LevelSchedule lower_; ///< schedule of forward substitution
+      LevelSchedule upper_; ///< schedule of backward substitution
+
+      std::unique_ptr<ThreadTeam>  own_team_; ///< team of the engine, unless one was set
+      ThreadTeam*                  team_;     ///< team running the solves
+      std::unique_ptr<SpinBarrier> barrier_;
+      std::vector<real_type>       work_;     ///< Jacobi iterates
+    };
+
+  } // namespace examples
+} // namespace ReSolve
@@ -0,0 +1,299 @@
+/**
+ * @file batchRefactor.cpp
+ *
+ * @brief Example of batched refactorization of same-pattern systems on GPU.
+ *
+ * A set of independent linear systems (e.g. scenarios or contingencies)
+ * sharing one sparsity pattern is read from files specified at command line
+ * input. The first system is factorized with KLU on the CPU. Its pivot
+ * sequence and factor pattern are then used to refactorize and solve all
+ * systems at once with batched cusolverRf. Optionally, the same systems are
+ * also solved one at a time with the cusolverRf refactorization solver for
+ * comparison.
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <resolve/LinSolverDirectCuSolverRf.hpp>
+#include <resolve/LinSolverDirectKLU.hpp>
+#include <resolve/matrix/Csc.hpp>
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/io.hpp>
+#include <resolve/utilities/params/CliOptions.hpp>
+#include <resolve/vector/Vector.hpp>
+#include <resolve/workspace/LinAlgWorkspace.hpp>
+
+#include "BatchRefactorization.hpp"
+#include "CsrValueUpdater.hpp"
+#include "ExampleHelper.hpp"
+#include "PatternFingerprint.hpp"
+
+/// Prints help message describing system usage.
+void printHelpInfo()
+{
+  std::cout << "\nbatchRefactor.exe loads from files and solves a batch of linear systems\n";
+  std::cout << "with the same sparsity pattern.\n\n";
+  std::cout << "System matrices are in files with names <pathname>XX.mtx, where XX are\n";
+  std::cout << "consecutive integer numbers 00, 01, 02, ...\n\n";
+  std::cout << "System right hand side vectors are stored in files with matching numbering\n";
+  std::cout << "and file extension.\n\n";
+  std::cout << "Usage:\n\t./";
+  std::cout << "batchRefactor.exe -m <matrix pathname> -r <rhs pathname> -n <number of systems>\n\n";
+  std::cout << "Optional features:\n";
+  std::cout << "\t-e <ext> \tSelects custom extension for input files (default 'mtx').\n";
+  std::cout << "\t-h\tPrints this message.\n";
+  std::cout << "\t-s\tAlso solves systems one at a time with cusolverRf for comparison.\n\n";
+}
+
+int main(int argc, char* argv[])
+{
+  using namespace ReSolve::examples;
+  using namespace ReSolve;
+  using index_type  = ReSolve::index_type;
+  using real_type   = ReSolve::real_type;
+  using vector_type = ReSolve::vector::Vector;
+
+  CliOptions options(argc, argv);
+
+  bool is_help = options.hasKey("-h");
+  if (is_help)
+  {
+    printHelpInfo();
+    return 0;
+  }
+
+  bool is_sequential = options.hasKey("-s");
+
+  index_type num_systems = 0;
+  auto       opt         = options.getParamFromKey("-n");
+  if (opt)
+  {
+    num_systems = atoi((opt->second).c_str());
+  }
+  if (num_systems < 1)
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string matrix_pathname("");
+  opt = options.getParamFromKey("-m");
+  if (opt)
+  {
+    matrix_pathname = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string rhs_pathname("");
+  opt = options.getParamFromKey("-r");
+  if (opt)
+  {
+    rhs_pathname = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string file_extension("mtx");
+  opt = options.getParamFromKey("-e");
+  if (opt)
+  {
+    file_extension = opt->second;
+  }
+
+  LinAlgWorkspaceCUDA workspace;
+  workspace.initializeHandles();
+  ExampleHelper<LinAlgWorkspaceCUDA> helper(workspace);
+
+  matrix::Csr*       A       = nullptr;
+  vector_type*       vec_rhs = nullptr;
+  CsrValueUpdater    value_updater;
+  PatternFingerprint fingerprint;
+
+  // Values and right-hand sides of all systems, one column per system
+  vector_type* values = nullptr;
+  vector_type* B      = nullptr;
+
+  LinSolverDirectKLU KLU;
+
+  for (index_type k = 0; k < num_systems; ++k)
+  {
+    std::ostringstream matname;
+    std::ostringstream rhsname;
+    matname << matrix_pathname << std::setfill('0') << std::setw(2) << k << "." << file_extension;
+    rhsname << rhs_pathname << std::setfill('0') << std::setw(2) << k << "." << file_extension;
+    std::string matrix_pathname_full = matname.str();
+    std::string rhs_pathname_full    = rhsname.str();
+
+    std::ifstream mat_file(matrix_pathname_full);
+    if (!mat_file.is_open())
+    {
+      std::cout << "Failed to open file " << matrix_pathname_full << "\n";
+      return 1;
+    }
+    std::ifstream rhs_file(rhs_pathname_full);
+    if (!rhs_file.is_open())
+    {
+      std::cout << "Failed to open file " << rhs_pathname_full << "\n";
+      return 1;
+    }
+
+    // Refactorization is LU-based, so need to expand symmetric matrices
+    bool is_expand_symmetric = true;
+    if (k == 0)
+    {
+      A       = io::createCsrFromFile(mat_file, is_expand_symmetric);
+      vec_rhs = io::createVectorFromFile(rhs_file);
+      value_updater.setup(mat_file, A);
+      printSystemInfo(matrix_pathname_full, A);
+      fingerprint.update(A);
+
+      values = new vector_type(A->getNnz(), num_systems);
+      B      = new vector_type(A->getNumRows(), num_systems);
+      values->allocate(memory::HOST);
+      B->allocate(memory::HOST);
+
+      // Pivot sequence of the first system is used for the entire batch
+      KLU.setup(A);
+      int status = KLU.analyze();
+      std::cout << "KLU analysis status: " << status << std::endl;
+      status = KLU.factorize();
+      std::cout << "KLU factorization status: " << status << std::endl;
+    }
+    else
+    {
+      index_type nnz           = A->getNnz();
+      int        update_status = value_updater.update(mat_file, A);
+      if (update_status != 0 && update_status != CsrValueUpdater::PATTERN_CHANGED)
+      {
+        return 1;
+      }
+      // Each system occupies a slot of the first system's nnz values
+      if (A->getNnz() != nnz || PatternFingerprint::compute(A) != fingerprint.getValue())
+      {
+        std::cout << "Sparsity pattern of system " << k
+                  << " differs from system 0, all systems in the batch must share one pattern.\n";
+        return 1;
+      }
+      io::updateVectorFromFile(rhs_file, vec_rhs);
+    }
+    mat_file.close();
+    rhs_file.close();
+
+    std::copy(A->getValues(memory::HOST),
+              A->getValues(memory::HOST) + A->getNnz(),
+              values->getData(k, memory::HOST));
+    std::copy(vec_rhs->getData(memory::HOST),
+              vec_rhs->getData(memory::HOST) + A->getNumRows(),
+              B->getData(k, memory::HOST));
+  }
+  std::cout << "Loaded " << num_systems << " systems.\n";
+
+  index_type n = A->getNumRows();
+
+  // Copy the whole batch to the device; solutions overwrite right-hand sides
+  vector_type X(n, num_systems);
+  values->setDataUpdated(memory::HOST);
+  B->setDataUpdated(memory::HOST);
+  values->syncData(memory::DEVICE);
+  B->syncData(memory::DEVICE);
+  X.allocate(memory::DEVICE);
+  X.copyDataFrom(B->getData(memory::DEVICE), memory::DEVICE, memory::DEVICE);
+
+  std::vector<real_type*> value_pointers(num_systems);
+  std::vector<real_type*> x_pointers(num_systems);
+  for (index_type k = 0; k < num_systems; ++k)
+  {
+    value_pointers[k] = values->getData(k, memory::DEVICE);
+    x_pointers[k]     = X.getData(k, memory::DEVICE);
+  }
+
+  // Batched refactorization and solve
+  matrix::Csr* L = (matrix::Csr*) KLU.getLFactorCsr();
+  matrix::Csr* U = (matrix::Csr*) KLU.getUFactorCsr();
+  if (L == nullptr || U == nullptr)
+  {
+    std::cout << "Factor extraction from KLU failed!\n";
+    return 1;
+  }
+  BatchRefactorizationCuda batch;
+  if (batch.setup(A, L, U, KLU.getPOrdering(), KLU.getQOrdering(), num_systems) != 0)
+  {
+    return 1;
+  }
+
+  auto start        = std::chrono::steady_clock::now();
+  int  status_batch = batch.refactorize(value_pointers.data());
+  status_batch += batch.solve(x_pointers.data());
+  auto stop = std::chrono::steady_clock::now();
+
+  double time_batch = std::chrono::duration<double>(stop - start).count();
+  std::cout << "Batched refactorization and solve status: " << status_batch << "\n";
+  X.setDataUpdated(memory::DEVICE);
+
+  // Check accuracy of each solution
+  A->syncData(memory::DEVICE);
+  vector_type b_k(n);
+  vector_type x_k(n);
+  real_type   max_residual = 0.0;
+  for (index_type k = 0; k < num_systems; ++k)
+  {
+    A->copyValues(values->getData(k, memory::DEVICE), memory::DEVICE, memory::DEVICE);
+    b_k.setData(B->getData(k, memory::DEVICE), memory::DEVICE);
+    x_k.setData(X.getData(k, memory::DEVICE), memory::DEVICE);
+    b_k.setDataUpdated(memory::DEVICE);
+    x_k.setDataUpdated(memory::DEVICE);
+    helper.setValuesChanged();
+    helper.resetSystem(A, &b_k, &x_k);
+    max_residual = std::max(max_residual, helper.getNormRelativeResidual());
+  }
+  std::cout << "Batched solve of " << num_systems << " systems: "
+            << std::scientific << std::setprecision(3) << time_batch << " s, "
+            << "largest relative residual norm: " << std::setprecision(16) << max_residual << "\n";
+
+  // One system at a time with the refactorization solver, for comparison
+  if (is_sequential)
+  {
+    LinSolverDirectCuSolverRf Rf;
+    Rf.setup(A, KLU.getLFactor(), KLU.getUFactor(), KLU.getPOrdering(), KLU.getQOrdering());
+
+    start = std::chrono::steady_clock::now();
+    for (index_type k = 0; k < num_systems; ++k)
+    {
+      A->copyValues(values->getData(k, memory::DEVICE), memory::DEVICE, memory::DEVICE);
+      b_k.setData(B->getData(k, memory::DEVICE), memory::DEVICE);
+      x_k.setData(X.getData(k, memory::DEVICE), memory::DEVICE);
+      b_k.setDataUpdated(memory::DEVICE);
+      x_k.setDataUpdated(memory::DEVICE);
+      Rf.refactorize();
+      Rf.solve(&b_k, &x_k);
+    }
+    stop = std::chrono::steady_clock::now();
+    std::cout << "Sequential solve of " << num_systems << " systems: "
+              << std::scientific << std::setprecision(3)
+              << std::chrono::duration<double>(stop - start).count() << " s\n";
+  }
+
+  delete A;
+  delete vec_rhs;
+  delete values;
+  delete B;
+
+  return (status_batch == 0) ? 0 : 1;
+}
@@ -0,0 +1,397 @@
+/**
+ * @file concurrentRefactor.cpp
+ *
+ * @brief Example of solving independent series of linear systems concurrently.
+ *
+ * Several series of linear systems (e.g. different grid models) are solved
+ * at the same time from different host threads. Each thread owns its own
+ * workspace, handlers and solvers, so no state is shared between solvers.
+ * Every series is solved with KLU on the first system and with the GPU
+ * refactorization solver (cusolverRf or rocsolverRf) afterwards, as in
+ * gpuRefactor.cpp. All systems are read before the timed section, which
+ * then measures host and device work only.
+ *
+ * The example reports time spent by each thread and the wall time of all
+ * threads together. Their ratio shows how much of the work overlaps. Work
+ * issued by the library on the legacy default stream is serialized on the
+ * device; overlap of device work requires a Re::Solve build that uses
+ * per-thread default streams (e.g. nvcc `--default-stream per-thread`).
+ */
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <resolve/LinSolverDirectKLU.hpp>
+#include <resolve/matrix/Csc.hpp>
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/MatrixHandler.hpp>
+#include <resolve/matrix/io.hpp>
+#include <resolve/utilities/params/CliOptions.hpp>
+#include <resolve/vector/Vector.hpp>
+#include <resolve/workspace/LinAlgWorkspace.hpp>
+
+#ifdef RESOLVE_USE_CUDA
+#include <resolve/LinSolverDirectCuSolverRf.hpp>
+#endif
+#ifdef RESOLVE_USE_HIP
+#include <resolve/LinSolverDirectRocSolverRf.hpp>
+#endif
+
+#include "ExampleHelper.hpp"
+#include "RefactorizationFactors.hpp"
+#include "ThreadTeam.hpp"
+
+/// Prints help message describing system usage.
+static void printHelpInfo()
+{
+  std::cout << "\nconcurrentRefactor.exe solves independent series of linear systems\n";
+  std::cout << "concurrently, one series per host thread.\n\n";
+  std::cout << "System matrices of a series are in files with names <pathname>XX.mtx,\n";
+  std::cout << "where XX are consecutive integer numbers 00, 01, 02, ...\n\n";
+  std::cout << "Usage:\n\t./";
+  std::cout << "concurrentRefactor.exe -m <matrix pathnames> -r <rhs pathnames> -n <number of systems>\n\n";
+  std::cout << "Pathnames of several series are separated by commas.\n\n";
+  std::cout << "Optional features:\n";
+  std::cout << "\t-e <ext> \tSelects custom extension for input files (default 'mtx').\n";
+  std::cout << "\t-h\tPrints this message.\n";
+  std::cout << "\t-j <num> \tNumber of concurrent solvers (default: number of series).\n";
+  std::cout << "\t\t\tSeries are assigned to solvers round robin.\n";
+  std::cout << "\t-S\tSolves the series one after another, for comparison.\n\n";
+}
+
+/// Systems of one series, read before solving.
+struct SystemSeries
+{
+  ReSolve::matrix::Csr*                        A{nullptr}; ///< matrix with the pattern of the series
+  std::vector<std::vector<ReSolve::real_type>> values;     ///< matrix values of each system
+  std::vector<std::vector<ReSolve::real_type>> rhs;        ///< right-hand side of each system
+};
+
+/// Results of solving one series.
+struct SeriesResult
+{
+  int                status{0};
+  double             time{0.0};         ///< time spent in solves [s]
+  ReSolve::real_type max_residual{0.0}; ///< largest relative residual norm
+  int                num_refactor_fails{0};
+};
+
+/// Split comma separated list of pathnames.
+static std::vector<std::string> splitPathnames(const std::string& list)
+{
+  std::vector<std::string> pathnames;
+  std::stringstream        stream(list);
+  std::string              pathname;
+  while (std::getline(stream, pathname, ','))
+  {
+    if (!pathname.empty())
+    {
+      pathnames.push_back(pathname);
+    }
+  }
+  return pathnames;
+}
+
+/**
+ * @brief Read all systems of a series into host memory.
+ *
+ * @return 0 if successful, 1 otherwise
+ */
+static int readSeries(const std::string& matrix_pathname,
+                      const std::string& rhs_pathname,
+                      const std::string& file_extension,
+                      int                num_systems,
+                      SystemSeries&      series)
+{
+  using namespace ReSolve;
+
+  for (int i = 0; i < num_systems; ++i)
+  {
+    std::ostringstream matname;
+    std::ostringstream rhsname;
+    matname << matrix_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
+    rhsname << rhs_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
+
+    std::ifstream mat_file(matname.str());
+    if (!mat_file.is_open())
+    {
+      std::cout << "Failed to open file " << matname.str() << "\n";
+      return 1;
+    }
+    std::ifstream rhs_file(rhsname.str());
+    if (!rhs_file.is_open())
+    {
+      std::cout << "Failed to open file " << rhsname.str() << "\n";
+      return 1;
+    }
+
+    bool is_expand_symmetric = true;
+    if (i == 0)
+    {
+      series.A = io::createCsrFromFile(mat_file, is_expand_symmetric);
+    }
+    else
+    {
+      io::updateMatrixFromFile(mat_file, series.A);
+    }
+    vector::Vector* vec_rhs = io::createVectorFromFile(rhs_file);
+
+    const real_type* values = series.A->getValues(memory::HOST);
+    const real_type* rhs    = vec_rhs->getData(memory::HOST);
+    series.values.emplace_back(values, values + series.A->getNnz());
+    series.rhs.emplace_back(rhs, rhs + vec_rhs->getSize());
+    delete vec_rhs;
+  }
+  return 0;
+}
+
+/**
+ * @brief Solve all systems of a series with solvers owned by the caller.
+ *
+ * @param[in]  series - systems to solve
+ * @param[in]  start  - barrier all solvers wait at before timing starts,
+ *                      or nullptr
+ * @param[out] result - status, time and accuracy of the solves
+ */
+template <class workspace_type, class refactor_type>
+static void solveSeries(SystemSeries&                   series,
+                        ReSolve::examples::SpinBarrier* start,
+                        SeriesResult&                   result)
+{
+  using namespace ReSolve;
+  using namespace ReSolve::examples;
+  using vector_type = vector::Vector;
+
+  // Everything the solvers use is private to this thread
+  workspace_type workspace;
+  workspace.initializeHandles();
+  ExampleHelper<workspace_type> helper(workspace);
+  MatrixHandler                 matrix_handler(&workspace);
+
+  LinSolverDirectKLU             KLU;
+  std::unique_ptr<refactor_type> Rf = std::make_unique<refactor_type>(&workspace);
+
+  matrix::Csr* A = series.A;
+  index_type   n = A->getNumRows();
+  vector_type  vec_rhs(n);
+  vector_type  vec_x(n);
+  vec_rhs.allocate(memory::HOST);
+  vec_rhs.allocate(memory::DEVICE);
+  vec_x.allocate(memory::HOST);
+  vec_x.allocate(memory::DEVICE);
+
+  if (start != nullptr)
+  {
+    start->wait();
+  }
+  // Solves are synchronous, so no device synchronization (which would
+  // wait for the other solvers too) is needed for timing
+  auto time_start = std::chrono::steady_clock::now();
+
+  for (size_t i = 0; i < series.values.size(); ++i)
+  {
+    A->copyValues(series.values[i].data(), memory::HOST, memory::HOST);
+    A->syncData(memory::DEVICE);
+    vec_rhs.copyDataFrom(series.rhs[i].data(), memory::HOST, memory::DEVICE);
+    matrix_handler.setValuesChanged(true, memory::DEVICE);
+    helper.setValuesChanged();
+
+    int status = 0;
+    if (i == 0)
+    {
+      KLU.setup(A);
+      status = KLU.analyze();
+      status += KLU.factorize();
+      status += Rf->setup(A,
+                          (matrix::Csc*) KLU.getLFactor(),
+                          (matrix::Csc*) KLU.getUFactor(),
+                          KLU.getPOrdering(),
+                          KLU.getQOrdering(),
+                          &vec_rhs);
+      status += Rf->refactorize();
+    }
+    else
+    {
+      status = Rf->refactorize();
+      if (status != 0)
+      {
+        // Pattern is unchanged, so redo only the numeric factorization
+        ++result.num_refactor_fails;
+        status = KLU.factorize();
+        renewRefactorizationSolver(Rf, &workspace);
+        status += Rf->setup(A,
+                            (matrix::Csc*) KLU.getLFactor(),
+                            (matrix::Csc*) KLU.getUFactor(),
+                            KLU.getPOrdering(),
+                            KLU.getQOrdering(),
+                            &vec_rhs);
+        status += Rf->refactorize();
+      }
+    }
+    status += Rf->solve(&vec_rhs, &vec_x);
+    result.status += status;
+
+    helper.resetSystem(A, &vec_rhs, &vec_x);
+    result.max_residual = std::max(result.max_residual, helper.getNormRelativeResidual());
+  }
+  result.time = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+}
+
+/// Prototype of the example function
+template <class workspace_type, class refactor_type>
+static int concurrentRefactor(int argc, char* argv[]);
+
+/// Main function selects example to be run.
+int main(int argc, char* argv[])
+{
+#ifdef RESOLVE_USE_CUDA
+  return concurrentRefactor<ReSolve::LinAlgWorkspaceCUDA,
+                            ReSolve::LinSolverDirectCuSolverRf>(argc, argv);
+#endif
+
+#ifdef RESOLVE_USE_HIP
+  return concurrentRefactor<ReSolve::LinAlgWorkspaceHIP,
+                            ReSolve::LinSolverDirectRocSolverRf>(argc, argv);
+#endif
+}
+
+/**
+ * @brief Example of concurrent refactorization solvers on GPU
+ *
+ * @tparam workspace_type - Type of the workspace to use
+ * @tparam refactor_type  - Type of the refactorization solver
+ * @param[in] argc - Number of command line arguments
+ * @param[in] argv - Command line arguments
+ * @return 0 if the example ran successfully, 1 otherwise
+ */
+template <class workspace_type, class refactor_type>
+int concurrentRefactor(int argc, char* argv[])
+{
+  using namespace ReSolve;
+  using namespace ReSolve::examples;
+
+  CliOptions options(argc, argv);
+
+  if (options.hasKey("-h"))
+  {
+    printHelpInfo();
+    return 0;
+  }
+
+  int  num_systems = 0;
+  auto opt         = options.getParamFromKey("-n");
+  if (opt)
+  {
+    num_systems = atoi((opt->second).c_str());
+  }
+
+  std::vector<std::string> matrix_pathnames;
+  opt = options.getParamFromKey("-m");
+  if (opt)
+  {
+    matrix_pathnames = splitPathnames(opt->second);
+  }
+
+  std::vector<std::string> rhs_pathnames;
+  opt = options.getParamFromKey("-r");
+  if (opt)
+  {
+    rhs_pathnames = splitPathnames(opt->second);
+  }
+
+  if (num_systems <= 0 || matrix_pathnames.empty() || matrix_pathnames.size() != rhs_pathnames.size())
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string file_extension("mtx");
+  opt = options.getParamFromKey("-e");
+  if (opt)
+  {
+    file_extension = opt->second;
+  }
+
+  int num_solvers = static_cast<int>(matrix_pathnames.size());
+  opt             = options.getParamFromKey("-j");
+  if (opt)
+  {
+    num_solvers = std::max(1, atoi((opt->second).c_str()));
+  }
+
+  bool is_serial = options.hasKey("-S");
+
+  // Read all series; series are assigned to solvers round robin
+  std::vector<SystemSeries> series(num_solvers);
+  for (int s = 0; s < num_solvers; ++s)
+  {
+    size_t model = s % matrix_pathnames.size();
+    if (readSeries(matrix_pathnames[model], rhs_pathnames[model], file_extension, num_systems, series[s]) != 0)
+    {
+      return 1;
+    }
+  }
+
+  // Host wall clock only; a device synchronization would wait for the
+  // work of all solvers and hide how much of it overlaps
+  using clock = std::chrono::steady_clock;
+  std::vector<SeriesResult> results(num_solvers);
+  clock::time_point         time_start;
+  if (is_serial)
+  {
+    time_start = clock::now();
+    for (int s = 0; s < num_solvers; ++s)
+    {
+      solveSeries<workspace_type, refactor_type>(series[s], nullptr, results[s]);
+    }
+  }
+  else
+  {
+    // Solvers are set up in their threads; timing starts when all are ready
+    SpinBarrier              start(num_solvers + 1);
+    std::vector<std::thread> threads;
+    for (int s = 0; s < num_solvers; ++s)
+    {
+      threads.emplace_back([&series, &start, &results, s]()
+                           { solveSeries<workspace_type, refactor_type>(series[s], &start, results[s]); });
+    }
+    start.wait();
+    time_start = clock::now();
+    for (std::thread& thread : threads)
+    {
+      thread.join();
+    }
+  }
+  double wall_time = std::chrono::duration<double>(clock::now() - time_start).count();
+
+  // Print summary of the results
+  int    status     = 0;
+  double total_time = 0.0;
+  std::cout << std::left << std::setw(8) << "solver" << std::setw(40) << "series" << std::right
+            << std::setw(12) << "time [s]" << std::setw(14) << "max res." << std::setw(12) << "Rf fails" << "\n";
+  for (int s = 0; s < num_solvers; ++s)
+  {
+    std::cout << std::left << std::setw(8) << s
+              << std::setw(40) << matrix_pathnames[s % matrix_pathnames.size()] << std::right
+              << std::fixed << std::setprecision(4) << std::setw(12) << results[s].time
+              << std::scientific << std::setprecision(3) << std::setw(14) << results[s].max_residual
+              << std::setw(12) << results[s].num_refactor_fails << "\n";
+    status += results[s].status;
+    total_time += results[s].time;
+    delete series[s].A;
+  }
+  std::cout << (is_serial ? "Serial" : "Concurrent") << " wall time: " << std::fixed << std::setprecision(4)
+            << wall_time << " s, " << num_solvers * num_systems / wall_time << " systems/s"
+            << ", overlap (sum of solver times / wall time): " << std::setprecision(2)
+            << total_time / wall_time << "\n";
+
+  return status == 0 ? 0 : 1;
+}
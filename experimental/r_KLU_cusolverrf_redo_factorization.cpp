@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <string>
@@ -13,6 +14,12 @@
 #include <resolve/vector/VectorHandler.hpp>
 #include <resolve/workspace/LinAlgWorkspace.hpp>
 
+#include "../Benchmark.hpp"
+#include "../PatternFingerprint.hpp"
+#include "../PinnedMemory.hpp"
+#include "../RefactorizationFactors.hpp"
+#include "../RefactorizationPolicy.hpp"
+
 using namespace ReSolve::constants;
 
 int main(int argc, char* argv[])
@@ -62,6 +69,22 @@ int main(int argc, char* argv[])
 
   int status          = 0;
   int status_refactor = 0;
+
+  // Decides when the solution requires a new host factorization
+  ReSolve::examples::RefactorizationPolicy policy;
+  // CSR factor buffers and pivot sequence of the current cusolverRf setup
+  ReSolve::examples::RefactorizationFactors factors;
+  // Next system, read and copied to the device while the current one is solved
+  ReSolve::matrix::Csr*                A_next   = nullptr;
+  real_type*                           rhs_next = nullptr;
+  ReSolve::examples::StagedSystemCopy* staged   = nullptr;
+  // Only systems with the sparsity pattern of the current one are staged
+  ReSolve::examples::PatternFingerprint fingerprint;
+  // Host data of the next system is page-locked for the asynchronous copies
+  ReSolve::examples::HostMemoryPinner pinner;
+  void*                               pinned_values = nullptr;
+  void*                               pinned_rhs    = nullptr;
+
   for (int i = 0; i < numSystems; ++i)
   {
     index_type j = 4 + i * 2;
@@ -81,55 +104,108 @@ int main(int argc, char* argv[])
     std::cout << "Reading: " << matrixFileNameFull << std::endl;
     std::cout << "========================================================================================================================" << std::endl;
     std::cout << std::endl;
-    // Read first matrix
-    std::ifstream mat_file(matrixFileNameFull);
-    if (!mat_file.is_open())
-    {
-      std::cout << "Failed to open file " << matrixFileNameFull << "\n";
-      return -1;
-    }
-    std::ifstream rhs_file(rhsFileNameFull);
-    if (!rhs_file.is_open())
-    {
-      std::cout << "Failed to open file " << rhsFileNameFull << "\n";
-      return -1;
-    }
     bool is_expand_symmetric = true;
-    if (i == 0)
+    if (staged != nullptr && staged->isStaged())
     {
-      A = ReSolve::io::createCsrFromFile(mat_file, is_expand_symmetric);
-
-      rhs     = ReSolve::io::createArrayFromFile(rhs_file);
-      x       = new real_type[A->getNumRows()];
-      vec_rhs = new vector_type(A->getNumRows());
-      vec_x   = new vector_type(A->getNumRows());
-      vec_r   = new vector_type(A->getNumRows());
+      // System i was read and copied to the device while system i-1 was
+      // solved; host data is kept current for KLU and the residual
+      A->copyValues(A_next->getValues(ReSolve::memory::HOST), ReSolve::memory::HOST, ReSolve::memory::HOST);
+      std::copy(rhs_next, rhs_next + A->getNumRows(), rhs);
+      if (staged->commit(A, vec_rhs) != 0)
+      {
+        std::cout << "Failed to copy system " << i << " to the device.\n";
+        return -1;
+      }
+      std::cout << "System " << i << " was copied to the device while system " << i - 1 << " was solved.\n";
     }
     else
     {
-      ReSolve::io::updateMatrixFromFile(mat_file, A);
-      ReSolve::io::updateArrayFromFile(rhs_file, &rhs);
-    }
-    // Copy matrix data to device
-    A->syncData(ReSolve::memory::DEVICE);
+      std::ifstream mat_file(matrixFileNameFull);
+      if (!mat_file.is_open())
+      {
+        std::cout << "Failed to open file " << matrixFileNameFull << "\n";
+        return -1;
+      }
+      std::ifstream rhs_file(rhsFileNameFull);
+      if (!rhs_file.is_open())
+      {
+        std::cout << "Failed to open file " << rhsFileNameFull << "\n";
+        return -1;
+      }
+      if (i == 0)
+      {
+        A = ReSolve::io::createCsrFromFile(mat_file, is_expand_symmetric);
 
-    std::cout << "Finished reading the matrix and rhs, size: " << A->getNumRows() << " x " << A->getNumColumns()
-              << ", nnz: " << A->getNnz()
-              << ", symmetric? " << A->symmetric()
-              << ", Expanded? " << A->expanded() << std::endl;
-    mat_file.close();
-    rhs_file.close();
+        rhs     = ReSolve::io::createArrayFromFile(rhs_file);
+        x       = new real_type[A->getNumRows()];
+        vec_rhs = new vector_type(A->getNumRows());
+        vec_x   = new vector_type(A->getNumRows());
+        vec_r   = new vector_type(A->getNumRows());
+        staged  = new ReSolve::examples::StagedSystemCopy(A->getNumRows(), A->getNnz());
+      }
+      else
+      {
+        ReSolve::io::updateMatrixFromFile(mat_file, A);
+        ReSolve::io::updateArrayFromFile(rhs_file, &rhs);
+      }
+      fingerprint.update(A);
+      // System was not staged, copy it to the device before the solvers use it
+      A->syncData(ReSolve::memory::DEVICE);
 
-    // Update host and device data.
-    if (i < 2)
-    {
-      vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::HOST);
+      std::cout << "Finished reading the matrix and rhs, size: " << A->getNumRows() << " x " << A->getNumColumns()
+                << ", nnz: " << A->getNnz()
+                << ", symmetric? " << A->symmetric()
+                << ", Expanded? " << A->expanded() << std::endl;
+      mat_file.close();
+      rhs_file.close();
+
+      // Update host and device data.
+      if (i < 2)
+      {
+        vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::HOST);
+      }
+      else
+      {
+        vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
+      }
     }
-    else
+    std::cout << "CSR matrix loaded. Expanded NNZ: " << A->getNnz() << std::endl;
+
+    // Read system i+1 and issue its copy to the device before system i is
+    // solved; the first two systems are solved by KLU from host data
+    if (i >= 1 && i + 1 < numSystems)
     {
-      vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
+      std::string   next_matrix_file_name = matrixFileName + argv[6 + i * 2] + ".mtx";
+      std::string   next_rhs_file_name    = rhsFileName + argv[7 + i * 2] + ".mtx";
+      std::ifstream next_mat_file(next_matrix_file_name);
+      std::ifstream next_rhs_file(next_rhs_file_name);
+      // Files that fail to open are reported when system i+1 is read again
+      if (next_mat_file.is_open() && next_rhs_file.is_open())
+      {
+        if (A_next == nullptr)
+        {
+          A_next   = ReSolve::io::createCsrFromFile(next_mat_file, is_expand_symmetric);
+          rhs_next = ReSolve::io::createArrayFromFile(next_rhs_file);
+        }
+        else
+        {
+          ReSolve::io::updateMatrixFromFile(next_mat_file, A_next);
+          ReSolve::io::updateArrayFromFile(next_rhs_file, &rhs_next);
+        }
+
+        // Only values are staged; a system with a new pattern is read again in its own step
+        if (A_next->getNnz() == A->getNnz()
+            && ReSolve::examples::PatternFingerprint::compute(A_next) == fingerprint.getValue())
+        {
+          // Reading may have reallocated the host arrays
+          pinner.repin(pinned_values,
+                       A_next->getValues(ReSolve::memory::HOST),
+                       A_next->getNnz() * sizeof(real_type));
+          pinner.repin(pinned_rhs, rhs_next, A->getNumRows() * sizeof(real_type));
+          staged->stage(A_next->getValues(ReSolve::memory::HOST), rhs_next);
+        }
+      }
     }
-    std::cout << "CSR matrix loaded. Expanded NNZ: " << A->getNnz() << std::endl;
 
     // Now call direct solver
     if (i < 2)
@@ -143,24 +219,14 @@ int main(int argc, char* argv[])
       std::cout << "KLU solve status: " << status << std::endl;
       if (i == 1)
       {
-        L_csc                   = (ReSolve::matrix::Csc*) KLU->getLFactor();
-        U_csc                   = (ReSolve::matrix::Csc*) KLU->getUFactor();
-        ReSolve::matrix::Csr* L = new ReSolve::matrix::Csr(L_csc->getNumRows(), L_csc->getNumColumns(), L_csc->getNnz());
-        ReSolve::matrix::Csr* U = new ReSolve::matrix::Csr(U_csc->getNumRows(), U_csc->getNumColumns(), U_csc->getNnz());
-        L_csc->syncData(ReSolve::memory::DEVICE);
-        U_csc->syncData(ReSolve::memory::DEVICE);
-        matrix_handler->csc2csr(L_csc, L, ReSolve::memory::DEVICE);
-        matrix_handler->csc2csr(U_csc, U, ReSolve::memory::DEVICE);
-        if (L == nullptr)
-        {
-          std::cout << "ERROR\n";
-        }
-        P = KLU->getPOrdering();
-        Q = KLU->getQOrdering();
-        Rf->setup(A, L, U, P, Q);
+        L_csc = (ReSolve::matrix::Csc*) KLU->getLFactor();
+        U_csc = (ReSolve::matrix::Csc*) KLU->getUFactor();
+        P     = KLU->getPOrdering();
+        Q     = KLU->getQOrdering();
+        factors.update(L_csc, U_csc, P, Q);
+        factors.convert(matrix_handler, L_csc, U_csc, ReSolve::memory::DEVICE);
+        Rf->setup(A, factors.getL(), factors.getU(), P, Q);
         Rf->refactorize();
-        delete L;
-        delete U;
       }
     }
     else
@@ -181,9 +247,10 @@ int main(int argc, char* argv[])
     std::cout << "\t2-Norm of the residual: "
               << std::scientific << std::setprecision(16)
               << res_nrm / b_nrm << "\n";
-    if (((res_nrm / b_nrm > 1e-7) && (!std::isnan(res_nrm))) || (status_refactor != 0))
+    policy.recordStep(status_refactor, res_nrm / b_nrm);
+    if (!policy.isSolutionAcceptable())
     {
-      if ((res_nrm / b_nrm > 1e-7))
+      if (status_refactor == 0)
       {
         std::cout << "\n \t !!! ALERT !!! Residual norm is too large; redoing KLU symbolic and numeric factorization. !!! ALERT !!! \n \n";
       }
@@ -191,6 +258,8 @@ int main(int argc, char* argv[])
       {
         std::cout << "\n \t !!! ALERT !!! cuSolverRf crashed; redoing KLU symbolic and numeric factorization. !!! ALERT !!! \n \n";
       }
+      ReSolve::examples::PhaseTimer factorization_timer;
+      factorization_timer.start();
       KLU->setup(A);
       status = KLU->analyze();
       std::cout << "KLU analysis status: " << status << std::endl;
@@ -213,24 +282,30 @@ int main(int argc, char* argv[])
 
       L_csc = (ReSolve::matrix::Csc*) KLU->getLFactor();
       U_csc = (ReSolve::matrix::Csc*) KLU->getUFactor();
+      P     = KLU->getPOrdering();
+      Q     = KLU->getQOrdering();
 
-      ReSolve::matrix::Csr* L = new ReSolve::matrix::Csr(L_csc->getNumRows(), L_csc->getNumColumns(), L_csc->getNnz());
-      ReSolve::matrix::Csr* U = new ReSolve::matrix::Csr(U_csc->getNumRows(), U_csc->getNumColumns(), U_csc->getNnz());
-      matrix_handler->csc2csr(L_csc, L, ReSolve::memory::DEVICE);
-      matrix_handler->csc2csr(U_csc, U, ReSolve::memory::DEVICE);
-
-      P = KLU->getPOrdering();
-      Q = KLU->getQOrdering();
-
-      Rf->setup(A, L, U, P, Q);
-      Rf->refactorize();
-
-      delete L;
-      delete U;
+      // Refactorization needs a new setup only if pivoting or fill changed
+      if (factors.update(L_csc, U_csc, P, Q))
+      {
+        factors.convert(matrix_handler, L_csc, U_csc, ReSolve::memory::DEVICE);
+        ReSolve::examples::renewRefactorizationSolver(Rf);
+        Rf->setup(A, factors.getL(), factors.getU(), P, Q);
+        Rf->refactorize();
+      }
+      else
+      {
+        std::cout << "Pivot sequence unchanged, reusing cusolverRf setup.\n";
+      }
+      policy.recordFactorization(factorization_timer.stop());
     }
   } // for (int i = 0; i < numSystems; ++i)
 
   // now DELETE
+  delete staged; // Copies still in flight finish before their sources are unpinned
+  pinner.unpinAll();
+  delete A_next;
+  delete[] rhs_next;
   delete A;
   delete KLU;
   delete Rf;
@@ -15,6 +15,8 @@
 #include <resolve/vector/VectorHandler.hpp>
 #include <resolve/workspace/LinAlgWorkspace.hpp>
 
+#include "../RefactorizationFactors.hpp"
+
 using namespace ReSolve::constants;
 
 int main(int argc, char* argv[])
@@ -56,6 +58,9 @@ int main(int argc, char* argv[])
   ReSolve::LinSolverDirectCuSolverRf* Rf     = new ReSolve::LinSolverDirectCuSolverRf;
   ReSolve::LinSolverIterativeFGMRES*  FGMRES = new ReSolve::LinSolverIterativeFGMRES(matrix_handler, vector_handler, GS);
 
+  // CSR factor buffers used for cusolverRf setup
+  ReSolve::examples::RefactorizationFactors factors;
+
   for (int i = 0; i < numSystems; ++i)
   {
     index_type j = 4 + i * 2;
@@ -153,20 +158,10 @@ int main(int argc, char* argv[])
       {
         ReSolve::matrix::Csc* L_csc = (ReSolve::matrix::Csc*) KLU->getLFactor();
         ReSolve::matrix::Csc* U_csc = (ReSolve::matrix::Csc*) KLU->getUFactor();
-        ReSolve::matrix::Csr* L     = new ReSolve::matrix::Csr(L_csc->getNumRows(), L_csc->getNumColumns(), L_csc->getNnz());
-        ReSolve::matrix::Csr* U     = new ReSolve::matrix::Csr(U_csc->getNumRows(), U_csc->getNumColumns(), U_csc->getNnz());
-        L_csc->syncData(ReSolve::memory::DEVICE);
-        U_csc->syncData(ReSolve::memory::DEVICE);
-
-        matrix_handler->csc2csr(L_csc, L, ReSolve::memory::DEVICE);
-        matrix_handler->csc2csr(U_csc, U, ReSolve::memory::DEVICE);
-        if (L == nullptr)
-        {
-          std::cout << "ERROR\n";
-        }
+        factors.convert(matrix_handler, L_csc, U_csc, ReSolve::memory::DEVICE);
         index_type* P = KLU->getPOrdering();
         index_type* Q = KLU->getQOrdering();
-        Rf->setup(A, L, U, P, Q);
+        Rf->setup(A, factors.getL(), factors.getU(), P, Q);
         std::cout << "about to set FGMRES" << std::endl;
         FGMRES->setRestart(1000);
         FGMRES->setMaxit(2000);
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <iomanip>
 #include <iostream>
 #include <string>
@@ -13,6 +14,12 @@
 #include <resolve/vector/VectorHandler.hpp>
 #include <resolve/workspace/LinAlgWorkspace.hpp>
 
+#include "../Benchmark.hpp"
+#include "../PatternFingerprint.hpp"
+#include "../PinnedMemory.hpp"
+#include "../RefactorizationFactors.hpp"
+#include "../RefactorizationPolicy.hpp"
+
 using namespace ReSolve::constants;
 
 int main(int argc, char* argv[])
@@ -54,6 +61,24 @@ int main(int argc, char* argv[])
   real_type res_nrm;
   real_type b_nrm;
 
+  int status_refactor = 0;
+
+  // Decides when the solution requires a new host factorization
+  ReSolve::examples::RefactorizationPolicy policy;
+  // Pivot sequence and factor pattern of the current rocsolverRf setup
+  ReSolve::examples::RefactorizationFactors factors;
+
+  // Next system, read and copied to the device while the current one is solved
+  ReSolve::matrix::Csr*                A_next   = nullptr;
+  real_type*                           rhs_next = nullptr;
+  ReSolve::examples::StagedSystemCopy* staged   = nullptr;
+  // Only systems with the sparsity pattern of the current one are staged
+  ReSolve::examples::PatternFingerprint fingerprint;
+  // Host data of the next system is page-locked for the asynchronous copies
+  ReSolve::examples::HostMemoryPinner pinner;
+  void*                               pinned_values = nullptr;
+  void*                               pinned_rhs    = nullptr;
+
   for (int i = 0; i < numSystems; ++i)
   {
     index_type j = 4 + i * 2;
@@ -73,55 +98,108 @@ int main(int argc, char* argv[])
     std::cout << "Reading: " << matrixFileNameFull << std::endl;
     std::cout << "========================================================================================================================" << std::endl;
     std::cout << std::endl;
-    // Read first matrix
-    std::ifstream mat_file(matrixFileNameFull);
-    if (!mat_file.is_open())
-    {
-      std::cout << "Failed to open file " << matrixFileNameFull << "\n";
-      return -1;
-    }
-    std::ifstream rhs_file(rhsFileNameFull);
-    if (!rhs_file.is_open())
-    {
-      std::cout << "Failed to open file " << rhsFileNameFull << "\n";
-      return -1;
-    }
     bool is_expand_symmetric = true;
-    if (i == 0)
+    if (staged != nullptr && staged->isStaged())
     {
-      A = ReSolve::io::createCsrFromFile(mat_file, is_expand_symmetric);
-
-      rhs     = ReSolve::io::createArrayFromFile(rhs_file);
-      x       = new real_type[A->getNumRows()];
-      vec_rhs = new vector_type(A->getNumRows());
-      vec_x   = new vector_type(A->getNumRows());
-      vec_r   = new vector_type(A->getNumRows());
+      // System i was read and copied to the device while system i-1 was
+      // solved; host data is kept current for KLU and the residual
+      A->copyValues(A_next->getValues(ReSolve::memory::HOST), ReSolve::memory::HOST, ReSolve::memory::HOST);
+      std::copy(rhs_next, rhs_next + A->getNumRows(), rhs);
+      if (staged->commit(A, vec_rhs) != 0)
+      {
+        std::cout << "Failed to copy system " << i << " to the device.\n";
+        return -1;
+      }
+      std::cout << "System " << i << " was copied to the device while system " << i - 1 << " was solved.\n";
     }
     else
     {
-      ReSolve::io::updateMatrixFromFile(mat_file, A);
-      ReSolve::io::updateArrayFromFile(rhs_file, &rhs);
-    }
-    // Copy matrix data to device
-    A->syncData(ReSolve::memory::DEVICE);
+      std::ifstream mat_file(matrixFileNameFull);
+      if (!mat_file.is_open())
+      {
+        std::cout << "Failed to open file " << matrixFileNameFull << "\n";
+        return -1;
+      }
+      std::ifstream rhs_file(rhsFileNameFull);
+      if (!rhs_file.is_open())
+      {
+        std::cout << "Failed to open file " << rhsFileNameFull << "\n";
+        return -1;
+      }
+      if (i == 0)
+      {
+        A = ReSolve::io::createCsrFromFile(mat_file, is_expand_symmetric);
 
-    std::cout << "Finished reading the matrix and rhs, size: " << A->getNumRows() << " x " << A->getNumColumns()
-              << ", nnz: " << A->getNnz()
-              << ", symmetric? " << A->symmetric()
-              << ", Expanded? " << A->expanded() << std::endl;
-    mat_file.close();
-    rhs_file.close();
+        rhs     = ReSolve::io::createArrayFromFile(rhs_file);
+        x       = new real_type[A->getNumRows()];
+        vec_rhs = new vector_type(A->getNumRows());
+        vec_x   = new vector_type(A->getNumRows());
+        vec_r   = new vector_type(A->getNumRows());
+        staged  = new ReSolve::examples::StagedSystemCopy(A->getNumRows(), A->getNnz());
+      }
+      else
+      {
+        ReSolve::io::updateMatrixFromFile(mat_file, A);
+        ReSolve::io::updateArrayFromFile(rhs_file, &rhs);
+      }
+      fingerprint.update(A);
+      // System was not staged, copy it to the device before the solvers use it
+      A->syncData(ReSolve::memory::DEVICE);
 
-    // Update host and device data.
-    if (i < 2)
-    {
-      vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::HOST);
+      std::cout << "Finished reading the matrix and rhs, size: " << A->getNumRows() << " x " << A->getNumColumns()
+                << ", nnz: " << A->getNnz()
+                << ", symmetric? " << A->symmetric()
+                << ", Expanded? " << A->expanded() << std::endl;
+      mat_file.close();
+      rhs_file.close();
+
+      // Update host and device data.
+      if (i < 2)
+      {
+        vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::HOST);
+      }
+      else
+      {
+        vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
+      }
     }
-    else
+    std::cout << "CSR matrix loaded. Expanded NNZ: " << A->getNnz() << std::endl;
+
+    // Read system i+1 and issue its copy to the device before system i is
+    // solved; the first two systems are solved by KLU from host data
+    if (i >= 1 && i + 1 < numSystems)
     {
-      vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
+      std::string   next_matrix_file_name = matrixFileName + argv[6 + i * 2] + ".mtx";
+      std::string   next_rhs_file_name    = rhsFileName + argv[7 + i * 2] + ".mtx";
+      std::ifstream next_mat_file(next_matrix_file_name);
+      std::ifstream next_rhs_file(next_rhs_file_name);
+      // Files that fail to open are reported when system i+1 is read again
+      if (next_mat_file.is_open() && next_rhs_file.is_open())
+      {
+        if (A_next == nullptr)
+        {
+          A_next   = ReSolve::io::createCsrFromFile(next_mat_file, is_expand_symmetric);
+          rhs_next = ReSolve::io::createArrayFromFile(next_rhs_file);
+        }
+        else
+        {
+          ReSolve::io::updateMatrixFromFile(next_mat_file, A_next);
+          ReSolve::io::updateArrayFromFile(next_rhs_file, &rhs_next);
+        }
+
+        // Only values are staged; a system with a new pattern is read again in its own step
+        if (A_next->getNnz() == A->getNnz()
+            && ReSolve::examples::PatternFingerprint::compute(A_next) == fingerprint.getValue())
+        {
+          // Reading may have reallocated the host arrays
+          pinner.repin(pinned_values,
+                       A_next->getValues(ReSolve::memory::HOST),
+                       A_next->getNnz() * sizeof(real_type));
+          pinner.repin(pinned_rhs, rhs_next, A->getNumRows() * sizeof(real_type));
+          staged->stage(A_next->getValues(ReSolve::memory::HOST), rhs_next);
+        }
+      }
     }
-    std::cout << "CSR matrix loaded. Expanded NNZ: " << A->getNnz() << std::endl;
 
     // Now call direct solver
     int status = 0;
@@ -141,6 +219,7 @@ int main(int argc, char* argv[])
         index_type*           P = KLU->getPOrdering();
         index_type*           Q = KLU->getQOrdering();
         vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
+        factors.update(L, U, P, Q);
         Rf->setup(A, L, U, P, Q, vec_rhs);
         Rf->refactorize();
       }
@@ -148,8 +227,8 @@ int main(int argc, char* argv[])
     else
     {
       std::cout << "Using rocsolver rf" << std::endl;
-      status = Rf->refactorize();
-      std::cout << "rocsolver rf refactorization status: " << status << std::endl;
+      status_refactor = Rf->refactorize();
+      std::cout << "rocsolver rf refactorization status: " << status_refactor << std::endl;
       status = Rf->solve(vec_rhs, vec_x);
       std::cout << "rocsolver rf solve status: " << status << std::endl;
     }
@@ -163,46 +242,60 @@ int main(int argc, char* argv[])
     std::cout << "\t 2-Norm of the residual: "
               << std::scientific << std::setprecision(16)
               << res_nrm / b_nrm << "\n";
-    if (!isnan(res_nrm))
+    policy.recordStep(status_refactor, res_nrm / b_nrm);
+    if (!policy.isSolutionAcceptable())
     {
-      if (res_nrm / b_nrm > 1e-7)
-      {
-        std::cout << "\n \t !!! ALERT !!! Residual norm is too large; "
-                  << "redoing KLU symbolic and numeric factorization. !!! ALERT !!! \n\n";
+      std::cout << "\n \t !!! ALERT !!! " << (status_refactor == 0 ? "Residual norm is too large" : "rocSolverRf crashed")
+                << "; redoing KLU symbolic and numeric factorization. !!! ALERT !!! \n\n";
 
-        KLU->setup(A);
-        status = KLU->analyze();
-        std::cout << "KLU analysis status: " << status << std::endl;
-        status = KLU->factorize();
-        std::cout << "KLU factorization status: " << status << std::endl;
-        status = KLU->solve(vec_rhs, vec_x);
-        std::cout << "KLU solve status: " << status << std::endl;
+      ReSolve::examples::PhaseTimer factorization_timer;
+      factorization_timer.start();
+      KLU->setup(A);
+      status = KLU->analyze();
+      std::cout << "KLU analysis status: " << status << std::endl;
+      status = KLU->factorize();
+      std::cout << "KLU factorization status: " << status << std::endl;
+      status = KLU->solve(vec_rhs, vec_x);
+      std::cout << "KLU solve status: " << status << std::endl;
 
-        vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
-        vec_r->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
+      vec_rhs->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
+      vec_r->copyDataFrom(rhs, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
 
-        matrix_handler->setValuesChanged(true, ReSolve::memory::DEVICE);
+      matrix_handler->setValuesChanged(true, ReSolve::memory::DEVICE);
 
-        matrix_handler->matvec(A, vec_x, vec_r, &ONE, &MINUS_ONE, ReSolve::memory::DEVICE);
-        res_nrm = sqrt(vector_handler->dot(vec_r, vec_r, ReSolve::memory::DEVICE));
+      matrix_handler->matvec(A, vec_x, vec_r, &ONE, &MINUS_ONE, ReSolve::memory::DEVICE);
+      res_nrm = sqrt(vector_handler->dot(vec_r, vec_r, ReSolve::memory::DEVICE));
 
-        std::cout << "\t New residual norm: "
-                  << std::scientific << std::setprecision(16)
-                  << res_nrm / b_nrm << "\n";
+      std::cout << "\t New residual norm: "
+                << std::scientific << std::setprecision(16)
+                << res_nrm / b_nrm << "\n";
 
-        ReSolve::matrix::Csc* L = (ReSolve::matrix::Csc*) KLU->getLFactor();
-        ReSolve::matrix::Csc* U = (ReSolve::matrix::Csc*) KLU->getUFactor();
+      ReSolve::matrix::Csc* L = (ReSolve::matrix::Csc*) KLU->getLFactor();
+      ReSolve::matrix::Csc* U = (ReSolve::matrix::Csc*) KLU->getUFactor();
 
-        index_type* P = KLU->getPOrdering();
-        index_type* Q = KLU->getQOrdering();
+      index_type* P = KLU->getPOrdering();
+      index_type* Q = KLU->getQOrdering();
 
+      // Refactorization needs a new setup only if pivoting or fill changed
+      if (factors.update(L, U, P, Q))
+      {
+        ReSolve::examples::renewRefactorizationSolver(Rf, workspace_HIP);
         Rf->setup(A, L, U, P, Q, vec_rhs);
       }
+      else
+      {
+        std::cout << "Pivot sequence unchanged, reusing rocsolverRf setup.\n";
+      }
+      policy.recordFactorization(factorization_timer.stop());
     }
 
   } // for (int i = 0; i < numSystems; ++i)
 
   // now DELETE
+  delete staged; // Copies still in flight finish before their sources are unpinned
+  pinner.unpinAll();
+  delete A_next;
+  delete[] rhs_next;
   delete A;
   delete KLU;
   delete Rf;
@@ -33,7 +33,10 @@
 #include <resolve/LinSolverDirectCuSolverGLU.hpp>
 #endif
 
+#include "BinarySequence.hpp"
+#include "CsrValueUpdater.hpp"
 #include "ExampleHelper.hpp"
+#include "RangeTimer.hpp"
 
 /// Prints help message describing system usage.
 void printHelpInfo()
@@ -47,6 +50,8 @@ void printHelpInfo()
   std::cout << "gluRefactor.exe -m <matrix pathname> -r <rhs pathname> -n <number of systems>\n\n";
   std::cout << "Optional features:\n";
   std::cout << "\t-e <ext> \tSelects custom extension for input files (default 'mtx').\n";
+  std::cout << "\t-f <mtx|bin> \tSelects input format (default 'mtx'). With 'bin', -m is a binary\n";
+  std::cout << "\t\t\tsequence file created by mtxToBin.exe and -r is not used.\n";
   std::cout << "\t-h\tPrints this message.\n";
 }
 
@@ -117,13 +122,21 @@ int gluRefactor(int argc, char* argv[])
     return 1;
   }
 
+  std::string file_format("mtx");
+  opt = options.getParamFromKey("-f");
+  if (opt)
+  {
+    file_format = opt->second;
+  }
+  bool is_binary = (file_format == "bin");
+
   std::string rhs_pathname("");
   opt = options.getParamFromKey("-r");
   if (opt)
   {
     rhs_pathname = opt->second;
   }
-  else
+  else if (!is_binary)
   {
     std::cout << "Incorrect input!\n\n";
     printHelpInfo();
@@ -141,6 +154,24 @@ int gluRefactor(int argc, char* argv[])
     file_extension = "mtx";
   }
 
+  // Cached positions of matrix file entries for value updates
+  CsrValueUpdater value_updater;
+
+  // Map binary sequence file, if one is used
+  BinarySequenceReader sequence;
+  if (is_binary)
+  {
+    if (sequence.open(matrix_pathname) != 0)
+    {
+      return 1;
+    }
+    if (num_systems > sequence.getNumSystems())
+    {
+      std::cout << "Binary sequence contains only " << sequence.getNumSystems() << " systems.\n";
+      num_systems = sequence.getNumSystems();
+    }
+  }
+
   std::cout << "Family mtx file name: " << matrix_pathname
             << ", total number of matrices: " << num_systems << "\n"
             << "Family rhs file name: " << rhs_pathname
@@ -169,47 +200,87 @@ int gluRefactor(int argc, char* argv[])
     std::cout << "System " << i << ":\n";
 
     RESOLVE_RANGE_PUSH("File input");
-    std::ostringstream matname;
-    std::ostringstream rhsname;
-    matname << matrix_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
-    rhsname << rhs_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
-    std::string matrix_pathname_full = matname.str();
-    std::string rhs_pathname_full    = rhsname.str();
-
-    // Read matrix and right-hand-side vector
-    std::ifstream mat_file(matrix_pathname_full);
-    if (!mat_file.is_open())
+    std::string matrix_pathname_full;
+    if (is_binary)
     {
-      std::cout << "Failed to open file " << matrix_pathname_full << "\n";
-      return -1;
+      std::ostringstream sysname;
+      sysname << matrix_pathname << " (system " << i << ")";
+      matrix_pathname_full = sysname.str();
+
+      // Values are copied directly from the mapped file
+      if (i == 0)
+      {
+        A       = sequence.createCsr(i);
+        vec_rhs = sequence.createVector(i);
+      }
+      else
+      {
+        if (sequence.updateMatrix(i, A) != 0)
+        {
+          return 1;
+        }
+        if (sequence.updateVector(i, vec_rhs) != 0)
+        {
+          return 1;
+        }
+      }
+      sequence.prefetch(i + 1);
     }
-    std::ifstream rhs_file(rhs_pathname_full);
-    if (!rhs_file.is_open())
+    else
     {
-      std::cout << "Failed to open file " << rhs_pathname_full << "\n";
-      return -1;
+      std::ostringstream matname;
+      std::ostringstream rhsname;
+      matname << matrix_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
+      rhsname << rhs_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
+      matrix_pathname_full          = matname.str();
+      std::string rhs_pathname_full = rhsname.str();
+
+      // Read matrix and right-hand-side vector
+      std::ifstream mat_file(matrix_pathname_full);
+      if (!mat_file.is_open())
+      {
+        std::cout << "Failed to open file " << matrix_pathname_full << "\n";
+        return -1;
+      }
+      std::ifstream rhs_file(rhs_pathname_full);
+      if (!rhs_file.is_open())
+      {
+        std::cout << "Failed to open file " << rhs_pathname_full << "\n";
+        return -1;
+      }
+
+      // Refactorization is LU-based, so need to expand symmetric matrices
+      bool is_expand_symmetric = true;
+      if (i == 0)
+      {
+        A       = io::createCsrFromFile(mat_file, is_expand_symmetric);
+        vec_rhs = io::createVectorFromFile(rhs_file);
+        value_updater.setup(mat_file, A);
+      }
+      else
+      {
+        if (value_updater.update(mat_file, A) != 0)
+        {
+          return -1;
+        }
+        io::updateVectorFromFile(rhs_file, vec_rhs);
+      }
+
+      mat_file.close();
+      rhs_file.close();
     }
-    bool is_expand_symmetric = true;
+
     if (i == 0)
     {
-      A       = io::createCsrFromFile(mat_file, is_expand_symmetric);
-      vec_rhs = io::createVectorFromFile(rhs_file);
-      vec_x   = new vector_type(A->getNumRows());
+      vec_x = new vector_type(A->getNumRows());
       vec_x->allocate(memory::HOST);
       vec_x->allocate(memory::DEVICE);
     }
-    else
-    {
-      io::updateMatrixFromFile(mat_file, A);
-      io::updateVectorFromFile(rhs_file, vec_rhs);
-    }
-
-    mat_file.close();
-    rhs_file.close();
 
     // Copy data to device
     A->syncData(memory::DEVICE);
     vec_rhs->syncData(memory::DEVICE);
+    helper.setValuesChanged();
     RESOLVE_RANGE_POP("File input");
 
     printSystemInfo(matrix_pathname_full, A);
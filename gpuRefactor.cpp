@@ -17,8 +17,10 @@
  */
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <type_traits>
 
 #include <resolve/GramSchmidt.hpp>
 #include <resolve/LinSolverDirectKLU.hpp>
@@ -40,7 +42,18 @@
 #include <resolve/LinSolverDirectRocSolverRf.hpp>
 #endif
 
+#include "BinarySequence.hpp"
+#include "CorrectionRecycler.hpp"
+#include "CsrValueUpdater.hpp"
+#include "DeviceMemoryMonitor.hpp"
 #include "ExampleHelper.hpp"
+#include "FactorStatistics.hpp"
+#include "GramSchmidtVariants.hpp"
+#include "MatrixMarketReader.hpp"
+#include "PatternFingerprint.hpp"
+#include "RangeTimer.hpp"
+#include "RefactorizationFactors.hpp"
+#include "SystemPrefetcher.hpp"
 
 /// Prints help message describing system usage.
 void printHelpInfo()
@@ -53,8 +66,24 @@ void printHelpInfo()
   std::cout << "Usage:\n\t./";
   std::cout << "gpuRefactor.exe -m <matrix pathname> -r <rhs pathname> -n <number of systems>\n\n";
   std::cout << "Optional features:\n";
+  std::cout << "\t-d\tCopies values of refactorized systems directly to the device, leaving\n";
+  std::cout << "\t\thost copies stale until KLU needs them (binary input only).\n";
+  std::cout << "\t-e <ext> \tSelects custom extension for input files (default 'mtx').\n";
+  std::cout << "\t-f <mtx|bin> \tSelects input format (default 'mtx'). With 'bin', -m is a binary\n";
+  std::cout << "\t\t\tsequence file created by mtxToBin.exe and -r is not used.\n";
+  std::cout << "\t-g <variant> \tSelects Gram-Schmidt variant for iterative refinement: cgs2\n";
+  std::cout << "\t\t\t(default), mgs, mgs_two_sync, mgs_pm or cgs1.\n";
   std::cout << "\t-h\tPrints this message.\n";
-  std::cout << "\t-i\tEnables iterative refinement.\n\n";
+  std::cout << "\t-i\tEnables iterative refinement.\n";
+  std::cout << "\t-k <num> \tWarm starts iterative refinement from corrections of the last\n";
+  std::cout << "\t\t\t<num> systems (default 0, implies -i).\n";
+  std::cout << "\t-M\tReports device memory usage after each solver phase.\n";
+  std::cout << "\t-o <ordering> \tSelects KLU fill-reducing ordering: amd or colamd. KLU default is\n";
+  std::cout << "\t\t\tused if not given.\n";
+  std::cout << "\t-p\tReads the next system in the background while the current one is solved\n";
+  std::cout << "\t\t(Matrix Market input only).\n";
+  std::cout << "\t-s <mode> \tSelects rocsolverRf triangular solve (HIP only): 0 for rocsolver\n";
+  std::cout << "\t\t\t(default), 1 for rocsparse solves analyzed once in setup.\n\n";
 }
 
 /// Prototype of the example function
@@ -104,8 +133,16 @@ int gpuRefactor(int argc, char* argv[])
 
   bool is_iterative_refinement = options.hasKey("-i");
 
+  index_type num_recycled = 0;
+  auto       opt          = options.getParamFromKey("-k");
+  if (opt)
+  {
+    num_recycled            = atoi((opt->second).c_str());
+    is_iterative_refinement = is_iterative_refinement || (num_recycled > 0);
+  }
+
   index_type num_systems = 0;
-  auto       opt         = options.getParamFromKey("-n");
+  opt                    = options.getParamFromKey("-n");
   if (opt)
   {
     num_systems = atoi((opt->second).c_str());
@@ -130,19 +167,56 @@ int gpuRefactor(int argc, char* argv[])
     return 1;
   }
 
+  std::string file_format("mtx");
+  opt = options.getParamFromKey("-f");
+  if (opt)
+  {
+    file_format = opt->second;
+  }
+  bool is_binary = (file_format == "bin");
+
+  bool is_prefetch = options.hasKey("-p") && !is_binary;
+
+  bool is_memory_monitor = options.hasKey("-M");
+
+  bool is_device_resident = options.hasKey("-d") && is_binary;
+
   std::string rhs_pathname("");
   opt = options.getParamFromKey("-r");
   if (opt)
   {
     rhs_pathname = opt->second;
   }
-  else
+  else if (!is_binary)
   {
     std::cout << "Incorrect input!\n\n";
     printHelpInfo();
     return 1;
   }
 
+  GramSchmidt::GSVariant gs_variant = GramSchmidt::CGS2;
+  opt                               = options.getParamFromKey("-g");
+  if (opt && getGramSchmidtVariant(opt->second, gs_variant) != 0)
+  {
+    printHelpInfo();
+    return 1;
+  }
+
+  int ordering = -1; // KLU default ordering unless -o is given
+  opt          = options.getParamFromKey("-o");
+  if (opt && getOrdering(opt->second, ordering) != 0)
+  {
+    printHelpInfo();
+    return 1;
+  }
+
+  int rf_solve_mode = 0;
+  opt               = options.getParamFromKey("-s");
+  if (opt)
+  {
+    rf_solve_mode = atoi((opt->second).c_str());
+  }
+
   std::string file_extension("");
   opt = options.getParamFromKey("-e");
   if (opt)
@@ -154,6 +228,30 @@ int gpuRefactor(int argc, char* argv[])
     file_extension = "mtx";
   }
 
+  // Background reader for the next system in the series
+  SystemPrefetcher prefetcher(matrix_pathname, rhs_pathname, file_extension);
+
+  // Cached positions of matrix file entries for value updates
+  CsrValueUpdater value_updater;
+
+  // Multithreaded reader of the first system, stream reader is the fallback
+  MatrixMarketReader mm_reader;
+
+  // Map binary sequence file, if one is used
+  BinarySequenceReader sequence;
+  if (is_binary)
+  {
+    if (sequence.open(matrix_pathname) != 0)
+    {
+      return 1;
+    }
+    if (num_systems > sequence.getNumSystems())
+    {
+      std::cout << "Binary sequence contains only " << sequence.getNumSystems() << " systems.\n";
+      num_systems = sequence.getNumSystems();
+    }
+  }
+
   std::cout << "Family mtx file name: " << matrix_pathname
             << ", total number of matrices: " << num_systems << "\n"
             << "Family rhs file name: " << rhs_pathname
@@ -172,75 +270,202 @@ int gpuRefactor(int argc, char* argv[])
   VectorHandler vector_handler(&workspace);
 
   // Direct solvers instantiation
-  LinSolverDirectKLU KLU;
-  refactor_type      Rf(&workspace);
+  LinSolverDirectKLU             KLU;
+  std::unique_ptr<refactor_type> Rf = std::make_unique<refactor_type>(&workspace);
+  if (ordering >= 0)
+  {
+    KLU.setOrdering(ordering);
+  }
+#ifdef RESOLVE_USE_HIP
+  if constexpr (std::is_same<refactor_type, LinSolverDirectRocSolverRf>::value)
+  {
+    // Solve mode selects triangular solve analysis done in Rf->setup()
+    if (Rf->setSolveMode(rf_solve_mode) != 0)
+    {
+      std::cout << "Invalid rocsolverRf solve mode " << rf_solve_mode << ".\n";
+      return 1;
+    }
+  }
+  else
+#endif
+  if (rf_solve_mode != 0)
+  {
+    std::cout << "Refactorization solver has a single triangular solve, option -s ignored.\n";
+  }
+
+  // A solver that has been set up is renewed before the next setup
+  bool is_rf_used           = false;
+  auto resetRefactorization = [&]()
+  {
+    if (!is_rf_used)
+    {
+      return;
+    }
+    renewRefactorizationSolver(Rf, &workspace);
+#ifdef RESOLVE_USE_HIP
+    if constexpr (std::is_same<refactor_type, LinSolverDirectRocSolverRf>::value)
+    {
+      Rf->setSolveMode(rf_solve_mode);
+    }
+#endif
+  };
 
   // Iterative solver instantiation
-  GramSchmidt              GS(&vector_handler, GramSchmidt::CGS2);
+  GramSchmidt              GS(&vector_handler, gs_variant);
   LinSolverIterativeFGMRES FGMRES(&matrix_handler, &vector_handler, &GS);
 
+  // Corrections of previous systems used to warm start iterative refinement
+  CorrectionRecycler recycler(&matrix_handler, &vector_handler, num_recycled, memory::DEVICE);
+
   // Pointers to matrix and vectors defining the linear system
   matrix::Csr* A       = nullptr;
   vector_type* vec_rhs = nullptr;
   vector_type* vec_x   = nullptr;
 
+  // Device memory usage, sampled after solver phases
+  DeviceMemoryMonitor memory_monitor;
+
+  // Sparsity pattern of the previous system and solver setup state
+  PatternFingerprint fingerprint;
+  bool               is_rf_setup     = false;
+  bool               is_fgmres_setup = false;
+  bool               is_stats_due    = false; ///< factor statistics not yet printed for this pattern
+
   RESOLVE_RANGE_PUSH(__FUNCTION__);
   for (int i = 0; i < num_systems; ++i)
   {
     std::cout << "System " << i << ":\n";
 
     RESOLVE_RANGE_PUSH("File input");
-    std::ostringstream matname;
-    std::ostringstream rhsname;
-    matname << matrix_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
-    rhsname << rhs_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
-    std::string matrix_pathname_full = matname.str();
-    std::string rhs_pathname_full    = rhsname.str();
-
-    // Read matrix and right-hand-side vector
-    std::ifstream mat_file(matrix_pathname_full);
-    if (!mat_file.is_open())
+    std::string matrix_pathname_full;
+    if (is_binary)
+    {
+      std::ostringstream sysname;
+      sysname << matrix_pathname << " (system " << i << ")";
+      matrix_pathname_full = sysname.str();
+
+      // Values are copied directly from the mapped file
+      if (i == 0)
+      {
+        A       = sequence.createCsr(i);
+        vec_rhs = sequence.createVector(i);
+      }
+      else
+      {
+        // Refactorization runs on the device only, so host copies of the
+        // values are needed only if KLU has to factorize again
+        memory::MemorySpace memspace = (is_device_resident && is_rf_setup) ? memory::DEVICE : memory::HOST;
+        if (sequence.updateMatrix(i, A, memspace) != 0)
+        {
+          return -1;
+        }
+        if (sequence.updateVector(i, vec_rhs, memspace) != 0)
+        {
+          return -1;
+        }
+      }
+      sequence.prefetch(i + 1);
+    }
+    else if (is_prefetch && (i > 0))
     {
-      std::cout << "Failed to open file " << matrix_pathname_full << "\n";
-      return -1;
+      // System i was read in the background while system i-1 was solved
+      matrix_pathname_full = prefetcher.getMatrixFileName(i);
+      int update_status = prefetcher.update(i, A, vec_rhs);
+      if (update_status != 0 && update_status != CsrValueUpdater::PATTERN_CHANGED)
+      {
+        return -1;
+      }
     }
-    std::ifstream rhs_file(rhs_pathname_full);
-    if (!rhs_file.is_open())
+    else
     {
-      std::cout << "Failed to open file " << rhs_pathname_full << "\n";
-      return -1;
+      std::ostringstream matname;
+      std::ostringstream rhsname;
+      matname << matrix_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
+      rhsname << rhs_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
+      matrix_pathname_full          = matname.str();
+      std::string rhs_pathname_full = rhsname.str();
+
+      // Read matrix and right-hand-side vector
+      std::ifstream mat_file(matrix_pathname_full);
+      if (!mat_file.is_open())
+      {
+        std::cout << "Failed to open file " << matrix_pathname_full << "\n";
+        return -1;
+      }
+      std::ifstream rhs_file(rhs_pathname_full);
+      if (!rhs_file.is_open())
+      {
+        std::cout << "Failed to open file " << rhs_pathname_full << "\n";
+        return -1;
+      }
+      bool is_expand_symmetric = true;
+      if (i == 0)
+      {
+        A = mm_reader.createCsr(matrix_pathname_full, is_expand_symmetric);
+        if (A == nullptr)
+        {
+          A = io::createCsrFromFile(mat_file, is_expand_symmetric);
+        }
+        vec_rhs = mm_reader.createVector(rhs_pathname_full);
+        if (vec_rhs == nullptr)
+        {
+          vec_rhs = io::createVectorFromFile(rhs_file);
+        }
+        value_updater.setup(mat_file, A);
+      }
+      else
+      {
+        // Pattern changes are detected by the fingerprint below
+        int update_status = value_updater.update(mat_file, A);
+        if (update_status != 0 && update_status != CsrValueUpdater::PATTERN_CHANGED)
+        {
+          return -1;
+        }
+        io::updateVectorFromFile(rhs_file, vec_rhs);
+      }
+
+      mat_file.close();
+      rhs_file.close();
     }
-    bool is_expand_symmetric = true;
+
+    // Start reading the next system while this one is being solved
+    if (is_prefetch && (i + 1 < num_systems))
+    {
+      prefetcher.prefetch(i + 1);
+    }
+
     if (i == 0)
     {
-      A       = io::createCsrFromFile(mat_file, is_expand_symmetric);
-      vec_rhs = io::createVectorFromFile(rhs_file);
-      vec_x   = new vector_type(A->getNumRows());
+      vec_x = new vector_type(A->getNumRows());
       vec_x->allocate(memory::HOST);
       vec_x->allocate(memory::DEVICE);
     }
-    else
-    {
-      io::updateMatrixFromFile(mat_file, A);
-      io::updateVectorFromFile(rhs_file, vec_rhs);
-    }
-
-    mat_file.close();
-    rhs_file.close();
 
     // Copy data to device
     A->syncData(memory::DEVICE);
     vec_rhs->syncData(memory::DEVICE);
+    helper.setValuesChanged();
     RESOLVE_RANGE_POP("File input");
+    if (is_memory_monitor)
+    {
+      memory_monitor.sample("File input");
+    }
 
     printSystemInfo(matrix_pathname_full, A);
     std::cout << "CSR matrix loaded. Expanded NNZ: " << A->getNnz() << std::endl;
 
     int status = 0;
 
-    if (i == 0)
+    // Symbolic analysis is needed only when the sparsity pattern changes
+    bool is_new_pattern = fingerprint.update(A);
+    if (is_new_pattern)
     {
-      RESOLVE_RANGE_PUSH("KLU");
+      if (i > 0)
+      {
+        std::cout << "Sparsity pattern changed, redoing symbolic analysis.\n";
+      }
+      recycler.reset();
+      RESOLVE_RANGE_PUSH("KLU analysis");
       // Setup factorization solver
       KLU.setup(A);
       matrix_handler.setValuesChanged(true, memory::DEVICE);
@@ -248,13 +473,27 @@ int gpuRefactor(int argc, char* argv[])
       // Analysis (symbolic factorization)
       status = KLU.analyze();
       std::cout << "KLU analysis status: " << status << std::endl;
+      RESOLVE_RANGE_POP("KLU analysis");
+
+      is_rf_setup  = false;
+      is_stats_due = true;
     }
 
-    if (i < 2)
+    if (!is_rf_setup)
     {
+      RESOLVE_RANGE_PUSH("KLU");
       // Numeric factorization
       status = KLU.factorize();
       std::cout << "KLU factorization status: " << status << std::endl;
+      if (status != 0 && !is_new_pattern)
+      {
+        // Symbolic analysis is no longer adequate, redo it
+        KLU.setup(A);
+        status = KLU.analyze();
+        std::cout << "KLU analysis status: " << status << std::endl;
+        status = KLU.factorize();
+        std::cout << "KLU factorization status: " << status << std::endl;
+      }
 
       // Triangular solve
       status = KLU.solve(vec_rhs, vec_x);
@@ -264,27 +503,45 @@ int gpuRefactor(int argc, char* argv[])
       helper.resetSystem(A, vec_rhs, vec_x);
       helper.printShortSummary();
 
-      if (i == 1)
+      // Refactorization is set up on the second system with the same pattern
+      if (!is_new_pattern)
       {
         // Extract factors and configure refactorization solver
         matrix::Csc* L = (matrix::Csc*) KLU.getLFactor();
         matrix::Csc* U = (matrix::Csc*) KLU.getUFactor();
         if (L == nullptr || U == nullptr)
         {
+          // Next system is factorized with KLU again
           std::cout << "Factor extraction from KLU failed!\n";
         }
-        index_type* P = KLU.getPOrdering();
-        index_type* Q = KLU.getQOrdering();
-
-        Rf.setup(A, L, U, P, Q, vec_rhs);
-
-        // Setup iterative refinement solver
-        if (is_iterative_refinement)
+        else
         {
-          FGMRES.setup(A);
+          index_type* P = KLU.getPOrdering();
+          index_type* Q = KLU.getQOrdering();
+          if (is_stats_due)
+          {
+            printFactorStatistics(computeFactorStatistics(A, L, U));
+            is_stats_due = false;
+          }
+
+          resetRefactorization();
+          Rf->setup(A, L, U, P, Q, vec_rhs);
+          is_rf_used  = true;
+          is_rf_setup = true;
+
+          // Setup iterative refinement solver
+          if (is_iterative_refinement && !is_fgmres_setup)
+          {
+            FGMRES.setup(A);
+            is_fgmres_setup = true;
+          }
         }
       }
       RESOLVE_RANGE_POP("KLU");
+      if (is_memory_monitor)
+      {
+        memory_monitor.sample("KLU");
+      }
     }
     else
     {
@@ -292,11 +549,32 @@ int gpuRefactor(int argc, char* argv[])
 
       RESOLVE_RANGE_PUSH("Refactorization");
       // Refactorize on the device
-      status = Rf.refactorize();
+      status = Rf->refactorize();
+      if (status != 0)
+      {
+        // Pattern is unchanged, so redo only the numeric factorization
+        std::cout << "Refactorization failed, redoing KLU numeric factorization.\n";
+        A->syncData(memory::HOST);
+        vec_rhs->syncData(memory::HOST);
+        status = KLU.factorize();
+        std::cout << "KLU factorization status: " << status << std::endl;
+        resetRefactorization();
+        Rf->setup(A,
+                  (matrix::Csc*) KLU.getLFactor(),
+                  (matrix::Csc*) KLU.getUFactor(),
+                  KLU.getPOrdering(),
+                  KLU.getQOrdering(),
+                  vec_rhs);
+        status = Rf->refactorize();
+      }
 
       // Triangular solve on the device
-      status = Rf.solve(vec_rhs, vec_x);
+      status = Rf->solve(vec_rhs, vec_x);
       RESOLVE_RANGE_POP("Refactorization");
+      if (is_memory_monitor)
+      {
+        memory_monitor.sample("Refactorization");
+      }
 
       // Print summary of the results
       helper.resetSystem(A, vec_rhs, vec_x);
@@ -307,23 +585,40 @@ int gpuRefactor(int argc, char* argv[])
       {
         // Setup iterative refinement
         FGMRES.resetMatrix(A);
-        FGMRES.setupPreconditioner("LU", &Rf);
+        FGMRES.setupPreconditioner("LU", Rf.get());
 
         // If refactorization produced finite solution do iterative refinement
         if (std::isfinite(helper.getNormRelativeResidual()))
         {
+          if (num_recycled > 0)
+          {
+            recycler.warmStart(A, vec_rhs, vec_x);
+          }
           FGMRES.solve(vec_rhs, vec_x);
+          if (num_recycled > 0)
+          {
+            recycler.record(vec_x);
+          }
 
           // Print summary
           helper.printIrSummary(&FGMRES);
         }
       }
       RESOLVE_RANGE_POP("Iterative refinement");
+      if (is_memory_monitor)
+      {
+        memory_monitor.sample("Iterative refinement");
+      }
     }
 
   } // for (int i = 0; i < num_systems; ++i)
   RESOLVE_RANGE_POP(__FUNCTION__);
 
+  if (is_memory_monitor)
+  {
+    memory_monitor.printSummary();
+  }
+
   delete A;
   delete vec_x;
   delete vec_rhs;
@@ -0,0 +1,215 @@
+/**
+ * @file gsBenchmark.cpp
+ *
+ * @brief Benchmark of Gram-Schmidt variants used in FGMRES.
+ *
+ * A Krylov basis of random vectors is orthogonalized with each selected
+ * Gram-Schmidt variant for a range of restart lengths. Reported are the
+ * time of one orthogonalization step (minimum over repetitions), its ratio
+ * to CGS2 and the loss of orthogonality of the last basis vector.
+ */
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "ExampleHelper.hpp"
+#include "GramSchmidtVariants.hpp"
+#include <resolve/GramSchmidt.hpp>
+#include <resolve/utilities/params/CliOptions.hpp>
+#include <resolve/vector/VectorHandler.hpp>
+#include <resolve/workspace/LinAlgWorkspace.hpp>
+
+/// Prints help message describing system usage.
+void printHelpInfo()
+{
+  std::cout << "\ngsBenchmark.exe times Gram-Schmidt variants on random Krylov bases.\n\n";
+  std::cout << "Usage:\n\t./";
+  std::cout << "gsBenchmark.exe [-b <cpu|cuda|hip>] [-n <vector size>]\n\n";
+  std::cout << "Optional features:\n";
+  std::cout << "\t-b <cpu|cuda|hip> \tSelects hardware backend.\n";
+  std::cout << "\t-g <list> \tComma-separated Gram-Schmidt variants (default: cgs2,mgs,\n";
+  std::cout << "\t\t\tmgs_two_sync,mgs_pm,cgs1).\n";
+  std::cout << "\t-h\tPrints this message.\n";
+  std::cout << "\t-n <size> \tVector size (default 10000).\n";
+  std::cout << "\t-r <list> \tComma-separated restart lengths (default 50,100,200,500,1000).\n";
+  std::cout << "\t-R <num> \tNumber of repetitions (default 3).\n\n";
+}
+
+/// Split comma-separated list `text`.
+static std::vector<std::string> splitList(const std::string& text)
+{
+  std::vector<std::string> items;
+  std::istringstream       stream(text);
+  std::string              item;
+  while (std::getline(stream, item, ','))
+  {
+    if (!item.empty())
+    {
+      items.push_back(item);
+    }
+  }
+  return items;
+}
+
+/// Prototype of the benchmark function
+template <class workspace_type>
+static int gsBenchmark(int argc, char* argv[]);
+
+/// Main function selects backend to be benchmarked.
+int main(int argc, char* argv[])
+{
+  ReSolve::CliOptions options(argc, argv);
+
+  bool is_help = options.hasKey("-h");
+  if (is_help)
+  {
+    printHelpInfo();
+    return 0;
+  }
+
+  // Select hardware backend, default to CPU if no -b option is passed
+  auto opt = options.getParamFromKey("-b");
+  if (!opt)
+  {
+    std::cout << "No backend option provided. Defaulting to CPU.\n";
+    return gsBenchmark<ReSolve::LinAlgWorkspaceCpu>(argc, argv);
+  }
+#ifdef RESOLVE_USE_CUDA
+  else if (opt->second == "cuda")
+  {
+    return gsBenchmark<ReSolve::LinAlgWorkspaceCUDA>(argc, argv);
+  }
+#endif
+#ifdef RESOLVE_USE_HIP
+  else if (opt->second == "hip")
+  {
+    return gsBenchmark<ReSolve::LinAlgWorkspaceHIP>(argc, argv);
+  }
+#endif
+  else if (opt->second == "cpu")
+  {
+    return gsBenchmark<ReSolve::LinAlgWorkspaceCpu>(argc, argv);
+  }
+
+  std::cout << "Re::Solve is not built with support for " << opt->second;
+  std::cout << "backend.\n";
+  return 1;
+}
+
+/**
+ * @brief Time Gram-Schmidt variants for a range of restart lengths.
+ *
+ * @tparam workspace_type - Type of the workspace to use
+ * @param[in] argc - Number of command line arguments
+ * @param[in] argv - Command line arguments
+ * @return 0 if the benchmark ran successfully, 1 otherwise
+ */
+template <class workspace_type>
+int gsBenchmark(int argc, char* argv[])
+{
+  using namespace ReSolve::examples;
+  using namespace ReSolve;
+  using index_type = ReSolve::index_type;
+
+  CliOptions options(argc, argv);
+
+  index_type n   = 10000;
+  auto       opt = options.getParamFromKey("-n");
+  if (opt)
+  {
+    n = atoi((opt->second).c_str());
+  }
+
+  std::vector<std::string> variant_names = getGramSchmidtVariantNames();
+  opt                                    = options.getParamFromKey("-g");
+  if (opt)
+  {
+    variant_names = splitList(opt->second);
+  }
+  std::vector<GramSchmidt::GSVariant> variants(variant_names.size());
+  for (size_t k = 0; k < variant_names.size(); ++k)
+  {
+    if (getGramSchmidtVariant(variant_names[k], variants[k]) != 0)
+    {
+      printHelpInfo();
+      return 1;
+    }
+  }
+
+  std::vector<index_type> restarts = {50, 100, 200, 500, 1000};
+  opt                              = options.getParamFromKey("-r");
+  if (opt)
+  {
+    restarts.clear();
+    for (const std::string& item : splitList(opt->second))
+    {
+      restarts.push_back(atoi(item.c_str()));
+    }
+  }
+
+  int num_repetitions = 3;
+  opt                 = options.getParamFromKey("-R");
+  if (opt)
+  {
+    num_repetitions = std::max(1, atoi((opt->second).c_str()));
+  }
+
+  if (n <= 0 || variants.empty() || restarts.empty()
+      || *std::min_element(restarts.begin(), restarts.end()) <= 0)
+  {
+    std::cout << "Incorrect input!\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  workspace_type workspace;
+  workspace.initializeHandles();
+
+  ExampleHelper<workspace_type> helper(workspace);
+  std::string                   hw_backend = helper.getHardwareBackend();
+  memory::MemorySpace           memspace   = (hw_backend == "CPU") ? memory::HOST : memory::DEVICE;
+
+  VectorHandler vector_handler(&workspace);
+
+  std::cout << "gsBenchmark with " << hw_backend << " backend, vector size " << n
+            << ", " << num_repetitions << " repetitions\n\n";
+  std::cout << std::setw(8) << "restart" << std::setw(16) << "variant"
+            << std::setw(16) << "step [s]" << std::setw(12) << "vs. cgs2"
+            << std::setw(16) << "orth. loss" << "\n";
+
+  for (index_type restart : restarts)
+  {
+    double cgs2_time = 0.0;
+    for (size_t k = 0; k < variants.size(); ++k)
+    {
+      // Minimum over repetitions, the first one also warms up the device
+      OrthogonalizationResult best = timeOrthogonalization(&vector_handler, variants[k], n, restart, memspace);
+      for (int rep = 1; rep < num_repetitions; ++rep)
+      {
+        OrthogonalizationResult result = timeOrthogonalization(&vector_handler, variants[k], n, restart, memspace);
+        best.time_per_step             = std::min(best.time_per_step, result.time_per_step);
+      }
+      if (variants[k] == GramSchmidt::CGS2)
+      {
+        cgs2_time = best.time_per_step;
+      }
+
+      std::cout << std::setw(8) << restart << std::setw(16) << variant_names[k]
+                << std::scientific << std::setprecision(4) << std::setw(16) << best.time_per_step;
+      if (cgs2_time > 0.0)
+      {
+        std::cout << std::fixed << std::setprecision(2) << std::setw(12) << best.time_per_step / cgs2_time;
+      }
+      else
+      {
+        std::cout << std::setw(12) << "-";
+      }
+      std::cout << std::scientific << std::setprecision(2) << std::setw(16) << best.orthogonality_loss << "\n";
+    }
+  }
+
+  return 0;
+}
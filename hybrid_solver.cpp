@@ -23,7 +23,14 @@
 #include <resolve/workspace/LinAlgWorkspace.hpp> // LinAlgWorkspaceCUDA as per your system setup
 
 // New include for ExampleHelper utility class
+#include "Benchmark.hpp"
+#include "CorrectionRecycler.hpp"
 #include "ExampleHelper.hpp"
+#include "MatrixMarketReader.hpp"
+#include "PatternFingerprint.hpp"
+#include "PinnedMemory.hpp"
+#include "RefactorizationFactors.hpp"
+#include "RefactorizationPolicy.hpp"
 
 // Using namespace for convenience
 using namespace ReSolve::constants;
@@ -99,7 +106,6 @@ int main(int argc, char* argv[])
     ReSolve::VectorHandler* vector_handler = nullptr;       // Handler for vector operations
 
     real_type* rhs_host_array = nullptr; // Host-side C-array for RHS data from file
-    real_type* x_host_array   = nullptr;  // Host-side C-array for solution data
 
     vector_type* vec_rhs = nullptr; // Device vector for RHS
     vector_type* vec_x   = nullptr;   // Device vector for solution
@@ -117,6 +123,10 @@ int main(int argc, char* argv[])
     // Iterative solver
     ReSolve::LinSolverIterativeFGMRES* FGMRES = nullptr;
 
+    // Corrections of previous systems used to warm start FGMRES (0 disables)
+    const index_type num_recycled_corrections = 4;
+    ReSolve::examples::CorrectionRecycler* recycler = nullptr;
+
     // ExampleHelper for clean residual calculations and reporting
     ReSolve::examples::ExampleHelper<ReSolve::LinAlgWorkspaceCUDA>* helper = nullptr;
 
@@ -129,6 +139,33 @@ int main(int argc, char* argv[])
     int status        = 0;
     int status_refactor = 0; // For CuSolverRf refactorization status
 
+    // Fingerprint of the sparsity pattern of the previous system
+    ReSolve::examples::PatternFingerprint fingerprint;
+    bool is_new_pattern = true;
+
+    // Decides when refactorization results justify a new host factorization
+    ReSolve::examples::RefactorizationPolicy policy;
+    bool   is_factorization_requested = false;
+    double refinement_time            = 0.0;
+    ReSolve::examples::PhaseTimer factorization_timer;
+    ReSolve::examples::PhaseTimer refinement_timer;
+
+    // Pivot sequence and factor pattern of the current CuSolverRf setup
+    ReSolve::examples::RefactorizationFactors factors;
+
+    // Next system, read and copied to the device while the current one is solved
+    ReSolve::matrix::Csr* A_next = nullptr;
+    real_type* rhs_next = nullptr;
+    ReSolve::examples::StagedSystemCopy* staged = nullptr;
+
+    // Host data of the next system is page-locked for the asynchronous copies
+    ReSolve::examples::HostMemoryPinner pinner;
+    void* pinned_values = nullptr;
+    void* pinned_rhs    = nullptr;
+
+    // Multithreaded reader of the first system, stream reader is the fallback
+    ReSolve::examples::MatrixMarketReader mm_reader;
+
     // --- Initialize all core ReSolve objects in a try-catch block ---
     try {
         workspace_CUDA = new ReSolve::LinAlgWorkspaceCUDA;
@@ -143,6 +180,9 @@ int main(int argc, char* argv[])
         Rf  = new ReSolve::LinSolverDirectCuSolverRf();
 
         FGMRES = new ReSolve::LinSolverIterativeFGMRES(matrix_handler, vector_handler, GS);
+        recycler = new ReSolve::examples::CorrectionRecycler(matrix_handler, vector_handler,
+                                                             num_recycled_corrections,
+                                                             ReSolve::memory::DEVICE);
 
         // Initialize the ExampleHelper, passing the workspace
         helper = new ReSolve::examples::ExampleHelper<ReSolve::LinAlgWorkspaceCUDA>(*workspace_CUDA);
@@ -176,64 +216,125 @@ int main(int argc, char* argv[])
         std::cout << "Reading: " << matrixFileNameFull << std::endl;
         std::cout << "========================================================================================================================" << std::endl << std::endl;
 
-        std::ifstream mat_file(matrixFileNameFull);
-        if (!mat_file.is_open()) {
-            std::cerr << "Failed to open matrix file: " << matrixFileNameFull << "\n";
-            goto cleanup;
-        }
-        std::ifstream rhs_file(rhsFileNameFull);
-        if (!rhs_file.is_open()) {
-            std::cerr << "Failed to open RHS file: " << rhsFileNameFull << "\n";
-            mat_file.close();
-            goto cleanup;
-        }
-
         bool is_expand_symmetric = true;
 
-        if (i == 0) // First system: create and allocate all necessary objects
+        if (staged != nullptr && staged->isStaged())
         {
-            A = ReSolve::io::createCsrFromFile(mat_file, is_expand_symmetric);
-            rhs_host_array = ReSolve::io::createArrayFromFile(rhs_file);
-            x_host_array = new real_type[A->getNumRows()];
-
-            vec_rhs = new vector_type(A->getNumRows());
-            vec_x   = new vector_type(A->getNumRows());
-	    vec_residual = new vector_type(A->getNumRows());
-	    vec_error = new vector_type(A->getNumRows());
-
-            vec_x->allocate(ReSolve::memory::HOST);
-            vec_x->allocate(ReSolve::memory::DEVICE);
-            vec_x->setToZero(ReSolve::memory::HOST);
-            vec_x->setToZero(ReSolve::memory::DEVICE);
-
-	    vec_error->allocate(ReSolve::memory::HOST);
-	    vec_error->allocate(ReSolve::memory::DEVICE);
-	    vec_error->setToZero(ReSolve::memory::HOST);
-	    vec_error->setToZero(ReSolve::memory::DEVICE);
+            // System i was read and copied to the device while system i-1 was solved;
+            // host values are kept current for KLU
+            A->copyValues(A_next->getValues(ReSolve::memory::HOST), ReSolve::memory::HOST, ReSolve::memory::HOST);
+            if (staged->commit(A, vec_rhs) != 0) {
+                std::cerr << "Failed to copy system " << i << " to the device.\n";
+                goto cleanup;
+            }
+            is_new_pattern = false;
+            helper->setValuesChanged();
+            std::cout << "System " << i << " was copied to the device while system " << i - 1 << " was solved." << std::endl;
         }
-        else // Subsequent systems: update existing structures
+        else
         {
-            ReSolve::io::updateMatrixFromFile(mat_file, A);
-            ReSolve::io::updateArrayFromFile(rhs_file, &rhs_host_array);
-        }
+            std::ifstream mat_file(matrixFileNameFull);
+            if (!mat_file.is_open()) {
+                std::cerr << "Failed to open matrix file: " << matrixFileNameFull << "\n";
+                goto cleanup;
+            }
+            std::ifstream rhs_file(rhsFileNameFull);
+            if (!rhs_file.is_open()) {
+                std::cerr << "Failed to open RHS file: " << rhsFileNameFull << "\n";
+                mat_file.close();
+                goto cleanup;
+            }
+
+            if (i == 0) // First system: create and allocate all necessary objects
+            {
+                A = mm_reader.createCsr(matrixFileNameFull, is_expand_symmetric);
+                if (A == nullptr) {
+                    A = ReSolve::io::createCsrFromFile(mat_file, is_expand_symmetric);
+                }
+                rhs_host_array = mm_reader.createArray(rhsFileNameFull);
+                if (rhs_host_array == nullptr) {
+                    rhs_host_array = ReSolve::io::createArrayFromFile(rhs_file);
+                }
+
+                vec_rhs = new vector_type(A->getNumRows());
+                vec_x   = new vector_type(A->getNumRows());
+                vec_residual = new vector_type(A->getNumRows());
+                vec_error = new vector_type(A->getNumRows());
+
+                vec_x->allocate(ReSolve::memory::HOST);
+                vec_x->allocate(ReSolve::memory::DEVICE);
+                vec_x->setToZero(ReSolve::memory::HOST);
+                vec_x->setToZero(ReSolve::memory::DEVICE);
+
+                // The error is computed and applied on the device only, so it has no host copy
+                vec_error->allocate(ReSolve::memory::DEVICE);
+                vec_error->setToZero(ReSolve::memory::DEVICE);
+            }
+            else // Subsequent systems: update existing structures
+            {
+                ReSolve::io::updateMatrixFromFile(mat_file, A);
+                ReSolve::io::updateArrayFromFile(rhs_file, &rhs_host_array);
+            }
+
+            // The matrix `A` is now a valid pointer.
+            // We can now safely print its info.
+            std::cout << "Finished reading the matrix and rhs, size: " << A->getNumRows() << " x " << A->getNumColumns()
+                      << ", nnz: " << A->getNnz()
+                      << ", symmetric? " << A->symmetric()
+                      << ", Expanded? " << A->expanded() << std::endl;
+            std::cout << "Reading RHS:    [" << rhsFileNameFull << "]" << std::endl;
+            mat_file.close();
+            rhs_file.close();
+
+            // Symbolic analysis is redone only when the sparsity pattern changes
+            is_new_pattern = fingerprint.update(A);
+            helper->setValuesChanged();
+            if (is_new_pattern) {
+                recycler->reset(); // Corrections of a different pattern are not useful
+                if (i > 0) {
+                    std::cout << "Sparsity pattern changed; symbolic factorization will be redone." << std::endl;
+                }
+
+                // Staging buffers match the number of nonzeros of the current pattern
+                delete staged;
+                staged = new ReSolve::examples::StagedSystemCopy(A->getNumRows(), A->getNnz());
+            }
 
-        // The matrix `A` is now a valid pointer.
-        // We can now safely print its info.
-        std::cout << "Finished reading the matrix and rhs, size: " << A->getNumRows() << " x " << A->getNumColumns()
-                  << ", nnz: " << A->getNnz()
-                  << ", symmetric? " << A->symmetric()
-                  << ", Expanded? " << A->expanded() << std::endl;
-        std::cout << "Reading RHS:    [" << rhsFileNameFull << "]" << std::endl;
-        mat_file.close();
-        rhs_file.close();
-
-        // Update host and device data for RHS vector
-        vec_rhs->copyDataFrom(rhs_host_array, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
-        // Ensure the matrix is also on the device for the GPU-based solvers
-        A->syncData(ReSolve::memory::DEVICE);
+            // System was not staged, copy it to the device before the solvers use it
+            vec_rhs->copyDataFrom(rhs_host_array, ReSolve::memory::HOST, ReSolve::memory::DEVICE);
+            A->syncData(ReSolve::memory::DEVICE);
+        }
 
         std::cout << "CSR matrix loaded. Expanded NNZ: " << A->getNnz() << std::endl;
 
+        // Read system i+1 and issue its copy to the device before system i is solved
+        if (i + 1 < numSystems)
+        {
+            std::string next_matrix_file_name = matrixFileName + argv[4 + (i + 1) * 2] + ".mtx";
+            std::string next_rhs_file_name    = rhsFileName + argv[5 + (i + 1) * 2] + ".mtx";
+            std::ifstream next_mat_file(next_matrix_file_name);
+            std::ifstream next_rhs_file(next_rhs_file_name);
+            // Files that fail to open are reported when system i+1 is read again
+            if (next_mat_file.is_open() && next_rhs_file.is_open()) {
+                if (A_next == nullptr) {
+                    A_next   = ReSolve::io::createCsrFromFile(next_mat_file, is_expand_symmetric);
+                    rhs_next = ReSolve::io::createArrayFromFile(next_rhs_file);
+                } else {
+                    ReSolve::io::updateMatrixFromFile(next_mat_file, A_next);
+                    ReSolve::io::updateArrayFromFile(next_rhs_file, &rhs_next);
+                }
+
+                // Only values are staged; a system with a new pattern is read again in its own step
+                if (A_next->getNnz() == A->getNnz()
+                    && ReSolve::examples::PatternFingerprint::compute(A_next) == fingerprint.getValue()) {
+                    // Reading may have reallocated the host arrays
+                    pinner.repin(pinned_values, A_next->getValues(ReSolve::memory::HOST), A_next->getNnz() * sizeof(real_type));
+                    pinner.repin(pinned_rhs, rhs_next, A->getNumRows() * sizeof(real_type));
+                    staged->stage(A_next->getValues(ReSolve::memory::HOST), rhs_next);
+                }
+            }
+        }
+
         // --- Solver Logic ---
         if (i < 1) // For the first system (i=1), perform full KLU factorization
         {
@@ -243,6 +344,7 @@ int main(int argc, char* argv[])
 
             status = KLU->analyze();
             std::cout << "KLU analysis status: " << status << std::endl;
+            factorization_timer.start();
             status = KLU->factorize();
             std::cout << "KLU factorization status: " << status << std::endl;
             status = KLU->solve(vec_rhs, vec_x);
@@ -266,8 +368,10 @@ int main(int argc, char* argv[])
                 }
 
                 // Setup CuSolverRf with KLU factors directly in CSC format
+                factors.update(L_csc_klu, U_csc_klu, P_klu, Q_klu);
                 Rf->setup(A, L_csc_klu, U_csc_klu, P_klu, Q_klu);
                 Rf->refactorize(); // Initial refactorize for Rf
+                policy.recordFactorization(factorization_timer.stop());
             }
 
 	    FGMRES->setRestart(1000);
@@ -282,7 +386,9 @@ int main(int argc, char* argv[])
 	    std::cout << "DEBUG: Solving error equation with FGMRES." << std::endl;
 
             // Perform FGMRES solve after initial KLU solve
+            recycler->warmStart(A, vec_residual, vec_error);
             FGMRES->solve(vec_residual, vec_error);
+            recycler->record(vec_error);
 	    std::cout << "FGMRES error estimation: " << sqrt(vector_handler->dot(vec_error, vec_error, ReSolve::memory::DEVICE)) << std::endl;
 
             // Print FGMRES summary using the helper function
@@ -298,7 +404,6 @@ int main(int argc, char* argv[])
 	    std::cout << "DEBUG: Relative residual after error update: " << helper->getNormRelativeResidual() << std::endl;
 
 	    // Setting vec_error back to zero for future calculations
-	    vec_error->setToZero(ReSolve::memory::HOST);
 	    vec_error->setToZero(ReSolve::memory::DEVICE);
         }
         else // if (i > 1) -- Use CuSolverRf for refactorization, then FGMRES, with KLU redo logic
@@ -306,30 +411,52 @@ int main(int argc, char* argv[])
             std::cout << "DEBUG: System " << i << ": Using CuSolverRf refactorization and FGMRES." << std::endl;
             matrix_handler->setValuesChanged(true, ReSolve::memory::DEVICE);
 
-            status_refactor = Rf->refactorize(); // Attempt CuSolverRf refactorization
-            std::cout << "CuSolverRf refactorization status: " << status_refactor << std::endl;
+            // CuSolverRf factors are invalid for a new sparsity pattern, and
+            // the policy may have requested host factorization on the last step
+            if (is_new_pattern || is_factorization_requested)
+            {
+                status_refactor = 1;
+            }
+            else
+            {
+                status_refactor = Rf->refactorize(); // Attempt CuSolverRf refactorization
+                std::cout << "CuSolverRf refactorization status: " << status_refactor << std::endl;
+            }
 
-            // --- Hybrid Logic: Redo KLU if CuSolverRf crashed ---
+            // --- Hybrid Logic: Redo KLU if CuSolverRf crashed or the policy requested it ---
             if (status_refactor != 0)
             {
-
-                std::cout << "\n \t !!! ALERT !!! CuSolverRf has crashed; redoing KLU symbolic and numeric factorization. !!! ALERT !!! \n \n";
-
-                // Redo KLU factorization
-                KLU->setup(A);
+                factorization_timer.start();
                 matrix_handler->setValuesChanged(true, ReSolve::memory::DEVICE);
-                status = KLU->analyze();
-                std::cout << "KLU analysis status (redo): " << status << std::endl;
-                status = KLU->factorize();
-                std::cout << "KLU factorization status (redo): " << status << std::endl;
-                status = KLU->solve(vec_rhs, vec_x); // Solve with new KLU factors
-                std::cout << "KLU solve status (redo): " << status << std::endl;
-
-                // Use the helper to print the summary after the KLU redo
-                helper->resetSystem(A, vec_rhs, vec_x);
-                helper->printShortSummary();
-
-                // Re-setup CuSolverRf with the NEW KLU factors
+                status = 1;
+                if (!is_new_pattern)
+                {
+                    // Pattern is unchanged, numeric factorization reuses the symbolic analysis
+                    if (is_factorization_requested)
+                    {
+                        std::cout << "\n \t Refactorization policy: " << policy.getReason()
+                                  << "; redoing KLU numeric factorization.\n \n";
+                    }
+                    else
+                    {
+                        std::cout << "\n \t !!! ALERT !!! CuSolverRf has crashed; redoing KLU numeric factorization. !!! ALERT !!! \n \n";
+                    }
+                    status = KLU->factorize();
+                    std::cout << "KLU factorization status (redo): " << status << std::endl;
+                }
+                if (status != 0)
+                {
+                    std::cout << "\n \t !!! ALERT !!! Redoing KLU symbolic and numeric factorization. !!! ALERT !!! \n \n";
+
+                    // Redo KLU factorization
+                    KLU->setup(A);
+                    status = KLU->analyze();
+                    std::cout << "KLU analysis status (redo): " << status << std::endl;
+                    status = KLU->factorize();
+                    std::cout << "KLU factorization status (redo): " << status << std::endl;
+                }
+                // Re-setup CuSolverRf with the NEW KLU factors; the system is
+                // solved with them below, so no separate KLU solve is needed
                 L_csc_klu = (ReSolve::matrix::Csc*) KLU->getLFactor();
                 U_csc_klu = (ReSolve::matrix::Csc*) KLU->getUFactor();
                 P_klu = KLU->getPOrdering();
@@ -341,31 +468,37 @@ int main(int argc, char* argv[])
                     goto cleanup;
                 }
 
-                Rf->setup(A, L_csc_klu, U_csc_klu, P_klu, Q_klu);
-                Rf->refactorize(); // Re-refactorize CuSolverRf
+                // CuSolverRf needs a new setup only if pivoting or fill changed;
+                // the new solver is handed to FGMRES again
+                if (factors.update(L_csc_klu, U_csc_klu, P_klu, Q_klu)) {
+                    ReSolve::examples::renewRefactorizationSolver(Rf);
+                    Rf->setup(A, L_csc_klu, U_csc_klu, P_klu, Q_klu);
+                    FGMRES->setupPreconditioner("LU", Rf);
+                } else {
+                    std::cout << "Pivot sequence unchanged, reusing CuSolverRf setup." << std::endl;
+                }
+                status_refactor = Rf->refactorize(); // Re-refactorize CuSolverRf
+                policy.recordFactorization(factorization_timer.stop());
             }
 
             status = Rf->solve(vec_rhs, vec_x); // Solve with CuSolverRf
             std::cout << "CuSolverRf solve status: " << status << std::endl;
 
-            // Use the helper to print the summary after the refactorization solve
-            helper->resetSystem(A, vec_rhs, vec_x);
-            helper->printShortSummary();
-
-            // Compute the residual: r = b - Ax
+            // Compute the residual: r = b - Ax, right-hand side of the error equation
             vec_residual->copyDataFrom(vec_rhs, ReSolve::memory::DEVICE, ReSolve::memory::DEVICE);
             matrix_handler->matvec(A, vec_x, vec_residual, &ReSolve::constants::MINUS_ONE, &ReSolve::constants::ONE, ReSolve::memory::DEVICE);
 
             std::cout << "DEBUG: Solving error equation with FGMRES." << std::endl;
 
             FGMRES->resetMatrix(A); // Reset FGMRES with current matrix A
+            refinement_timer.start();
+            // Start from the best combination of recent corrections instead of zero
+            recycler->warmStart(A, vec_residual, vec_error);
             FGMRES->solve(vec_residual, vec_error); // Refine solution with FGMRES
+            recycler->record(vec_error);
+            refinement_time = refinement_timer.stop();
             std::cout << "FGMRES norm of error: " << sqrt(vector_handler->dot(vec_error, vec_error, ReSolve::memory::DEVICE)) << std::endl;
 
-            // Print FGMRES summary using the helper function
-            helper->printIrSummary(FGMRES);
-            std::cout << "FGMRES Effective Stability: " << FGMRES->getEffectiveStability() << std::endl;
-
 	    // Update the solution: x = x + e
             std::cout << "DEBUG: Updating solution vector." << std::endl;
             vector_handler->axpy(&ReSolve::constants::ONE, vec_error, vec_x, ReSolve::memory::DEVICE);
@@ -374,8 +507,20 @@ int main(int argc, char* argv[])
             helper->resetSystem(A, vec_rhs, vec_x);
             std::cout << "DEBUG: Relative residual after error update: " << helper->getNormRelativeResidual() << std::endl;
 
+            // Print FGMRES summary using the helper function (initial norm is the residual before IR)
+            helper->printIrSummary(FGMRES);
+            std::cout << "FGMRES Effective Stability: " << FGMRES->getEffectiveStability() << std::endl;
+
+            // Decide whether the next system should be factorized on the host
+            policy.recordStep(status_refactor,
+                              helper->getNormRelativeResidual(),
+                              FGMRES->getNumIter(),
+                              FGMRES->getEffectiveStability(),
+                              refinement_time);
+            policy.printSummary();
+            is_factorization_requested = policy.isRefactorizationNeeded();
+
 	    // Setting vec_error to zero to get Relative residual norm
-	    vec_error->setToZero(ReSolve::memory::HOST);
             vec_error->setToZero(ReSolve::memory::DEVICE);
 
         }
@@ -384,13 +529,20 @@ int main(int argc, char* argv[])
 cleanup: // Central cleanup label for error handling and end of program
     std::cout << "\n--- Cleaning up ReSolve objects ---" << std::endl;
 
+    // Copies still in flight finish before their page-locked sources are released
+    if (staged) delete staged; staged = nullptr;
+
+    // Release page-locked memory before the host arrays are deleted
+    pinner.unpinAll();
+    if (A_next) delete A_next; A_next = nullptr;
+    if (rhs_next) delete[] rhs_next; rhs_next = nullptr;
+
     // Delete pointers only if they were successfully allocated (not nullptr)
     if (A) delete A; A = nullptr;
     if (KLU) delete KLU; KLU = nullptr;
     if (Rf) delete Rf; Rf = nullptr;
     if (FGMRES) delete FGMRES; FGMRES = nullptr;
     if (GS) delete GS; GS = nullptr;
-    if (x_host_array) delete[] x_host_array; x_host_array = nullptr; // delete[] for C-style array
     if (rhs_host_array) delete[] rhs_host_array; rhs_host_array = nullptr; // delete[] for C-style array
     if (vec_x) delete vec_x; vec_x = nullptr;
     if (vec_rhs) delete vec_rhs; vec_rhs = nullptr;
@@ -398,6 +550,7 @@ cleanup: // Central cleanup label for error handling and end of program
     if (matrix_handler) delete matrix_handler; matrix_handler = nullptr;
     if (workspace_CUDA) delete workspace_CUDA; workspace_CUDA = nullptr;
     if (helper) delete helper; helper = nullptr; // Cleanup the new helper object
+    if (recycler) delete recycler; recycler = nullptr;
 
     std::cout << "Cleanup complete. Program exiting." << std::endl;
     return 0; // Return 0 for success, or non-zero if goto was due to error
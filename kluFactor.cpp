@@ -15,6 +15,7 @@
 #include <iostream>
 #include <sstream>
 
+#include "CsrValueUpdater.hpp"
 #include "ExampleHelper.hpp"
 #include <resolve/GramSchmidt.hpp>
 #include <resolve/LinSolverDirectKLU.hpp>
@@ -128,9 +129,14 @@ int main(int argc, char* argv[])
   vector_type* vec_rhs = nullptr;
   vector_type* vec_x   = nullptr;
 
+  // Cached positions of matrix file entries for value updates
+  CsrValueUpdater value_updater;
+
   LinSolverDirectKLU       KLU;
   GramSchmidt              GS(&vector_handler, GramSchmidt::CGS2);
   LinSolverIterativeFGMRES FGMRES(&matrix_handler, &vector_handler, &GS);
+  bool                     is_fgmres_setup = false;
+
   for (int i = 0; i < num_systems; ++i)
   {
     std::cout << "System " << i << ":\n";
@@ -160,10 +166,14 @@ int main(int argc, char* argv[])
 
       vec_rhs = ReSolve::io::createVectorFromFile(rhs_file);
       vec_x   = new vector_type(A->getNumRows());
+      value_updater.setup(mat_file, A);
     }
     else
     {
-      ReSolve::io::updateMatrixFromFile(mat_file, A);
+      if (value_updater.update(mat_file, A) != 0)
+      {
+        return 1;
+      }
       ReSolve::io::updateVectorFromFile(rhs_file, vec_rhs);
     }
     printSystemInfo(matrix_file_name_full, A);
@@ -191,8 +201,13 @@ int main(int argc, char* argv[])
     helper.printShortSummary();
     if (is_iterative_refinement)
     {
-      // Setup iterative refinement
-      FGMRES.setup(A);
+      // Setup iterative refinement once; later systems only reset the matrix
+      if (!is_fgmres_setup)
+      {
+        FGMRES.setup(A);
+        is_fgmres_setup = true;
+      }
+      FGMRES.resetMatrix(A);
       FGMRES.setupPreconditioner("LU", &KLU);
 
       // If refactorization produced finite solution do iterative refinement
@@ -9,14 +9,28 @@
  * input and solved with KLU solver, using full factorization initially and
  * then using refactorization for subsequent systems. It is assumed that all
  * systems in the series have the same sparsity pattern, so the analysis is
- * done only once for the entire series.
+ * done only once for the entire series. Optionally, the systems are solved
+ * with single precision copies of the KLU factors, which then serve as the
+ * preconditioner for double precision iterative refinement. Refactorization
+ * can also be done by multiple threads on the host, with a selectable
+ * triangular solve algorithm. Orderings and factor patterns can be cached
+ * on disk, so that later runs for the same sparsity pattern skip the KLU
+ * analysis and start with a refactorization.
  *
  */
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 
+#include "CsrValueUpdater.hpp"
 #include "ExampleHelper.hpp"
+#include "FactorStatistics.hpp"
+#include "MatrixMarketReader.hpp"
+#include "ParallelRefactorization.hpp"
+#include "PatternFingerprint.hpp"
+#include "RefactorizationPolicy.hpp"
+#include "SinglePrecisionLU.hpp"
+#include "SymbolicAnalysisCache.hpp"
 #include <resolve/GramSchmidt.hpp>
 #include <resolve/LinSolverDirectKLU.hpp>
 #include <resolve/LinSolverIterativeFGMRES.hpp>
@@ -43,7 +57,18 @@ void printHelpInfo()
   std::cout << "Usage:\n\t./";
   std::cout << "kluRefactor.exe -m <matrix pathname> -r <rhs pathname> -n <number of systems>\n\n";
   std::cout << "Optional features:\n\t-h\tPrints this message.\n";
-  std::cout << "\t-i\tEnables iterative refinement.\n\n";
+  std::cout << "\t-i\tEnables iterative refinement.\n";
+  std::cout << "\t-o <ordering> \tSelects KLU fill-reducing ordering: amd or colamd. KLU default is\n";
+  std::cout << "\t\t\tused if not given.\n";
+  std::cout << "\t-x\tSolves with single precision factors, refined in double precision\n";
+  std::cout << "\t\t(implies -i).\n";
+  std::cout << "\t-t <int> \tRefactorizes with the given number of threads instead of KLU.\n";
+  std::cout << "\t-c <dir> \tCaches orderings and factor patterns in <dir>. If a cache\n";
+  std::cout << "\t\t\tfor the sparsity pattern exists, KLU analysis is skipped and all\n";
+  std::cout << "\t\t\tsystems are refactorized (with -t threads, default 1).\n";
+  std::cout << "\t-s <method> \tTriangular solve with refactorized factors (-t or -c):\n";
+  std::cout << "\t\t\tsequential (default), levels, jacobi (requires -i) or fastest\n";
+  std::cout << "\t\t\t(times sequential and levels on the first solve).\n\n";
 }
 
 int main(int argc, char* argv[])
@@ -62,7 +87,8 @@ int main(int argc, char* argv[])
     return 0;
   }
 
-  bool is_iterative_refinement = options.hasKey("-i");
+  bool is_mixed_precision      = options.hasKey("-x");
+  bool is_iterative_refinement = options.hasKey("-i") || is_mixed_precision;
 
   index_type num_systems = 0;
   auto       opt         = options.getParamFromKey("-n");
@@ -114,6 +140,52 @@ int main(int argc, char* argv[])
     file_extension = "mtx";
   }
 
+  int num_threads = 0;
+  opt             = options.getParamFromKey("-t");
+  if (opt)
+  {
+    num_threads = atoi((opt->second).c_str());
+  }
+  bool is_parallel = (num_threads > 0);
+  if (is_parallel && is_mixed_precision)
+  {
+    std::cout << "Options -t and -x cannot be combined.\n";
+    return 1;
+  }
+
+  int ordering = -1; // KLU default ordering unless -o is given
+  opt          = options.getParamFromKey("-o");
+  if (opt && getOrdering(opt->second, ordering) != 0)
+  {
+    printHelpInfo();
+    return 1;
+  }
+
+  TriangularSolveMethod solve_method = TriangularSolveMethod::sequential;
+  opt                                = options.getParamFromKey("-s");
+  if (opt && getTriangularSolveMethod(opt->second, solve_method) != 0)
+  {
+    printHelpInfo();
+    return 1;
+  }
+  if (solve_method == TriangularSolveMethod::jacobi && !is_iterative_refinement)
+  {
+    std::cout << "Triangular solve method jacobi is approximate and requires -i.\n";
+    return 1;
+  }
+
+  std::string cache_dir("");
+  opt = options.getParamFromKey("-c");
+  if (opt)
+  {
+    cache_dir = opt->second;
+  }
+  if (!cache_dir.empty() && is_mixed_precision)
+  {
+    std::cout << "Options -c and -x cannot be combined.\n";
+    return 1;
+  }
+
   std::string fileId;
   std::string rhsId;
   std::string matrix_file_name_full;
@@ -128,9 +200,43 @@ int main(int argc, char* argv[])
   vector_type* vec_rhs = nullptr;
   vector_type* vec_x   = nullptr;
 
+  // Cached positions of matrix file entries for value updates
+  CsrValueUpdater value_updater;
+
+  // Multithreaded reader of the first system, stream reader is the fallback
+  MatrixMarketReader mm_reader;
+
   LinSolverDirectKLU*      KLU = new LinSolverDirectKLU;
   GramSchmidt              GS(&vector_handler, GramSchmidt::CGS2);
   LinSolverIterativeFGMRES FGMRES(&matrix_handler, &vector_handler, &GS);
+  bool                     is_fgmres_setup = false;
+  if (ordering >= 0)
+  {
+    KLU->setOrdering(ordering);
+  }
+
+  // Single precision copies of KLU factors for mixed precision solves
+  SinglePrecisionLU single_lu;
+
+  // Multithreaded refactorization with the pivot sequence of a KLU factorization
+  ParallelRefactorizationCpu parallel_refactor;
+  parallel_refactor.setNumThreads(num_threads);
+  parallel_refactor.setSolveMethod(solve_method);
+
+  // Rejects parallel refactorizations whose pivots collapsed
+  RefactorizationPolicy policy;
+
+  // Orderings and factor patterns from a previous run
+  SymbolicAnalysisCache symbolic_cache;
+  std::string           cache_file("");
+  bool                  is_cached_analysis = false;
+
+  // Number of systems solved by KLU since its last analysis
+  int klu_step = 0;
+
+  // Parallel refactorization has factors to refactorize, otherwise KLU refactorizes
+  bool is_parallel_setup = false;
+
   for (int i = 0; i < num_systems; ++i)
   {
     std::cout << "System " << i << ":\n";
@@ -156,14 +262,26 @@ int main(int argc, char* argv[])
     bool is_expand_symmetric = true;
     if (i == 0)
     {
-      A = ReSolve::io::createCsrFromFile(mat_file, is_expand_symmetric);
+      A = mm_reader.createCsr(matrix_file_name_full, is_expand_symmetric);
+      if (A == nullptr)
+      {
+        A = ReSolve::io::createCsrFromFile(mat_file, is_expand_symmetric);
+      }
 
-      vec_rhs = ReSolve::io::createVectorFromFile(rhs_file);
+      vec_rhs = mm_reader.createVector(rhs_file_name_full);
+      if (vec_rhs == nullptr)
+      {
+        vec_rhs = ReSolve::io::createVectorFromFile(rhs_file);
+      }
       vec_x   = new vector_type(A->getNumRows());
+      value_updater.setup(mat_file, A);
     }
     else
     {
-      ReSolve::io::updateMatrixFromFile(mat_file, A);
+      if (value_updater.update(mat_file, A) != 0)
+      {
+        return 1;
+      }
       ReSolve::io::updateVectorFromFile(rhs_file, vec_rhs);
     }
     printSystemInfo(matrix_file_name_full, A);
@@ -172,34 +290,176 @@ int main(int argc, char* argv[])
 
     std::cout << "COO to CSR completed. Expanded NNZ: " << A->getNnz() << std::endl;
     // Now call direct solver
-    int status;
+    int status = 0;
     if (i == 0)
     {
       vec_rhs->setDataUpdated(ReSolve::memory::HOST);
-      KLU->setup(A);
-      status = KLU->analyze();
-      std::cout << "KLU analysis status: " << status << std::endl;
+      if (!cache_dir.empty())
+      {
+        std::uint64_t fingerprint = PatternFingerprint::compute(A);
+        std::string   prefix      = (ordering < 0) ? "klu" : "klu_" + getOrderingNames()[ordering];
+        cache_file                = SymbolicAnalysisCache::getFileName(cache_dir, fingerprint, prefix);
+        if (symbolic_cache.load(cache_file, fingerprint, A) == 0)
+        {
+          status = parallel_refactor.setup(A,
+                                           symbolic_cache.getL(),
+                                           symbolic_cache.getU(),
+                                           symbolic_cache.getP(),
+                                           symbolic_cache.getQ());
+          std::cout << "Loaded symbolic analysis from " << cache_file << ", setup status: " << status
+                    << ", levels: " << parallel_refactor.getNumLevels()
+                    << ", solve levels: " << parallel_refactor.getNumSolveLevels() << std::endl;
+          is_cached_analysis = (status == 0);
+          // Cached factors have no values, the KLU pivot ratio is the baseline
+          policy.setPivotRatioBaseline(symbolic_cache.getPivotRatio());
+        }
+      }
     }
-    if (i < 2)
+    if (is_cached_analysis)
     {
-      status = KLU->factorize();
-      std::cout << "KLU factorization status: " << status << std::endl;
+      status = parallel_refactor.refactorize();
+      std::cout << "Parallel re-factorization (" << parallel_refactor.getNumThreads()
+                << " threads) with cached analysis status: " << status
+                << ", pivot ratio: " << parallel_refactor.getPivotRatio() << std::endl;
+      if (status != 0 || !policy.checkPivotRatio(parallel_refactor.getPivotRatio()))
+      {
+        std::cout << "Cached pivot sequence failed, falling back to KLU analysis.\n";
+        is_cached_analysis = false;
+      }
     }
-    else
+    if (!is_cached_analysis)
     {
-      status = KLU->refactorize();
-      std::cout << "KLU re-factorization status: " << status << std::endl;
+      if (klu_step == 0)
+      {
+        KLU->setup(A);
+        status = KLU->analyze();
+        std::cout << "KLU analysis status: " << status << std::endl;
+      }
+      if (klu_step < 2)
+      {
+        status = KLU->factorize();
+        std::cout << "KLU factorization status: " << status << std::endl;
+        if (klu_step == 0 && status == 0)
+        {
+          FactorStatistics factor_stats = computeFactorStatistics(A, KLU->getLFactor(), KLU->getUFactor());
+          printFactorStatistics(factor_stats);
+          if (!cache_file.empty())
+          {
+            status = SymbolicAnalysisCache::save(cache_file,
+                                                 PatternFingerprint::compute(A),
+                                                 A,
+                                                 KLU->getLFactorCsr(),
+                                                 KLU->getUFactorCsr(),
+                                                 KLU->getPOrdering(),
+                                                 KLU->getQOrdering(),
+                                                 factor_stats.pivot_ratio);
+            std::cout << "Symbolic analysis saved to " << cache_file << ", status: " << status << std::endl;
+          }
+        }
+        if (is_parallel && klu_step == 1)
+        {
+          status = parallel_refactor.setup(A,
+                                           KLU->getLFactorCsr(),
+                                           KLU->getUFactorCsr(),
+                                           KLU->getPOrdering(),
+                                           KLU->getQOrdering());
+          std::cout << "Parallel refactorization setup status: " << status
+                    << ", levels: " << parallel_refactor.getNumLevels()
+                    << ", solve levels: " << parallel_refactor.getNumSolveLevels()
+                    << ", pivot ratio: " << parallel_refactor.getPivotRatio() << std::endl;
+          is_parallel_setup = (status == 0);
+          if (!is_parallel_setup)
+          {
+            std::cout << "Parallel refactorization setup failed, using KLU refactorization.\n";
+          }
+
+          // Pivot ratio of the KLU factors is the baseline for refactorizations
+          policy.resetPivotRatio();
+          policy.checkPivotRatio(parallel_refactor.getPivotRatio());
+        }
+      }
+      else if (is_parallel_setup)
+      {
+        status = parallel_refactor.refactorize();
+        std::cout << "Parallel re-factorization (" << parallel_refactor.getNumThreads()
+                  << " threads) status: " << status
+                  << ", pivot ratio: " << parallel_refactor.getPivotRatio()
+                  << ", pivot growth: " << parallel_refactor.getPivotGrowth() << std::endl;
+
+        // Check pivots before the solve and refinement are spent on these factors
+        if (status != 0 || !policy.checkPivotRatio(parallel_refactor.getPivotRatio()))
+        {
+          std::cout << "Refactorization rejected, redoing KLU numeric factorization.\n";
+          status = KLU->factorize();
+          std::cout << "KLU factorization status: " << status << std::endl;
+          if (status != 0)
+          {
+            // Pivot sequence does not suit these values, redo the analysis
+            status = KLU->analyze();
+            std::cout << "KLU analysis status: " << status << std::endl;
+            status = KLU->factorize();
+            std::cout << "KLU factorization status: " << status << std::endl;
+          }
+          is_parallel_setup = false;
+          if (status == 0)
+          {
+            status = parallel_refactor.setup(A,
+                                             KLU->getLFactorCsr(),
+                                             KLU->getUFactorCsr(),
+                                             KLU->getPOrdering(),
+                                             KLU->getQOrdering());
+            is_parallel_setup = (status == 0);
+            if (!is_parallel_setup)
+            {
+              std::cout << "Parallel refactorization setup failed, using KLU refactorization.\n";
+            }
+          }
+          if (is_parallel_setup)
+          {
+            policy.resetPivotRatio();
+            policy.checkPivotRatio(parallel_refactor.getPivotRatio());
+          }
+        }
+      }
+      else
+      {
+        status = KLU->refactorize();
+        std::cout << "KLU re-factorization status: " << status << std::endl;
+      }
+      ++klu_step;
+    }
+    // Solver used for the triangular solve and as the IR preconditioner
+    LinSolverDirect* lu_solver = KLU;
+    if (is_cached_analysis || (is_parallel_setup && klu_step > 2))
+    {
+      lu_solver = &parallel_refactor;
     }
-    status = KLU->solve(vec_rhs, vec_x);
-    std::cout << "KLU solve status: " << status << std::endl;
+    if (is_mixed_precision)
+    {
+      status = single_lu.setup(A,
+                               KLU->getLFactorCsr(),
+                               KLU->getUFactorCsr(),
+                               KLU->getPOrdering(),
+                               KLU->getQOrdering());
+      std::cout << "Single precision factors setup status: " << status
+                << ", factor values: " << single_lu.getFactorValuesSize() << " bytes" << std::endl;
+      lu_solver = &single_lu;
+    }
+    status = lu_solver->solve(vec_rhs, vec_x);
+    std::cout << (is_mixed_precision ? "Single precision" : "KLU") << " solve status: " << status << std::endl;
 
     helper.resetSystem(A, vec_rhs, vec_x);
     helper.printShortSummary();
     if (is_iterative_refinement)
     {
-      // Setup iterative refinement
-      FGMRES.setup(A);
-      FGMRES.setupPreconditioner("LU", KLU);
+      // Setup iterative refinement once; later systems only reset the matrix
+      if (!is_fgmres_setup)
+      {
+        FGMRES.setup(A);
+        is_fgmres_setup = true;
+      }
+      FGMRES.resetMatrix(A);
+      FGMRES.setupPreconditioner("LU", lu_solver);
 
       // If refactorization produced finite solution do iterative refinement
       if (std::isfinite(helper.getNormRelativeResidual()))
@@ -0,0 +1,330 @@
+/**
+ * @file mtxToBin.cpp
+ *
+ * @brief Converts a series of linear systems stored in Matrix Market files
+ * into a single binary sequence file.
+ *
+ * All systems in the series must have the same sparsity pattern. The pattern
+ * is stored once, followed by matrix values and right-hand side for each
+ * system. Examples read the resulting file with `-f bin` option.
+ *
+ * Small series can be scaled up for benchmarking: the stored matrix is
+ * block diagonal with several copies of the input matrix, and input files
+ * can be reused cyclically to write longer sequences than the input.
+ *
+ */
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "BinarySequence.hpp"
+#include "CsrValueUpdater.hpp"
+#include "MatrixMarketReader.hpp"
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/io.hpp>
+#include <resolve/utilities/params/CliOptions.hpp>
+#include <resolve/vector/Vector.hpp>
+
+/// Prints help message describing system usage.
+void printHelpInfo()
+{
+  std::cout << "\nmtxToBin.exe converts a series of linear systems to a binary sequence file.\n\n";
+  std::cout << "System matrices are in files with names <pathname>XX.mtx, where XX are\n";
+  std::cout << "consecutive integer numbers 00, 01, 02, ...\n\n";
+  std::cout << "System right hand side vectors are stored in files with matching numbering\n";
+  std::cout << "and file extension.\n\n";
+  std::cout << "Usage:\n\t./";
+  std::cout << "mtxToBin.exe -m <matrix pathname> -r <rhs pathname> -n <number of systems> -o <output file>\n\n";
+  std::cout << "Optional features:\n";
+  std::cout << "\t-e <ext> \tSelects custom extension for input files (default 'mtx').\n";
+  std::cout << "\t-h\tPrints this message.\n";
+  std::cout << "\t-k <int> \tStores block diagonal systems with <int> copies of each input\n";
+  std::cout << "\t\t\tsystem (default 1).\n";
+  std::cout << "\t-p <int> \tReuses the first <int> input files cyclically (default: no reuse).\n";
+  std::cout << "\t-s <int> \tNumber XX of the first input file (default 0).\n";
+  std::cout << "\t-x <ext> \tSelects extension of right hand side files (default same as -e).\n\n";
+}
+
+/**
+ * @brief Create block diagonal matrix with `copies` copies of the pattern of `A`.
+ *
+ * Values are set with copyReplicated().
+ */
+static ReSolve::matrix::Csr* createReplicatedCsr(ReSolve::matrix::Csr* A, ReSolve::index_type copies)
+{
+  using namespace ReSolve;
+
+  index_type        n       = A->getNumRows();
+  index_type        m       = A->getNumColumns();
+  index_type        nnz     = A->getNnz();
+  const index_type* row_ptr = A->getRowData(memory::HOST);
+  const index_type* col_idx = A->getColData(memory::HOST);
+
+  matrix::Csr* B = new matrix::Csr(n * copies, m * copies, nnz * copies, A->symmetric(), A->expanded());
+  B->allocateMatrixData(memory::HOST);
+  index_type* B_row_ptr = B->getRowData(memory::HOST);
+  index_type* B_col_idx = B->getColData(memory::HOST);
+  for (index_type c = 0; c < copies; ++c)
+  {
+    for (index_type i = 0; i < n; ++i)
+    {
+      B_row_ptr[c * n + i] = c * nnz + row_ptr[i];
+    }
+    for (index_type p = 0; p < nnz; ++p)
+    {
+      B_col_idx[c * nnz + p] = c * m + col_idx[p];
+    }
+  }
+  B_row_ptr[n * copies] = nnz * copies;
+  return B;
+}
+
+/// Copy values of `A` and `rhs` into each block of replicated `B` and `B_rhs`.
+static void copyReplicated(ReSolve::matrix::Csr*    A,
+                           ReSolve::vector::Vector* rhs,
+                           ReSolve::matrix::Csr*    B,
+                           ReSolve::vector::Vector* B_rhs,
+                           ReSolve::index_type      copies)
+{
+  using namespace ReSolve;
+
+  index_type       n          = A->getNumRows();
+  index_type       nnz        = A->getNnz();
+  const real_type* values     = A->getValues(memory::HOST);
+  const real_type* rhs_values = rhs->getData(memory::HOST);
+  real_type*       B_values   = B->getValues(memory::HOST);
+  real_type*       B_rhs_data = B_rhs->getData(memory::HOST);
+  for (index_type c = 0; c < copies; ++c)
+  {
+    std::copy(values, values + nnz, B_values + c * nnz);
+    std::copy(rhs_values, rhs_values + n, B_rhs_data + c * n);
+  }
+  B->setUpdated(memory::HOST);
+  B_rhs->setDataUpdated(memory::HOST);
+}
+
+int main(int argc, char* argv[])
+{
+  using namespace ReSolve::examples;
+  using namespace ReSolve;
+  using index_type  = ReSolve::index_type;
+  using vector_type = ReSolve::vector::Vector;
+
+  CliOptions options(argc, argv);
+
+  bool is_help = options.hasKey("-h");
+  if (is_help)
+  {
+    printHelpInfo();
+    return 0;
+  }
+
+  index_type num_systems = 0;
+  auto       opt         = options.getParamFromKey("-n");
+  if (opt)
+  {
+    num_systems = atoi((opt->second).c_str());
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string matrix_pathname("");
+  opt = options.getParamFromKey("-m");
+  if (opt)
+  {
+    matrix_pathname = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string rhs_pathname("");
+  opt = options.getParamFromKey("-r");
+  if (opt)
+  {
+    rhs_pathname = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string output_pathname("");
+  opt = options.getParamFromKey("-o");
+  if (opt)
+  {
+    output_pathname = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string file_extension("");
+  opt = options.getParamFromKey("-e");
+  if (opt)
+  {
+    file_extension = opt->second;
+  }
+  else
+  {
+    file_extension = "mtx";
+  }
+
+  std::string rhs_extension(file_extension);
+  opt = options.getParamFromKey("-x");
+  if (opt)
+  {
+    rhs_extension = opt->second;
+  }
+
+  index_type copies = 1;
+  opt               = options.getParamFromKey("-k");
+  if (opt)
+  {
+    copies = atoi((opt->second).c_str());
+  }
+
+  index_type num_files = 0;
+  opt                  = options.getParamFromKey("-p");
+  if (opt)
+  {
+    num_files = atoi((opt->second).c_str());
+  }
+
+  index_type first_file = 0;
+  opt                   = options.getParamFromKey("-s");
+  if (opt)
+  {
+    first_file = atoi((opt->second).c_str());
+  }
+  if (copies < 1 || num_files < 0 || first_file < 0)
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  matrix::Csr* A       = nullptr;
+  vector_type* vec_rhs = nullptr;
+
+  // Stored system, the input one unless it is replicated
+  matrix::Csr* A_out   = nullptr;
+  vector_type* rhs_out = nullptr;
+
+  BinarySequenceWriter writer;
+  CsrValueUpdater      value_updater;
+  MatrixMarketReader   mm_reader; ///< first system, stream reader is the fallback
+
+  int status = 0;
+  for (int i = 0; i < num_systems; ++i)
+  {
+    index_type file = first_file + ((num_files > 0) ? i % num_files : i);
+
+    std::ostringstream matname;
+    std::ostringstream rhsname;
+    matname << matrix_pathname << std::setfill('0') << std::setw(2) << file << "." << file_extension;
+    rhsname << rhs_pathname << std::setfill('0') << std::setw(2) << file << "." << rhs_extension;
+    std::string matrix_pathname_full = matname.str();
+    std::string rhs_pathname_full    = rhsname.str();
+
+    std::ifstream mat_file(matrix_pathname_full);
+    if (!mat_file.is_open())
+    {
+      std::cout << "Failed to open file " << matrix_pathname_full << "\n";
+      status = 1;
+      break;
+    }
+    std::ifstream rhs_file(rhs_pathname_full);
+    if (!rhs_file.is_open())
+    {
+      std::cout << "Failed to open file " << rhs_pathname_full << "\n";
+      status = 1;
+      break;
+    }
+
+    // Refactorization is LU-based, so store expanded symmetric matrices
+    bool is_expand_symmetric = true;
+    if (i == 0)
+    {
+      A = mm_reader.createCsr(matrix_pathname_full, is_expand_symmetric);
+      if (A == nullptr)
+      {
+        A = io::createCsrFromFile(mat_file, is_expand_symmetric);
+      }
+      vec_rhs = mm_reader.createVector(rhs_pathname_full);
+      if (vec_rhs == nullptr)
+      {
+        vec_rhs = io::createVectorFromFile(rhs_file);
+      }
+      if (copies > 1)
+      {
+        A_out   = createReplicatedCsr(A, copies);
+        rhs_out = new vector_type(A_out->getNumRows());
+        rhs_out->allocate(memory::HOST);
+      }
+      else
+      {
+        A_out   = A;
+        rhs_out = vec_rhs;
+      }
+      status = writer.open(output_pathname, A_out);
+      if (status != 0)
+      {
+        break;
+      }
+      value_updater.setup(mat_file, A);
+    }
+    else
+    {
+      status = value_updater.update(mat_file, A);
+      if (status != 0)
+      {
+        break;
+      }
+      io::updateVectorFromFile(rhs_file, vec_rhs);
+    }
+    mat_file.close();
+    rhs_file.close();
+
+    if (copies > 1)
+    {
+      copyReplicated(A, vec_rhs, A_out, rhs_out, copies);
+    }
+    status = writer.append(A_out, rhs_out);
+    if (status != 0)
+    {
+      break;
+    }
+    std::cout << "Converted system " << i << ": " << matrix_pathname_full << "\n";
+  }
+
+  status += writer.close();
+  if (status == 0)
+  {
+    std::cout << "Wrote " << writer.getNumSystems() << " systems to " << output_pathname << "\n";
+  }
+
+  if (A_out != A)
+  {
+    delete A_out;
+    delete rhs_out;
+  }
+  delete A;
+  delete vec_rhs;
+
+  return status == 0 ? 0 : 1;
+}
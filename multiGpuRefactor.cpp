@@ -0,0 +1,459 @@
+/**
+ * @file multiGpuRefactor.cpp
+ *
+ * @brief Example distributing same-pattern scenarios over several GPUs.
+ *
+ * A set of independent linear systems (e.g. contingency scenarios) sharing
+ * one sparsity pattern is read from a binary sequence file created by
+ * mtxToBin.exe. KLU symbolic analysis and factorization are done once on
+ * the host for the first scenario. Its pivot sequence and factors are then
+ * handed to refactorization solvers (cusolverRf or rocsolverRf) on all
+ * devices, so no device redoes the analysis.
+ *
+ * Each device is driven by one or more host threads, each with its own
+ * workspace and solvers bound to that device. Threads take chunks of
+ * scenarios from a shared counter until all are solved, so faster devices
+ * solve more scenarios. Per-device counts and timing are gathered and
+ * reported at the end.
+ *
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <resolve/LinSolverDirectKLU.hpp>
+#include <resolve/matrix/Csc.hpp>
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/MatrixHandler.hpp>
+#include <resolve/utilities/params/CliOptions.hpp>
+#include <resolve/vector/Vector.hpp>
+#include <resolve/workspace/LinAlgWorkspace.hpp>
+
+#ifdef RESOLVE_USE_CUDA
+#include <resolve/LinSolverDirectCuSolverRf.hpp>
+#endif
+#ifdef RESOLVE_USE_HIP
+#include <resolve/LinSolverDirectRocSolverRf.hpp>
+#endif
+
+#if defined(RESOLVE_USE_CUDA)
+#include <cuda_runtime.h>
+#elif defined(RESOLVE_USE_HIP)
+#include <hip/hip_runtime.h>
+#endif
+
+#include "Benchmark.hpp"
+#include "BinarySequence.hpp"
+#include "ExampleHelper.hpp"
+#include "RefactorizationFactors.hpp"
+#include "ThreadTeam.hpp"
+
+/// Prints help message describing system usage.
+static void printHelpInfo()
+{
+  std::cout << "\nmultiGpuRefactor.exe solves same-pattern scenarios on all visible GPUs.\n\n";
+  std::cout << "Usage:\n\t./";
+  std::cout << "multiGpuRefactor.exe -m <binary sequence file>\n\n";
+  std::cout << "The binary sequence file is created with mtxToBin.exe.\n\n";
+  std::cout << "Optional features:\n";
+  std::cout << "\t-c <num> \tScenarios taken by a solver at once (default 1).\n";
+  std::cout << "\t-g <num> \tNumber of devices to use (default: all visible devices).\n";
+  std::cout << "\t-h\tPrints this message.\n";
+  std::cout << "\t-n <num> \tNumber of scenarios to solve (default: all in the file).\n";
+  std::cout << "\t-w <num> \tSolvers (host threads) per device (default 1).\n\n";
+}
+
+/// Number of visible devices.
+static int getNumDevices()
+{
+  int num_devices = 0;
+#if defined(RESOLVE_USE_CUDA)
+  if (cudaGetDeviceCount(&num_devices) != cudaSuccess)
+  {
+    num_devices = 0;
+  }
+#elif defined(RESOLVE_USE_HIP)
+  if (hipGetDeviceCount(&num_devices) != hipSuccess)
+  {
+    num_devices = 0;
+  }
+#endif
+  return num_devices;
+}
+
+/// Bind the calling thread to `device`; returns 0 if successful.
+static int setDevice(int device)
+{
+#if defined(RESOLVE_USE_CUDA)
+  return cudaSetDevice(device) == cudaSuccess ? 0 : 1;
+#elif defined(RESOLVE_USE_HIP)
+  return hipSetDevice(device) == hipSuccess ? 0 : 1;
+#else
+  return device == 0 ? 0 : 1;
+#endif
+}
+
+/// Pivot sequence and factors of the shared KLU factorization.
+struct SharedAnalysis
+{
+  ReSolve::matrix::Csc*            L{nullptr};
+  ReSolve::matrix::Csc*            U{nullptr};
+  std::vector<ReSolve::index_type> P;
+  std::vector<ReSolve::index_type> Q;
+
+  SharedAnalysis() = default;
+
+  SharedAnalysis(const SharedAnalysis&)            = delete;
+  SharedAnalysis& operator=(const SharedAnalysis&) = delete;
+
+  ~SharedAnalysis()
+  {
+    delete L;
+    delete U;
+  }
+};
+
+/// Host copy of CSC factor `F`, so that solvers on different devices do not share it.
+static ReSolve::matrix::Csc* copyFactor(ReSolve::matrix::Csc* F)
+{
+  using namespace ReSolve;
+  matrix::Csc* copy = new matrix::Csc(F->getNumRows(), F->getNumColumns(), F->getNnz());
+  copy->copyDataFrom(F->getRowData(memory::HOST),
+                     F->getColData(memory::HOST),
+                     F->getValues(memory::HOST),
+                     memory::HOST,
+                     memory::HOST);
+  return copy;
+}
+
+/// Results of one solver.
+struct SolverResult
+{
+  int                device{0};
+  int                status{0};
+  int                num_solved{0};
+  int                num_refactor_fails{0};
+  double             setup_time{0.0};   ///< workspace and refactorization setup [s]
+  double             solve_time{0.0};   ///< time spent on scenarios [s]
+  ReSolve::real_type max_residual{0.0}; ///< largest relative residual norm
+};
+
+/// Scenarios shared by all solvers.
+struct ScenarioQueue
+{
+  const ReSolve::examples::BinarySequenceReader* sequence{nullptr};
+  ReSolve::index_type                            num_scenarios{0};
+  ReSolve::index_type                            chunk_size{1};
+  std::atomic<ReSolve::index_type>               next{0};
+  std::vector<ReSolve::real_type>                residuals; ///< relative residual norm per scenario
+};
+
+/**
+ * @brief Solve scenarios on `device` until the queue is empty.
+ *
+ * @param[in]     device   - device used by this solver
+ * @param[in]     analysis - factors of the shared KLU factorization, owned by this solver
+ * @param[in]     start    - barrier all solvers wait at before taking scenarios
+ * @param[in,out] queue    - scenarios and their residuals
+ * @param[out]    result   - status, counts and timing of this solver
+ */
+template <class workspace_type, class refactor_type>
+static void solveScenarios(int                                 device,
+                           SharedAnalysis&                     analysis,
+                           ReSolve::examples::BlockingBarrier& start,
+                           ScenarioQueue&                      queue,
+                           SolverResult&                       result)
+{
+  using namespace ReSolve;
+  using namespace ReSolve::examples;
+  using clock = std::chrono::steady_clock;
+
+  result.device = device;
+  if (setDevice(device) != 0)
+  {
+    std::cout << "Failed to select device " << device << ".\n";
+    result.status = 1;
+    start.wait();
+    return;
+  }
+  auto time_start = clock::now();
+
+  // Everything the solvers use is private to this thread and device
+  workspace_type workspace;
+  workspace.initializeHandles();
+  ExampleHelper<workspace_type>  helper(workspace);
+  MatrixHandler                  matrix_handler(&workspace);
+  std::unique_ptr<refactor_type> Rf = std::make_unique<refactor_type>(&workspace);
+
+  // KLU is used only if refactorization fails for a scenario
+  LinSolverDirectKLU KLU;
+  bool               is_klu_setup = false;
+
+  const BinarySequenceReader& sequence = *queue.sequence;
+  matrix::Csr*                A        = sequence.createCsr(0);
+  vector::Vector              vec_rhs(sequence.getNumRows());
+  vector::Vector              vec_x(sequence.getNumRows());
+  vec_rhs.allocate(memory::HOST);
+  vec_rhs.allocate(memory::DEVICE);
+  vec_x.allocate(memory::HOST);
+  vec_x.allocate(memory::DEVICE);
+  result.status += sequence.updateVector(0, &vec_rhs, memory::HOST);
+  A->syncData(memory::DEVICE);
+  vec_rhs.syncData(memory::DEVICE);
+
+  result.status += Rf->setup(A, analysis.L, analysis.U, analysis.P.data(), analysis.Q.data(), &vec_rhs);
+  result.setup_time = std::chrono::duration<double>(clock::now() - time_start).count();
+
+  start.wait();
+  if (result.status != 0)
+  {
+    // Scenarios are left to the solvers on healthy devices
+    std::cout << "Solver setup on device " << device << " failed, it takes no scenarios.\n";
+    delete A;
+    return;
+  }
+  time_start = clock::now();
+  for (index_type first = queue.next.fetch_add(queue.chunk_size);
+       first < queue.num_scenarios;
+       first = queue.next.fetch_add(queue.chunk_size))
+  {
+    index_type last = std::min(first + queue.chunk_size, queue.num_scenarios);
+    for (index_type s = first; s < last; ++s)
+    {
+      if (sequence.updateMatrix(s, A, memory::DEVICE) != 0
+          || sequence.updateVector(s, &vec_rhs, memory::DEVICE) != 0)
+      {
+        ++result.status;
+        continue;
+      }
+      matrix_handler.setValuesChanged(true, memory::DEVICE);
+      helper.setValuesChanged();
+
+      int status = Rf->refactorize();
+      if (status != 0)
+      {
+        // Pattern is shared, so only this solver redoes the factorization
+        ++result.num_refactor_fails;
+        status = sequence.updateMatrix(s, A, memory::HOST);
+        status += sequence.updateVector(s, &vec_rhs, memory::HOST);
+        // Device copies are stale after the host update, and the solve uses them
+        A->syncData(memory::DEVICE);
+        vec_rhs.syncData(memory::DEVICE);
+        if (!is_klu_setup)
+        {
+          KLU.setup(A);
+          KLU.analyze();
+          is_klu_setup = true;
+        }
+        status += KLU.factorize();
+        renewRefactorizationSolver(Rf, &workspace);
+        status += Rf->setup(A,
+                            (matrix::Csc*) KLU.getLFactor(),
+                            (matrix::Csc*) KLU.getUFactor(),
+                            KLU.getPOrdering(),
+                            KLU.getQOrdering(),
+                            &vec_rhs);
+        status += Rf->refactorize();
+      }
+      status += Rf->solve(&vec_rhs, &vec_x);
+      result.status += status;
+
+      helper.resetSystem(A, &vec_rhs, &vec_x);
+      queue.residuals[s]  = helper.getNormRelativeResidual();
+      result.max_residual = std::max(result.max_residual, queue.residuals[s]);
+      ++result.num_solved;
+    }
+  }
+  result.solve_time = std::chrono::duration<double>(clock::now() - time_start).count();
+  delete A;
+}
+
+/// Prototype of the example function
+template <class workspace_type, class refactor_type>
+static int multiGpuRefactor(int argc, char* argv[]);
+
+/// Main function selects example to be run.
+int main(int argc, char* argv[])
+{
+#ifdef RESOLVE_USE_CUDA
+  return multiGpuRefactor<ReSolve::LinAlgWorkspaceCUDA,
+                          ReSolve::LinSolverDirectCuSolverRf>(argc, argv);
+#endif
+
+#ifdef RESOLVE_USE_HIP
+  return multiGpuRefactor<ReSolve::LinAlgWorkspaceHIP,
+                          ReSolve::LinSolverDirectRocSolverRf>(argc, argv);
+#endif
+}
+
+/**
+ * @brief Example of refactorization solvers on several GPUs
+ *
+ * @tparam workspace_type - Type of the workspace to use
+ * @tparam refactor_type  - Type of the refactorization solver
+ * @param[in] argc - Number of command line arguments
+ * @param[in] argv - Command line arguments
+ * @return 0 if the example ran successfully, 1 otherwise
+ */
+template <class workspace_type, class refactor_type>
+int multiGpuRefactor(int argc, char* argv[])
+{
+  using namespace ReSolve;
+  using namespace ReSolve::examples;
+
+  CliOptions options(argc, argv);
+
+  if (options.hasKey("-h"))
+  {
+    printHelpInfo();
+    return 0;
+  }
+
+  std::string sequence_pathname("");
+  auto        opt = options.getParamFromKey("-m");
+  if (opt)
+  {
+    sequence_pathname = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  BinarySequenceReader sequence;
+  if (sequence.open(sequence_pathname) != 0)
+  {
+    return 1;
+  }
+
+  index_type num_scenarios = sequence.getNumSystems();
+  opt                      = options.getParamFromKey("-n");
+  if (opt)
+  {
+    num_scenarios = std::min(num_scenarios, static_cast<index_type>(atoi((opt->second).c_str())));
+  }
+
+  int num_devices = getNumDevices();
+  opt             = options.getParamFromKey("-g");
+  if (opt)
+  {
+    num_devices = std::min(num_devices, atoi((opt->second).c_str()));
+  }
+
+  int solvers_per_device = 1;
+  opt                    = options.getParamFromKey("-w");
+  if (opt)
+  {
+    solvers_per_device = std::max(1, atoi((opt->second).c_str()));
+  }
+
+  index_type chunk_size = 1;
+  opt                   = options.getParamFromKey("-c");
+  if (opt)
+  {
+    chunk_size = std::max(1, atoi((opt->second).c_str()));
+  }
+
+  if (num_scenarios <= 0 || num_devices <= 0)
+  {
+    std::cout << "No scenarios to solve or no devices available.\n";
+    return 1;
+  }
+
+  // Symbolic analysis and factorization once, for all devices
+  PhaseTimer         timer;
+  matrix::Csr*       A = sequence.createCsr(0);
+  LinSolverDirectKLU KLU;
+  timer.start();
+  KLU.setup(A);
+  int status = KLU.analyze();
+  status += KLU.factorize();
+  double analysis_time = timer.stop();
+  std::cout << "KLU analysis and factorization of scenario 0 status: " << status
+            << ", time: " << analysis_time << " s\n";
+  if (status != 0)
+  {
+    delete A;
+    return 1;
+  }
+
+  // Every solver gets its own copy of the factors
+  int                         num_solvers = num_devices * solvers_per_device;
+  std::vector<SharedAnalysis> analyses(num_solvers);
+  for (SharedAnalysis& analysis : analyses)
+  {
+    analysis.L = copyFactor((matrix::Csc*) KLU.getLFactor());
+    analysis.U = copyFactor((matrix::Csc*) KLU.getUFactor());
+    analysis.P.assign(KLU.getPOrdering(), KLU.getPOrdering() + A->getNumRows());
+    analysis.Q.assign(KLU.getQOrdering(), KLU.getQOrdering() + A->getNumRows());
+  }
+  delete A;
+
+  ScenarioQueue queue;
+  queue.sequence      = &sequence;
+  queue.num_scenarios = num_scenarios;
+  queue.chunk_size    = chunk_size;
+  queue.residuals.assign(num_scenarios, 0.0);
+
+  // Solvers are set up in their threads; timing starts when all are ready
+  std::vector<SolverResult> results(num_solvers);
+  BlockingBarrier           start(num_solvers + 1);
+  std::vector<std::thread>  threads;
+  for (int k = 0; k < num_solvers; ++k)
+  {
+    int device = k % num_devices;
+    threads.emplace_back([&, k, device]()
+                         { solveScenarios<workspace_type, refactor_type>(device, analyses[k], start, queue, results[k]); });
+  }
+  start.wait();
+  auto time_start = std::chrono::steady_clock::now();
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+  double wall_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - time_start).count();
+
+  // Gather results per device
+  std::cout << std::setw(8) << "device" << std::setw(10) << "solver" << std::setw(12) << "scenarios"
+            << std::setw(12) << "setup [s]" << std::setw(12) << "solve [s]" << std::setw(14) << "max res."
+            << std::setw(12) << "Rf fails" << "\n";
+  status = 0;
+  std::vector<int> device_solved(num_devices, 0);
+  for (int k = 0; k < num_solvers; ++k)
+  {
+    const SolverResult& result = results[k];
+    std::cout << std::setw(8) << result.device << std::setw(10) << k << std::setw(12) << result.num_solved
+              << std::fixed << std::setprecision(4)
+              << std::setw(12) << result.setup_time << std::setw(12) << result.solve_time
+              << std::scientific << std::setprecision(3) << std::setw(14) << result.max_residual
+              << std::setw(12) << result.num_refactor_fails << "\n";
+    status += result.status;
+    device_solved[result.device] += result.num_solved;
+  }
+  int num_solved = 0;
+  for (int d = 0; d < num_devices; ++d)
+  {
+    std::cout << "Device " << d << " solved " << device_solved[d] << " scenarios.\n";
+    num_solved += device_solved[d];
+  }
+  if (num_solved != num_scenarios)
+  {
+    std::cout << "Only " << num_solved << " of " << num_scenarios << " scenarios were solved.\n";
+    ++status;
+  }
+  real_type max_residual = *std::max_element(queue.residuals.begin(), queue.residuals.end());
+  std::cout << "Solved " << num_scenarios << " scenarios on " << num_devices << " devices in "
+            << std::fixed << std::setprecision(4) << wall_time << " s, "
+            << num_scenarios / wall_time << " scenarios/s, max. relative residual: "
+            << std::scientific << std::setprecision(3) << max_residual << "\n";
+
+  return status == 0 ? 0 : 1;
+}
@@ -0,0 +1,308 @@
+/**
+ * @file multiRhs.cpp
+ *
+ * @brief Example solving one factorized system for multiple right-hand sides.
+ *
+ * A linear system is read from files specified at command line input and
+ * factorized once. The system is then solved for k right-hand sides stored
+ * as columns of a multivector, as in contingency screening, where the same
+ * Jacobian is solved against many injection vectors. Right-hand side j is
+ * the system right-hand side plus a unit perturbation of entry j*n/k.
+ *
+ * On the CPU backend all right-hand sides are solved with one forward and
+ * one backward sweep over the KLU factors. On GPU backends the
+ * refactorization solver keeps its factors on the device, and the
+ * right-hand sides are solved one at a time.
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include "ExampleHelper.hpp"
+#include "MultiRhs.hpp"
+#include <resolve/LinSolverDirectKLU.hpp>
+#include <resolve/SystemSolver.hpp>
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/MatrixHandler.hpp>
+#include <resolve/matrix/io.hpp>
+#include <resolve/utilities/params/CliOptions.hpp>
+#include <resolve/vector/Vector.hpp>
+#include <resolve/vector/VectorHandler.hpp>
+#include <resolve/workspace/LinAlgWorkspace.hpp>
+
+/// Prints help message describing system usage.
+void printHelpInfo()
+{
+  std::cout << "\nmultiRhs.exe loads a linear system from files and solves it for\n";
+  std::cout << "multiple right-hand sides using one factorization.\n\n";
+  std::cout << "Usage:\n\t./";
+  std::cout << "multiRhs.exe -m <matrix file> -r <rhs file> -k <number of right-hand sides>\n\n";
+  std::cout << "Optional features:\n";
+  std::cout << "\t-b <cpu|cuda|hip> \tSelects hardware backend.\n";
+  std::cout << "\t-h\tPrints this message.\n\n";
+}
+
+/// Prototype of the example function
+template <class workspace_type>
+static int multiRhs(int argc, char* argv[]);
+
+/// Main function selects example to be run.
+int main(int argc, char* argv[])
+{
+  ReSolve::CliOptions options(argc, argv);
+
+  // If help flag is passed, print help message and return
+  bool is_help = options.hasKey("-h");
+  if (is_help)
+  {
+    printHelpInfo();
+    return 0;
+  }
+
+  // Select hardware backend, default to CPU if no -b option is passed
+  auto opt = options.getParamFromKey("-b");
+  if (!opt)
+  {
+    std::cout << "No backend option provided. Defaulting to CPU.\n";
+    return multiRhs<ReSolve::LinAlgWorkspaceCpu>(argc, argv);
+  }
+#ifdef RESOLVE_USE_CUDA
+  else if (opt->second == "cuda")
+  {
+    return multiRhs<ReSolve::LinAlgWorkspaceCUDA>(argc, argv);
+  }
+#endif
+#ifdef RESOLVE_USE_HIP
+  else if (opt->second == "hip")
+  {
+    return multiRhs<ReSolve::LinAlgWorkspaceHIP>(argc, argv);
+  }
+#endif
+  else if (opt->second == "cpu")
+  {
+    return multiRhs<ReSolve::LinAlgWorkspaceCpu>(argc, argv);
+  }
+  else
+  {
+    std::cout << "Re::Solve is not built with support for " << opt->second;
+    std::cout << " backend.\n";
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Example of solving a system for multiple right-hand sides
+ *
+ * @tparam workspace_type - Type of the workspace to use
+ * @param[in] argc - Number of command line arguments
+ * @param[in] argv - Command line arguments
+ * @return 0 if the example ran successfully, 1 otherwise
+ */
+template <class workspace_type>
+int multiRhs(int argc, char* argv[])
+{
+  using namespace ReSolve::examples;
+  using namespace ReSolve;
+  using index_type  = ReSolve::index_type;
+  using real_type   = ReSolve::real_type;
+  using vector_type = ReSolve::vector::Vector;
+
+  CliOptions options(argc, argv);
+
+  std::string matrix_file_name("");
+  auto        opt = options.getParamFromKey("-m");
+  if (opt)
+  {
+    matrix_file_name = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string rhs_file_name("");
+  opt = options.getParamFromKey("-r");
+  if (opt)
+  {
+    rhs_file_name = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  index_type num_rhs = 8;
+  opt                = options.getParamFromKey("-k");
+  if (opt)
+  {
+    num_rhs = atoi((opt->second).c_str());
+  }
+  if (num_rhs < 1)
+  {
+    std::cout << "Number of right-hand sides must be positive.\n";
+    return 1;
+  }
+
+  workspace_type workspace;
+  workspace.initializeHandles();
+
+  ExampleHelper<workspace_type> helper(workspace);
+  std::string                   hw_backend = helper.getHardwareBackend();
+  std::cout << "multiRhs with " << hw_backend << " backend\n";
+
+  bool                is_gpu   = (hw_backend == "CUDA" || hw_backend == "HIP");
+  memory::MemorySpace memspace = is_gpu ? memory::DEVICE : memory::HOST;
+
+  // Read the linear system
+  std::ifstream mat_file(matrix_file_name);
+  if (!mat_file.is_open())
+  {
+    std::cout << "Failed to open file " << matrix_file_name << "\n";
+    return 1;
+  }
+  std::ifstream rhs_file(rhs_file_name);
+  if (!rhs_file.is_open())
+  {
+    std::cout << "Failed to open file " << rhs_file_name << "\n";
+    return 1;
+  }
+
+  // Factorization is LU-based, so need to expand symmetric matrices
+  bool         is_expand_symmetric = true;
+  matrix::Csr* A                   = io::createCsrFromFile(mat_file, is_expand_symmetric);
+  real_type*   rhs                 = io::createArrayFromFile(rhs_file);
+  mat_file.close();
+  rhs_file.close();
+  printSystemInfo(matrix_file_name, A);
+
+  index_type n = A->getNumRows();
+
+  // Right-hand sides are perturbations of the system right-hand side
+  vector_type B(n, num_rhs);
+  vector_type X(n, num_rhs);
+  B.allocate(memory::HOST);
+  X.allocate(memory::HOST);
+  for (index_type j = 0; j < num_rhs; ++j)
+  {
+    real_type* b_j = B.getData(j, memory::HOST);
+    std::copy(rhs, rhs + n, b_j);
+    b_j[(j * n) / num_rhs] += 1.0;
+  }
+  B.setDataUpdated(memory::HOST);
+  if (is_gpu)
+  {
+    A->syncData(memory::DEVICE);
+    B.syncData(memory::DEVICE);
+    X.allocate(memory::DEVICE);
+  }
+
+  int  num_failed = 0;
+  auto start      = std::chrono::steady_clock::now();
+  auto stop       = start;
+  if (is_gpu)
+  {
+    // Factorize the system once, the refactorization solver keeps its
+    // factors on the device and solves one column at a time
+    std::string refactor = (hw_backend == "CUDA") ? "cusolverrf" : "rocsolverrf";
+
+    ReSolve::SystemSolver solver(&workspace,
+                                 "klu",    // factorization
+                                 refactor, // refactorization
+                                 refactor, // triangular solve
+                                 "none",   // preconditioner
+                                 "none");  // iterative refinement
+
+    int status = solver.setMatrix(A);
+    if (status != 0)
+    {
+      std::cout << "Failed to set matrix in solver. Status: " << status << std::endl;
+      delete A;
+      delete[] rhs;
+      return 1;
+    }
+    status = solver.analyze();
+    std::cout << "Analysis on the host status: " << status << std::endl;
+    status = solver.factorize();
+    std::cout << "Numeric factorization on the host status: " << status << std::endl;
+    status = solver.refactorizationSetup();
+    std::cout << "Refactorization setup status: " << status << std::endl;
+
+    // Solve for all right-hand sides
+    start      = std::chrono::steady_clock::now();
+    num_failed = solveMultiRhs(solver, &B, &X, memspace);
+    stop       = std::chrono::steady_clock::now();
+  }
+  else
+  {
+    // Factorize the system once with KLU, whose factors are used directly
+    LinSolverDirectKLU KLU;
+    KLU.setup(A);
+    int status = KLU.analyze();
+    std::cout << "KLU analysis status: " << status << std::endl;
+    status = KLU.factorize();
+    std::cout << "KLU factorization status: " << status << std::endl;
+    if (status != 0)
+    {
+      delete A;
+      delete[] rhs;
+      return 1;
+    }
+
+    // Column-at-a-time solves for comparison
+    start      = std::chrono::steady_clock::now();
+    num_failed = solveMultiRhs(KLU, &B, &X, memspace);
+    stop       = std::chrono::steady_clock::now();
+    std::cout << "Solved " << num_rhs << " right-hand sides one at a time in "
+              << std::scientific << std::setprecision(3)
+              << std::chrono::duration<double>(stop - start).count() << " s\n";
+
+    // One sweep over the factors for the whole block
+    start  = std::chrono::steady_clock::now();
+    status = solveFactorsMultiRhs(KLU.getLFactor(),
+                                  KLU.getUFactor(),
+                                  KLU.getPOrdering(),
+                                  KLU.getQOrdering(),
+                                  &B,
+                                  &X);
+    stop   = std::chrono::steady_clock::now();
+    if (status != 0)
+    {
+      num_failed = num_rhs;
+    }
+  }
+  std::cout << "Solved " << num_rhs << " right-hand sides (" << num_failed << " failed) in "
+            << std::scientific << std::setprecision(3)
+            << std::chrono::duration<double>(stop - start).count() << " s\n";
+
+  // Check accuracy of each solution
+  vector_type b_j(n);
+  vector_type x_j(n);
+  real_type   max_residual = 0.0;
+  for (index_type j = 0; j < num_rhs; ++j)
+  {
+    b_j.setData(B.getData(j, memspace), memspace);
+    x_j.setData(X.getData(j, memspace), memspace);
+    b_j.setDataUpdated(memspace);
+    x_j.setDataUpdated(memspace);
+    helper.resetSystem(A, &b_j, &x_j);
+    max_residual = std::max(max_residual, helper.getNormRelativeResidual());
+  }
+  std::cout << "\tLargest relative residual norm: "
+            << std::scientific << std::setprecision(16) << max_residual << "\n";
+
+  delete A;
+  delete[] rhs;
+
+  return (num_failed == 0 && std::isfinite(max_residual)) ? 0 : 1;
+}
@@ -1,20 +1,30 @@
+#include <algorithm>
+#include <cmath>
 #include <iomanip>
 #include <iostream>
 #include <string>
+#include <type_traits>
+#include <vector>
 
-#include "ExampleHelper.hpp"
 #include <resolve/GramSchmidt.hpp>
 #include <resolve/LinSolverDirectCpuILU0.hpp>
 #include <resolve/LinSolverDirectSerialILU0.hpp>
+#include <resolve/LinSolverIterativeFGMRES.hpp>
 #include <resolve/LinSolverIterativeRandFGMRES.hpp>
 #include <resolve/matrix/Csr.hpp>
 #include <resolve/matrix/MatrixHandler.hpp>
 #include <resolve/matrix/io.hpp>
+#include <resolve/random/SketchingHandler.hpp>
 #include <resolve/utilities/params/CliOptions.hpp>
 #include <resolve/vector/Vector.hpp>
 #include <resolve/vector/VectorHandler.hpp>
 #include <resolve/workspace/LinAlgWorkspace.hpp>
 
+#include "Benchmark.hpp"
+#include "ExampleHelper.hpp"
+#include "GramSchmidtVariants.hpp"
+#include "ParallelIlu0.hpp"
+
 #ifdef RESOLVE_USE_HIP
 #include <resolve/LinSolverDirectRocSparseILU0.hpp>
 #endif
@@ -29,7 +39,139 @@ static void printUsage()
   std::cout << "Usage:\n";
   std::cout << "\t -m <matrix pathname> -r <rhs pathname>\n\n";
   std::cout << "Optional features:\n";
-  std::cout << "\t -h\tPrints this message.\n\n";
+  std::cout << "\t -h\tPrints this message.\n";
+  std::cout << "\t -s <cs|fwht> \tSelects sketching method: count sketch (default) or\n";
+  std::cout << "\t\t\tsubsampled fast Walsh-Hadamard transform.\n";
+  std::cout << "\t -b\tBenchmarks all sketching methods and non-randomized FGMRES, and\n";
+  std::cout << "\t\ttimes sketching and Gram-Schmidt orthogonalization separately.\n";
+  std::cout << "\t -R <num> \tNumber of benchmark repetitions (default 3).\n";
+  std::cout << "\t -t <num> \tUses multithreaded ILU0 with <num> threads as the CPU\n";
+  std::cout << "\t\t\tpreconditioner (level-scheduled triangular solves).\n";
+  std::cout << "\t -c <num> \tComputes multithreaded ILU0 with <num> Chow-Patel sweeps\n";
+  std::cout << "\t\t\tinstead of exact factorization (implies -t).\n\n";
+}
+
+/// Solver settings shared by the example and the benchmark
+static constexpr ReSolve::index_type restart = 150;
+
+/**
+ * @brief Solve A*x = rhs from zero initial guess with FGMRES type solver.
+ *
+ * @param[in]  solver     - iterative solver
+ * @param[in]  precond    - preconditioner, set up for A
+ * @param[in]  A          - system matrix
+ * @param[in]  rhs        - right-hand side
+ * @param[out] x          - solution
+ * @param[in]  memspace   - memory space of the system
+ * @param[out] setup_time - time spent in the solver setup [s]
+ * @param[out] solve_time - time spent in the solve [s]
+ * @return status returned by the solver
+ */
+static int solveSystem(ReSolve::LinSolverIterative* solver,
+                       ReSolve::LinSolverDirect*    precond,
+                       ReSolve::matrix::Csr*        A,
+                       ReSolve::vector::Vector*     rhs,
+                       ReSolve::vector::Vector*     x,
+                       ReSolve::memory::MemorySpace memspace,
+                       double&                      setup_time,
+                       double&                      solve_time)
+{
+  ReSolve::examples::PhaseTimer timer;
+
+  timer.start();
+  solver->setRestart(restart);
+  solver->setMaxit(2500);
+  solver->setTol(1e-12);
+  solver->setup(A);
+  solver->resetMatrix(A);
+  solver->setupPreconditioner("LU", precond);
+  solver->setFlexible(1);
+  setup_time = timer.stop();
+
+  x->setToZero(memspace);
+  timer.start();
+  int status = solver->solve(rhs, x);
+  solve_time = timer.stop();
+  return status;
+}
+
+/**
+ * @brief Sketch size randomized FGMRES uses for vectors of size n.
+ *
+ * Neither LinSolverIterativeRandFGMRES nor SketchingHandler reports the
+ * sketch size, so this repeats the choice made in
+ * LinSolverIterativeRandFGMRES::setup() and has to follow it if it changes.
+ *
+ * @param[in] method      - sketching method
+ * @param[in] n           - size of sketched vectors
+ * @param[in] restart_len - restart length the solver is set up with
+ * @return number of rows of the sketching operator
+ */
+static ReSolve::index_type sketchSize(ReSolve::LinSolverIterativeRandFGMRES::SketchingMethod method,
+                                      ReSolve::index_type                                    n,
+                                      ReSolve::index_type                                    restart_len)
+{
+  using namespace ReSolve;
+
+  real_type  log_n = std::log(static_cast<real_type>(n));
+  real_type  m     = static_cast<real_type>(restart_len);
+  index_type k     = (method == LinSolverIterativeRandFGMRES::cs)
+                       ? static_cast<index_type>(std::ceil(m * log_n))
+                       : static_cast<index_type>(std::ceil(2.0 * m * log_n / std::log(m)));
+  return std::min(k, n);
+}
+
+/**
+ * @brief Time one application of a sketching operator.
+ *
+ * Randomized FGMRES sketches every new Krylov vector once, so the time
+ * spent sketching in a solve is this time multiplied by the number of
+ * iterations.
+ *
+ * @param[in] method          - sketching method
+ * @param[in] n               - size of sketched vectors
+ * @param[in] k               - sketch size, see sketchSize()
+ * @param[in] devtype         - device the sketch runs on
+ * @param[in] memspace        - memory space of the vectors
+ * @param[in] num_repetitions - number of timed applications, minimum is returned
+ * @return time of one sketch application [s], 0 if the sketch cannot be set up
+ */
+static double timeSketch(ReSolve::LinSolverIterativeRandFGMRES::SketchingMethod method,
+                         ReSolve::index_type                                    n,
+                         ReSolve::index_type                                    k,
+                         ReSolve::memory::DeviceType                            devtype,
+                         ReSolve::memory::MemorySpace                           memspace,
+                         int                                                    num_repetitions)
+{
+  using namespace ReSolve;
+
+  SketchingHandler sketch(method, devtype);
+  if (sketch.setup(n, k) != 0)
+  {
+    return 0.0;
+  }
+  vector::Vector input(n);
+  vector::Vector output(k);
+  input.allocate(memspace);
+  output.allocate(memspace);
+  input.setToConst(constants::ONE, memspace);
+
+  examples::PhaseTimer timer;
+  double               best = 0.0;
+  for (int rep = 0; rep < num_repetitions; ++rep)
+  {
+    timer.start();
+    sketch.Theta(&input, &output);
+    double time = timer.stop();
+    best        = (rep == 0) ? time : std::min(best, time);
+  }
+  return best;
+}
+
+/// Minimum of the recorded times.
+static double minTime(const std::vector<double>& times)
+{
+  return *std::min_element(times.begin(), times.end());
 }
 
 /// Prototype of the example main function
@@ -40,9 +182,20 @@ int main(int argc, char* argv[])
 {
   int status = 0;
 
+  ReSolve::CliOptions options(argc, argv);
+  bool                is_parallel_ilu0 = options.hasKey("-t") || options.hasKey("-c");
+
   std::cout << "\n\nRunning randomized GMRES solver on CPU ...\n";
-  status += runGmresExample<ReSolve::LinAlgWorkspaceCpu,
-                            ReSolve::LinSolverDirectCpuILU0>(argc, argv);
+  if (is_parallel_ilu0)
+  {
+    status += runGmresExample<ReSolve::LinAlgWorkspaceCpu,
+                              ReSolve::examples::ParallelIlu0Cpu>(argc, argv);
+  }
+  else
+  {
+    status += runGmresExample<ReSolve::LinAlgWorkspaceCpu,
+                              ReSolve::LinSolverDirectCpuILU0>(argc, argv);
+  }
 
 #ifdef RESOLVE_USE_HIP
   std::cout << "\n\nRunning randomized GMRES solver on HIP device ...\n";
@@ -105,6 +258,31 @@ int runGmresExample(int argc, char* argv[])
     return 1;
   }
 
+  LinSolverIterativeRandFGMRES::SketchingMethod sketch = LinSolverIterativeRandFGMRES::cs;
+  opt                                                  = options.getParamFromKey("-s");
+  if (opt)
+  {
+    if (opt->second == "fwht")
+    {
+      sketch = LinSolverIterativeRandFGMRES::fwht;
+    }
+    else if (opt->second != "cs")
+    {
+      std::cout << "Unknown sketching method " << opt->second << "!\n";
+      printUsage();
+      return 1;
+    }
+  }
+
+  bool is_benchmark = options.hasKey("-b");
+
+  int num_repetitions = 3;
+  opt                 = options.getParamFromKey("-R");
+  if (opt)
+  {
+    num_repetitions = std::max(1, atoi((opt->second).c_str()));
+  }
+
   workspace_type workspace;
   workspace.initializeHandles();
 
@@ -119,20 +297,23 @@ int runGmresExample(int argc, char* argv[])
   precon_type                  Precond(&workspace);
   LinSolverIterativeRandFGMRES FGMRES(&matrix_handler,
                                       &vector_handler,
-                                      LinSolverIterativeRandFGMRES::cs,
+                                      sketch,
                                       &GS);
 
   // Set memory space where to run tests
   std::string         hwbackend = "CPU";
   memory::MemorySpace memspace  = memory::HOST;
+  memory::DeviceType  devtype   = memory::NONE;
   if (matrix_handler.getIsCudaEnabled())
   {
     memspace  = memory::DEVICE;
+    devtype   = memory::CUDADEVICE;
     hwbackend = "CUDA";
   }
   if (matrix_handler.getIsHipEnabled())
   {
     memspace  = memory::DEVICE;
+    devtype   = memory::HIPDEVICE;
     hwbackend = "HIP";
   }
 
@@ -170,24 +351,118 @@ int runGmresExample(int argc, char* argv[])
 
   matrix_handler.setValuesChanged(true, memspace);
 
+  if constexpr (std::is_same<precon_type, ParallelIlu0Cpu>::value)
+  {
+    opt = options.getParamFromKey("-t");
+    if (opt)
+    {
+      Precond.setNumThreads(atoi((opt->second).c_str()));
+    }
+    opt = options.getParamFromKey("-c");
+    if (opt)
+    {
+      Precond.setNumSweeps(atoi((opt->second).c_str()));
+    }
+  }
+
   Precond.setup(A);
-  FGMRES.setRestart(150);
-  FGMRES.setMaxit(2500);
-  FGMRES.setTol(1e-12);
-  FGMRES.setup(A);
 
-  FGMRES.resetMatrix(A);
-  FGMRES.setupPreconditioner("LU", &Precond);
-  FGMRES.setFlexible(1);
+  if constexpr (std::is_same<precon_type, ParallelIlu0Cpu>::value)
+  {
+    std::cout << "Multithreaded ILU0 with " << Precond.getNumThreads() << " threads, ";
+    if (Precond.getNumSweeps() > 0)
+    {
+      std::cout << Precond.getNumSweeps() << " Chow-Patel sweeps, ";
+    }
+    else
+    {
+      std::cout << "exact factorization, ";
+    }
+    std::cout << Precond.getNumLowerLevels() << " lower and "
+              << Precond.getNumUpperLevels() << " upper solve levels\n";
+  }
 
-  FGMRES.solve(vec_rhs, vec_x);
+  double setup_time = 0.0;
+  double solve_time = 0.0;
+  solveSystem(&FGMRES, &Precond, A, vec_rhs, vec_x, memspace, setup_time, solve_time);
 
   // Print summary of results
   helper.resetSystem(A, vec_rhs, vec_x);
-  std::cout << "\nRandomized GMRES result on " << hwbackend << "\n";
+  std::cout << "\nRandomized GMRES result on " << hwbackend
+            << " (" << (sketch == LinSolverIterativeRandFGMRES::cs ? "cs" : "fwht") << " sketch)\n";
   std::cout << "---------------------------------\n";
   helper.printIrSummary(&FGMRES);
 
+  if (is_benchmark)
+  {
+    // Solvers to compare; "none" is FGMRES with the full Krylov basis
+    const std::vector<std::string> names = {"cs", "fwht", "none"};
+
+    // Sketching time is estimated from standalone applications of the
+    // sketch, the rest of the solve is orthogonalization, matvecs and
+    // preconditioning
+    std::cout << "\nBenchmark on " << hwbackend << ", minimum over "
+              << num_repetitions << " repetitions\n";
+    std::cout << std::left << std::setw(8) << "sketch" << std::right
+              << std::setw(14) << "setup [s]" << std::setw(14) << "solve [s]"
+              << std::setw(14) << "sketch [s]" << std::setw(14) << "rest [s]"
+              << std::setw(8) << "iter" << std::setw(14) << "iter [s]"
+              << std::setw(14) << "rel. res." << "\n";
+    for (const std::string& name : names)
+    {
+      std::vector<double> setup_times;
+      std::vector<double> solve_times;
+      index_type          num_iter = 0;
+      for (int k = 0; k < num_repetitions; ++k)
+      {
+        LinSolverIterative* solver = nullptr;
+        if (name == "none")
+        {
+          solver = new LinSolverIterativeFGMRES(&matrix_handler, &vector_handler, &GS);
+        }
+        else
+        {
+          solver = new LinSolverIterativeRandFGMRES(&matrix_handler,
+                                                    &vector_handler,
+                                                    name == "cs" ? LinSolverIterativeRandFGMRES::cs
+                                                                 : LinSolverIterativeRandFGMRES::fwht,
+                                                    &GS);
+        }
+        solveSystem(solver, &Precond, A, vec_rhs, vec_x, memspace, setup_time, solve_time);
+        setup_times.push_back(setup_time);
+        solve_times.push_back(solve_time);
+        num_iter = solver->getNumIter();
+        delete solver;
+      }
+      double sketch_time = 0.0;
+      if (name != "none")
+      {
+        LinSolverIterativeRandFGMRES::SketchingMethod method = (name == "cs") ? LinSolverIterativeRandFGMRES::cs
+                                                                              : LinSolverIterativeRandFGMRES::fwht;
+        index_type k = sketchSize(method, A->getNumRows(), restart);
+        sketch_time  = num_iter * timeSketch(method, A->getNumRows(), k, devtype, memspace, num_repetitions);
+      }
+      helper.resetSystem(A, vec_rhs, vec_x);
+      std::cout << std::left << std::setw(8) << name << std::right
+                << std::scientific << std::setprecision(3)
+                << std::setw(14) << minTime(setup_times) << std::setw(14) << minTime(solve_times)
+                << std::setw(14) << sketch_time << std::setw(14) << minTime(solve_times) - sketch_time
+                << std::setw(8) << num_iter
+                << std::setw(14) << minTime(solve_times) / std::max(num_iter, 1)
+                << std::setw(14) << helper.getNormRelativeResidual() << "\n";
+    }
+
+    std::vector<double> ortho_times;
+    for (int k = 0; k < num_repetitions; ++k)
+    {
+      OrthogonalizationResult result =
+        timeOrthogonalization(&vector_handler, GramSchmidt::CGS2, A->getNumRows(), restart, memspace);
+      ortho_times.push_back(result.time_per_step);
+    }
+    std::cout << "CGS2 orthogonalization of full basis, per iteration [s]: "
+              << minTime(ortho_times) << "\n";
+  }
+
   delete A;
   delete vec_rhs;
   delete vec_x;
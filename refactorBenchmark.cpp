@@ -0,0 +1,549 @@
+/**
+ * @file refactorBenchmark.cpp
+ *
+ * @brief Benchmark of solver phases for a series of linear systems.
+ *
+ * A series of linear systems is read from files specified at command line
+ * input and solved with the refactorization approach, as in sysRefactor and
+ * gpuRefactor examples. The first system is analyzed and factorized with
+ * KLU, the second one is factorized and used to set up the refactorization
+ * solver, and all subsequent systems are refactorized. The whole series is
+ * solved repeatedly and time spent in each phase (file input, analysis,
+ * factorization, refactorization setup, refactorization, triangular solve
+ * and iterative refinement) is recorded for every system. Minimum, median
+ * and 99th percentile over repetitions are reported and optionally written
+ * to a JSON or CSV file, so results can be compared across Re::Solve
+ * versions and backends without a profiler. With a baseline JSON file from
+ * an earlier run, the benchmark fails if a phase got slower or iterative
+ * refinement needs more iterations than the given tolerances allow.
+ *
+ */
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <type_traits>
+
+#include <resolve/GramSchmidt.hpp>
+#include <resolve/LinSolverDirectKLU.hpp>
+#include <resolve/LinSolverIterativeFGMRES.hpp>
+#include <resolve/matrix/Csc.hpp>
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/MatrixHandler.hpp>
+#include <resolve/matrix/io.hpp>
+#include <resolve/utilities/params/CliOptions.hpp>
+#include <resolve/vector/Vector.hpp>
+#include <resolve/vector/VectorHandler.hpp>
+#include <resolve/workspace/LinAlgWorkspace.hpp>
+
+#ifdef RESOLVE_USE_CUDA
+#include <resolve/LinSolverDirectCuSolverRf.hpp>
+#endif
+#ifdef RESOLVE_USE_HIP
+#include <resolve/LinSolverDirectRocSolverRf.hpp>
+#endif
+
+#include "Benchmark.hpp"
+#include "BinarySequence.hpp"
+#include "CsrValueUpdater.hpp"
+#include "ExampleHelper.hpp"
+
+/// Prints help message describing system usage.
+void printHelpInfo()
+{
+  std::cout << "\nrefactorBenchmark.exe loads from files and solves a series of linear systems\n";
+  std::cout << "repeatedly, and reports time spent in each solver phase.\n\n";
+  std::cout << "System matrices are in files with names <pathname>XX.mtx, where XX are\n";
+  std::cout << "consecutive integer numbers 00, 01, 02, ...\n\n";
+  std::cout << "System right hand side vectors are stored in files with matching numbering\n";
+  std::cout << "and file extension.\n\n";
+  std::cout << "Usage:\n\t./";
+  std::cout << "refactorBenchmark.exe -m <matrix pathname> -r <rhs pathname> -n <number of systems>\n\n";
+  std::cout << "Optional features:\n";
+  std::cout << "\t-b <cpu|cuda|hip> \tSelects hardware backend.\n";
+  std::cout << "\t-c <file> \tCompares results with baseline JSON file written with -o and\n";
+  std::cout << "\t\t\tfails on regression.\n";
+  std::cout << "\t-e <ext> \tSelects custom extension for input files (default 'mtx').\n";
+  std::cout << "\t-f <mtx|bin> \tSelects input format (default 'mtx'). With 'bin', -m is a binary\n";
+  std::cout << "\t\t\tsequence file created by mtxToBin.exe and -r is not used.\n";
+  std::cout << "\t-h\tPrints this message.\n";
+  std::cout << "\t-i\tEnables iterative refinement.\n";
+  std::cout << "\t-I <int> \tAdditional iterative refinement iterations allowed per system\n";
+  std::cout << "\t\t\twhen comparing with baseline (default 1).\n";
+  std::cout << "\t-w <int> \tNumber of warmup repetitions, not recorded (default 1).\n";
+  std::cout << "\t-R <int> \tNumber of recorded repetitions (default 5).\n";
+  std::cout << "\t-o <file> \tWrites results to file; CSV if the name ends with '.csv',\n";
+  std::cout << "\t\t\tJSON otherwise.\n";
+  std::cout << "\t-t <tag> \tLabel stored with the results (e.g. Re::Solve version).\n";
+  std::cout << "\t-T <real> \tAllowed relative slowdown of a phase when comparing with\n";
+  std::cout << "\t\t\tbaseline (default 0.2).\n\n";
+}
+
+/// Prototype of the benchmark function
+template <class workspace_type, class refactor_type>
+static int refactorBenchmark(int argc, char* argv[]);
+
+/// Main function selects benchmark to be run.
+int main(int argc, char* argv[])
+{
+  ReSolve::CliOptions options(argc, argv);
+
+  // If help flag is passed, print help message and return
+  bool is_help = options.hasKey("-h");
+  if (is_help)
+  {
+    printHelpInfo();
+    return 0;
+  }
+
+  // Select hardware backend, default to CPU if no -b option is passed
+  auto opt = options.getParamFromKey("-b");
+  if (!opt)
+  {
+    std::cout << "No backend option provided. Defaulting to CPU.\n";
+    return refactorBenchmark<ReSolve::LinAlgWorkspaceCpu,
+                             ReSolve::LinSolverDirectKLU>(argc, argv);
+  }
+#ifdef RESOLVE_USE_CUDA
+  else if (opt->second == "cuda")
+  {
+    return refactorBenchmark<ReSolve::LinAlgWorkspaceCUDA,
+                             ReSolve::LinSolverDirectCuSolverRf>(argc, argv);
+  }
+#endif
+#ifdef RESOLVE_USE_HIP
+  else if (opt->second == "hip")
+  {
+    return refactorBenchmark<ReSolve::LinAlgWorkspaceHIP,
+                             ReSolve::LinSolverDirectRocSolverRf>(argc, argv);
+  }
+#endif
+  else if (opt->second == "cpu")
+  {
+    return refactorBenchmark<ReSolve::LinAlgWorkspaceCpu,
+                             ReSolve::LinSolverDirectKLU>(argc, argv);
+  }
+  else
+  {
+    std::cout << "Re::Solve is not built with support for " << opt->second;
+    std::cout << " backend.\n";
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ * @brief Benchmark of solver phases for a series of linear systems
+ *
+ * @tparam workspace_type - Type of the workspace to use
+ * @tparam refactor_type  - Refactorization solver; with KLU the
+ * refactorization is done on the host by the factorization solver itself
+ * @param[in] argc - Number of command line arguments
+ * @param[in] argv - Command line arguments
+ * @return 0 if the benchmark ran successfully, 1 otherwise
+ */
+template <class workspace_type, class refactor_type>
+int refactorBenchmark(int argc, char* argv[])
+{
+  using namespace ReSolve::examples;
+  using namespace ReSolve;
+  using index_type  = ReSolve::index_type;
+  using vector_type = ReSolve::vector::Vector;
+
+  constexpr bool is_klu_refactor = std::is_same<refactor_type, LinSolverDirectKLU>::value;
+
+  CliOptions options(argc, argv);
+
+  bool is_iterative_refinement = options.hasKey("-i");
+
+  index_type num_systems = 0;
+  auto       opt         = options.getParamFromKey("-n");
+  if (opt)
+  {
+    num_systems = atoi((opt->second).c_str());
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string matrix_pathname("");
+  opt = options.getParamFromKey("-m");
+  if (opt)
+  {
+    matrix_pathname = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string file_format("mtx");
+  opt = options.getParamFromKey("-f");
+  if (opt)
+  {
+    file_format = opt->second;
+  }
+  bool is_binary = (file_format == "bin");
+
+  std::string rhs_pathname("");
+  opt = options.getParamFromKey("-r");
+  if (opt)
+  {
+    rhs_pathname = opt->second;
+  }
+  else if (!is_binary)
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string file_extension("mtx");
+  opt = options.getParamFromKey("-e");
+  if (opt)
+  {
+    file_extension = opt->second;
+  }
+
+  int num_warmup = 1;
+  opt            = options.getParamFromKey("-w");
+  if (opt)
+  {
+    num_warmup = atoi((opt->second).c_str());
+  }
+
+  int num_repetitions = 5;
+  opt                 = options.getParamFromKey("-R");
+  if (opt)
+  {
+    num_repetitions = atoi((opt->second).c_str());
+  }
+  if (num_warmup < 0 || num_repetitions < 1)
+  {
+    std::cout << "Incorrect number of repetitions!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  std::string output_file_name("");
+  opt = options.getParamFromKey("-o");
+  if (opt)
+  {
+    output_file_name = opt->second;
+  }
+
+  std::string tag("");
+  opt = options.getParamFromKey("-t");
+  if (opt)
+  {
+    tag = opt->second;
+  }
+
+  std::string baseline_file_name("");
+  opt = options.getParamFromKey("-c");
+  if (opt)
+  {
+    baseline_file_name = opt->second;
+  }
+
+  double time_tolerance = 0.2;
+  opt                   = options.getParamFromKey("-T");
+  if (opt)
+  {
+    time_tolerance = atof((opt->second).c_str());
+  }
+
+  index_type iteration_tolerance = 1;
+  opt                            = options.getParamFromKey("-I");
+  if (opt)
+  {
+    iteration_tolerance = atoi((opt->second).c_str());
+  }
+  if (time_tolerance < 0.0 || iteration_tolerance < 0)
+  {
+    std::cout << "Incorrect tolerance!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  // Map binary sequence file, if one is used
+  BinarySequenceReader sequence;
+  if (is_binary)
+  {
+    if (sequence.open(matrix_pathname) != 0)
+    {
+      return 1;
+    }
+    if (num_systems > sequence.getNumSystems())
+    {
+      std::cout << "Binary sequence contains only " << sequence.getNumSystems() << " systems.\n";
+      num_systems = sequence.getNumSystems();
+    }
+  }
+  if (num_systems < 1)
+  {
+    std::cout << "Incorrect input!\n\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  // Create workspace
+  workspace_type workspace;
+  workspace.initializeHandles();
+
+  // Create a helper object (computing errors, printing summaries, etc.)
+  ExampleHelper<workspace_type> helper(workspace);
+  std::string                   hw_backend = helper.getHardwareBackend();
+  std::cout << "refactorBenchmark with " << hw_backend << " backend\n";
+
+  // KLU refactorization runs on the host, the other solvers on the device
+  bool is_gpu = !is_klu_refactor;
+
+  // Create matrix and vector handlers
+  MatrixHandler matrix_handler(&workspace);
+  VectorHandler vector_handler(&workspace);
+
+  BenchmarkRecorder recorder;
+  recorder.setInfo("benchmark", "refactorBenchmark");
+  recorder.setInfo("backend", hw_backend);
+  recorder.setInfo("matrix", matrix_pathname);
+  recorder.setInfo("format", is_binary ? "bin" : "mtx");
+  recorder.setInfo("systems", std::to_string(num_systems));
+  recorder.setInfo("warmup", std::to_string(num_warmup));
+  recorder.setInfo("iterative_refinement", is_iterative_refinement ? "yes" : "no");
+  recorder.setInfo("tag", tag);
+
+  PhaseTimer timer;
+  int        num_failed = 0;
+
+  for (int rep = 0; rep < num_warmup + num_repetitions; ++rep)
+  {
+    bool is_warmup = (rep < num_warmup);
+    recorder.setRecording(!is_warmup);
+    recorder.beginRepetition();
+    std::cout << (is_warmup ? "Warmup " : "Repetition ") << (is_warmup ? rep : rep - num_warmup) << "\n";
+
+    // Solvers are created anew, so every repetition starts from the same state
+    LinSolverDirectKLU             KLU;
+    std::unique_ptr<refactor_type> rf_owner;
+    refactor_type*                 Rf = nullptr;
+    if constexpr (is_klu_refactor)
+    {
+      Rf = &KLU;
+    }
+    else
+    {
+      rf_owner.reset(new refactor_type(&workspace));
+      Rf = rf_owner.get();
+    }
+    GramSchmidt              GS(&vector_handler, GramSchmidt::CGS2);
+    LinSolverIterativeFGMRES FGMRES(&matrix_handler, &vector_handler, &GS);
+
+    matrix::Csr*    A       = nullptr;
+    vector_type*    vec_rhs = nullptr;
+    vector_type*    vec_x   = nullptr;
+    CsrValueUpdater value_updater;
+
+    for (index_type i = 0; i < num_systems; ++i)
+    {
+      timer.start();
+      if (is_binary)
+      {
+        if (i == 0)
+        {
+          A       = sequence.createCsr(i);
+          vec_rhs = sequence.createVector(i);
+        }
+        else
+        {
+          if (sequence.updateMatrix(i, A) != 0)
+          {
+            return 1;
+          }
+          if (sequence.updateVector(i, vec_rhs) != 0)
+          {
+            return 1;
+          }
+        }
+      }
+      else
+      {
+        std::ostringstream matname;
+        std::ostringstream rhsname;
+        matname << matrix_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
+        rhsname << rhs_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
+        std::string matrix_pathname_full = matname.str();
+        std::string rhs_pathname_full    = rhsname.str();
+
+        std::ifstream mat_file(matrix_pathname_full);
+        if (!mat_file.is_open())
+        {
+          std::cout << "Failed to open file " << matrix_pathname_full << "\n";
+          return 1;
+        }
+        std::ifstream rhs_file(rhs_pathname_full);
+        if (!rhs_file.is_open())
+        {
+          std::cout << "Failed to open file " << rhs_pathname_full << "\n";
+          return 1;
+        }
+        bool is_expand_symmetric = true;
+        if (i == 0)
+        {
+          A       = io::createCsrFromFile(mat_file, is_expand_symmetric);
+          vec_rhs = io::createVectorFromFile(rhs_file);
+          value_updater.setup(mat_file, A);
+        }
+        else
+        {
+          if (value_updater.update(mat_file, A) != 0)
+          {
+            return 1;
+          }
+          io::updateVectorFromFile(rhs_file, vec_rhs);
+        }
+        mat_file.close();
+        rhs_file.close();
+      }
+      if (i == 0)
+      {
+        vec_x = new vector_type(A->getNumRows());
+        vec_x->allocate(memory::HOST);
+        if (is_gpu)
+        {
+          vec_x->allocate(memory::DEVICE);
+        }
+      }
+      if (is_gpu)
+      {
+        A->syncData(memory::DEVICE);
+        vec_rhs->syncData(memory::DEVICE);
+      }
+      recorder.record(i, "input", timer.stop());
+
+      int status = 0;
+      if (i == 0)
+      {
+        timer.start();
+        KLU.setup(A);
+        status += KLU.analyze();
+        recorder.record(i, "analyze", timer.stop());
+      }
+
+      if (i < 2)
+      {
+        timer.start();
+        status += KLU.factorize();
+        recorder.record(i, "factorize", timer.stop());
+
+        timer.start();
+        status += KLU.solve(vec_rhs, vec_x);
+        recorder.record(i, "solve", timer.stop());
+
+        // Second system sets up the refactorization and refinement solvers
+        if (i == 1)
+        {
+          timer.start();
+          if constexpr (!is_klu_refactor)
+          {
+            status += Rf->setup(A,
+                                (matrix::Csc*) KLU.getLFactor(),
+                                (matrix::Csc*) KLU.getUFactor(),
+                                KLU.getPOrdering(),
+                                KLU.getQOrdering(),
+                                vec_rhs);
+          }
+          if (is_iterative_refinement)
+          {
+            FGMRES.setup(A);
+            FGMRES.setupPreconditioner("LU", Rf);
+          }
+          recorder.record(i, "refactorizationSetup", timer.stop());
+        }
+      }
+      else
+      {
+        timer.start();
+        status += Rf->refactorize();
+        recorder.record(i, "refactorize", timer.stop());
+
+        timer.start();
+        status += Rf->solve(vec_rhs, vec_x);
+        recorder.record(i, "solve", timer.stop());
+
+        if (is_iterative_refinement)
+        {
+          timer.start();
+          FGMRES.resetMatrix(A);
+          status += FGMRES.solve(vec_rhs, vec_x);
+          recorder.record(i, "ir", timer.stop());
+          recorder.setIterations(i, FGMRES.getNumIter());
+        }
+      }
+
+      if (status != 0)
+      {
+        std::cout << "System " << i << " solver status: " << status << "\n";
+        ++num_failed;
+      }
+
+      // Accuracy of the last repetition is stored with the timings
+      if (rep == num_warmup + num_repetitions - 1)
+      {
+        helper.setValuesChanged();
+        helper.resetSystem(A, vec_rhs, vec_x);
+        recorder.setResidual(i, helper.getNormRelativeResidual());
+      }
+    } // for (index_type i = 0; i < num_systems; ++i)
+
+    delete A;
+    delete vec_rhs;
+    delete vec_x;
+  } // for (int rep = 0; rep < num_warmup + num_repetitions; ++rep)
+
+  std::cout << "\n";
+  recorder.printSummary();
+
+  int status = 0;
+  if (!output_file_name.empty())
+  {
+    bool is_csv = (output_file_name.size() >= 4)
+                  && (output_file_name.compare(output_file_name.size() - 4, 4, ".csv") == 0);
+    status = is_csv ? recorder.writeCsv(output_file_name) : recorder.writeJson(output_file_name);
+    if (status == 0)
+    {
+      std::cout << "Results written to " << output_file_name << "\n";
+    }
+  }
+
+  // Phases shorter than this are dominated by timer and launch overhead
+  constexpr double min_checked_time = 1.0e-4;
+
+  int num_regressions = 0;
+  if (!baseline_file_name.empty())
+  {
+    std::cout << "\nComparison with baseline " << baseline_file_name << "\n";
+    num_regressions = recorder.compareWithBaseline(baseline_file_name,
+                                                   time_tolerance,
+                                                   iteration_tolerance,
+                                                   min_checked_time);
+    if (num_regressions > 0)
+    {
+      std::cout << "Performance regression in " << num_regressions << " checks.\n";
+    }
+    else if (num_regressions == 0)
+    {
+      std::cout << "No performance regression.\n";
+    }
+  }
+
+  return (status == 0 && num_failed == 0 && num_regressions == 0) ? 0 : 1;
+}
@@ -0,0 +1,459 @@
+/**
+ * @file solverService.cpp
+ *
+ * @brief Long-lived solver service receiving linear systems over pipes.
+ *
+ * The service waits for clients on a pair of named pipes. A client sends
+ * the sparsity pattern once, followed by matrix values and right-hand sides
+ * of a series of systems, and receives the solution of each system before
+ * sending the next one. Factorization state is kept between systems (and
+ * between clients), so systems with an unchanged sparsity pattern are
+ * solved with refactorization, without process startup or file input on
+ * the latency path.
+ *
+ * The same executable acts as a client feeding systems from a binary
+ * sequence file (created by mtxToBin.exe) to a running service.
+ */
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "BinarySequence.hpp"
+#include "ExampleHelper.hpp"
+#include "PatternFingerprint.hpp"
+#include "SolverService.hpp"
+#include <resolve/LinSolverDirectKLU.hpp>
+#include <resolve/SystemSolver.hpp>
+#include <resolve/matrix/Csr.hpp>
+#include <resolve/matrix/MatrixHandler.hpp>
+#include <resolve/utilities/params/CliOptions.hpp>
+#include <resolve/vector/Vector.hpp>
+#include <resolve/vector/VectorHandler.hpp>
+#include <resolve/workspace/LinAlgWorkspace.hpp>
+
+/// Prints help message describing system usage.
+void printHelpInfo()
+{
+  std::cout << "\nsolverService.exe solves linear systems received over named pipes.\n\n";
+  std::cout << "The service creates pipes <channel>.req and <channel>.sol and serves\n";
+  std::cout << "clients one after another until a client asks it to shut down.\n\n";
+  std::cout << "Usage:\n";
+  std::cout << "\tService: ./solverService.exe -c <channel> [-b <cpu|cuda|hip>] [-i]\n";
+  std::cout << "\tClient:  ./solverService.exe -c <channel> -s <binary sequence file> [-n <num>] [-x]\n\n";
+  std::cout << "Optional features:\n";
+  std::cout << "\t-b <cpu|cuda|hip> \tSelects hardware backend of the service.\n";
+  std::cout << "\t-h\tPrints this message.\n";
+  std::cout << "\t-i\tEnables iterative refinement in the service.\n";
+  std::cout << "\t-n <num> \tNumber of systems sent by the client (default: all in the file).\n";
+  std::cout << "\t-s <pathname> \tRuns as client sending systems from a binary sequence file.\n";
+  std::cout << "\t-x\tClient asks the service to shut down when done.\n\n";
+}
+
+/// Prototype of the service function
+template <class workspace_type>
+static int solverService(int argc, char* argv[]);
+
+/// Prototype of the client function
+static int solverClient(int argc, char* argv[]);
+
+/// Main function selects service backend or client mode.
+int main(int argc, char* argv[])
+{
+  ReSolve::CliOptions options(argc, argv);
+
+  bool is_help = options.hasKey("-h");
+  if (is_help)
+  {
+    printHelpInfo();
+    return 0;
+  }
+
+  // A client closing its pipe early must not terminate the service
+  std::signal(SIGPIPE, SIG_IGN);
+
+  if (options.getParamFromKey("-s"))
+  {
+    return solverClient(argc, argv);
+  }
+
+  // Select hardware backend, default to CPU if no -b option is passed
+  auto opt = options.getParamFromKey("-b");
+  if (!opt)
+  {
+    std::cout << "No backend option provided. Defaulting to CPU.\n";
+    return solverService<ReSolve::LinAlgWorkspaceCpu>(argc, argv);
+  }
+#ifdef RESOLVE_USE_CUDA
+  else if (opt->second == "cuda")
+  {
+    return solverService<ReSolve::LinAlgWorkspaceCUDA>(argc, argv);
+  }
+#endif
+#ifdef RESOLVE_USE_HIP
+  else if (opt->second == "hip")
+  {
+    return solverService<ReSolve::LinAlgWorkspaceHIP>(argc, argv);
+  }
+#endif
+  else if (opt->second == "cpu")
+  {
+    return solverService<ReSolve::LinAlgWorkspaceCpu>(argc, argv);
+  }
+
+  std::cout << "Re::Solve is not built with support for " << opt->second;
+  std::cout << "backend.\n";
+  return 1;
+}
+
+/**
+ * @brief Solver service keeping factorization state between requests.
+ *
+ * @tparam workspace_type - Type of the workspace to use
+ * @param[in] argc - Number of command line arguments
+ * @param[in] argv - Command line arguments
+ * @return 0 if the service shut down as requested, 1 otherwise
+ */
+template <class workspace_type>
+int solverService(int argc, char* argv[])
+{
+  using namespace ReSolve::examples;
+  using namespace ReSolve;
+  using index_type  = ReSolve::index_type;
+  using vector_type = ReSolve::vector::Vector;
+
+  CliOptions options(argc, argv);
+
+  bool is_iterative_refinement = options.hasKey("-i");
+
+  std::string channel_name("");
+  auto        opt = options.getParamFromKey("-c");
+  if (opt)
+  {
+    channel_name = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  int status = 0;
+
+  workspace_type workspace;
+  workspace.initializeHandles();
+
+  // Create a helper object (computing residuals)
+  ExampleHelper<workspace_type> helper(workspace);
+  std::string                   hw_backend = helper.getHardwareBackend();
+  bool                          is_gpu     = (hw_backend == "CUDA" || hw_backend == "HIP");
+  std::cout << "solverService with " << hw_backend << " backend\n";
+
+  // Create system solver
+  std::string refactor("klu");
+  if (hw_backend == "CUDA")
+  {
+    refactor = "cusolverrf";
+  }
+  else if (hw_backend == "HIP")
+  {
+    refactor = "rocsolverrf";
+  }
+
+  // Disable iterative refinement for CPU backend, as in sysRefactor
+  if (!is_gpu)
+  {
+    is_iterative_refinement = false;
+  }
+
+  // Refactorization is set up again only on a new solver, see
+  // renewRefactorizationSolver() in RefactorizationFactors.hpp
+  std::unique_ptr<ReSolve::SystemSolver> solver;
+
+  auto createSolver = [&]()
+  {
+    solver = std::make_unique<ReSolve::SystemSolver>(&workspace,
+                                                     "klu",    // factorization
+                                                     refactor, // refactorization
+                                                     refactor, // triangular solve
+                                                     "none",   // preconditioner (always 'none' here)
+                                                     "none");  // iterative refinement
+    if (is_iterative_refinement)
+    {
+      solver->setRefinementMethod("fgmres", "cgs2");
+      solver->getIterativeSolver().setCliParam("restart", "100");
+    }
+  };
+  createSolver();
+
+  // Linear system received from clients
+  matrix::Csr* A       = nullptr;
+  vector_type* vec_rhs = nullptr;
+  vector_type* vec_x   = nullptr;
+
+  // Sparsity pattern of the previous system and factorization state
+  PatternFingerprint fingerprint;
+  bool               is_refactorization_setup = false;
+  bool               is_refactorization_used  = false;
+
+  ServiceChannel channel;
+  bool           is_shutdown = false;
+  index_type     num_solved  = 0;
+  while (!is_shutdown)
+  {
+    std::cout << "Waiting for a client on " << ServiceChannel::getRequestPipeName(channel_name) << "\n";
+    if (channel.openService(channel_name) != 0)
+    {
+      status = 1;
+      break;
+    }
+
+    ServiceMessageHeader header;
+    while (channel.receiveHeader(header) == 0)
+    {
+      ServiceMessageType type = static_cast<ServiceMessageType>(header.type);
+      if (type == ServiceMessageType::shutdown)
+      {
+        is_shutdown = true;
+        break;
+      }
+      if (type == ServiceMessageType::pattern)
+      {
+        matrix::Csr* A_new = channel.receivePattern(header);
+        if (A_new == nullptr)
+        {
+          break;
+        }
+        // A returning client keeps the factorization of an unchanged pattern
+        if (A != nullptr && A->getNnz() == A_new->getNnz()
+            && PatternFingerprint::compute(A_new) == fingerprint.getValue())
+        {
+          delete A_new;
+          continue;
+        }
+        if (A == nullptr || A->getNumRows() != A_new->getNumRows())
+        {
+          delete vec_rhs;
+          delete vec_x;
+          vec_rhs = new vector_type(A_new->getNumRows());
+          vec_x   = new vector_type(A_new->getNumRows());
+          vec_rhs->allocate(memory::HOST);
+          vec_x->allocate(memory::HOST);
+          if (is_gpu)
+          {
+            vec_rhs->allocate(memory::DEVICE);
+            vec_x->allocate(memory::DEVICE);
+          }
+        }
+        delete A;
+        A = A_new;
+        fingerprint.reset();
+        continue;
+      }
+      if (type != ServiceMessageType::system || channel.receiveSystem(header, A, vec_rhs) != 0)
+      {
+        std::cout << "Unexpected request, disconnecting client.\n";
+        break;
+      }
+
+      // Values were received into host arrays
+      if (is_gpu)
+      {
+        A->syncData(memory::DEVICE);
+        vec_rhs->syncData(memory::DEVICE);
+      }
+      helper.setValuesChanged();
+
+      // Choose the cheapest valid factorization path for this system
+      bool is_new_pattern = fingerprint.update(A);
+      if (is_new_pattern)
+      {
+        std::cout << "New sparsity pattern " << A->getNumRows() << " x " << A->getNumRows()
+                  << ", nnz: " << A->getNnz() << ", doing symbolic analysis.\n";
+        if (is_refactorization_used)
+        {
+          createSolver();
+          is_refactorization_used = false;
+        }
+        status = solver->setMatrix(A);
+        status = (status == 0) ? solver->analyze() : status;
+        status = (status == 0) ? solver->factorize() : status;
+
+        is_refactorization_setup = false;
+      }
+      else if (!is_refactorization_setup)
+      {
+        status = 0;
+        if (is_refactorization_used)
+        {
+          // A previous setup failed, so start over on a new solver
+          createSolver();
+          status = solver->setMatrix(A);
+          status = (status == 0) ? solver->analyze() : status;
+        }
+        status = (status == 0) ? solver->factorize() : status;
+        if (status != 0)
+        {
+          // Symbolic analysis is no longer adequate, redo it
+          status = solver->analyze();
+          status = (status == 0) ? solver->factorize() : status;
+        }
+        if (status == 0)
+        {
+          status                  = solver->refactorizationSetup();
+          is_refactorization_used = true;
+        }
+        is_refactorization_setup = (status == 0);
+      }
+      else
+      {
+        status = solver->refactorize();
+        if (status != 0)
+        {
+          // Pivoting needs to be redone. The new solver has no symbolic
+          // analysis, since SystemSolver does not expose its KLU solver.
+          std::cout << "Refactorization failed, redoing factorization.\n";
+          createSolver();
+          status                   = solver->setMatrix(A);
+          status                   = (status == 0) ? solver->analyze() : status;
+          status                   = (status == 0) ? solver->factorize() : status;
+          status                   = (status == 0) ? solver->refactorizationSetup() : status;
+          is_refactorization_setup = (status == 0);
+        }
+      }
+
+      if (status == 0)
+      {
+        status = solver->solve(vec_rhs, vec_x);
+      }
+      else
+      {
+        vec_x->setToZero(memory::HOST);
+        vec_x->setDataUpdated(memory::HOST);
+      }
+
+      helper.resetSystem(A, vec_rhs, vec_x);
+      double residual_norm = helper.getNormRelativeResidual();
+
+      vec_x->syncData(memory::HOST);
+      if (channel.sendSolution(status, residual_norm, vec_x) != 0)
+      {
+        std::cout << "Failed to send solution, disconnecting client.\n";
+        break;
+      }
+      ++num_solved;
+    }
+    channel.close();
+    std::cout << "Client disconnected, " << num_solved << " systems solved so far.\n";
+  }
+
+  delete A;
+  delete vec_x;
+  delete vec_rhs;
+
+  return status;
+}
+
+/**
+ * @brief Client sending systems from a binary sequence file to the service.
+ *
+ * Matrix values and right-hand sides are sent directly from the mapped
+ * file. Round trip time of each system is reported.
+ *
+ * @param[in] argc - Number of command line arguments
+ * @param[in] argv - Command line arguments
+ * @return 0 if all systems were solved, 1 otherwise
+ */
+int solverClient(int argc, char* argv[])
+{
+  using namespace ReSolve::examples;
+  using namespace ReSolve;
+  using index_type = ReSolve::index_type;
+  using real_type  = ReSolve::real_type;
+
+  CliOptions options(argc, argv);
+
+  bool is_shutdown = options.hasKey("-x");
+
+  std::string channel_name("");
+  auto        opt = options.getParamFromKey("-c");
+  if (opt)
+  {
+    channel_name = opt->second;
+  }
+  else
+  {
+    std::cout << "Incorrect input!\n";
+    printHelpInfo();
+    return 1;
+  }
+
+  BinarySequenceReader sequence;
+  if (sequence.open(options.getParamFromKey("-s")->second) != 0)
+  {
+    return 1;
+  }
+
+  index_type num_systems = sequence.getNumSystems();
+  opt                    = options.getParamFromKey("-n");
+  if (opt)
+  {
+    num_systems = std::min(num_systems, static_cast<index_type>(atoi((opt->second).c_str())));
+  }
+
+  ServiceChannel channel;
+  if (channel.openClient(channel_name) != 0)
+  {
+    return 1;
+  }
+
+  index_type n   = sequence.getNumRows();
+  index_type nnz = sequence.getNnz();
+  if (channel.sendPattern(n, nnz, sequence.getRowData(), sequence.getColData()) != 0)
+  {
+    std::cout << "Failed to send sparsity pattern to the solver service.\n";
+    return 1;
+  }
+
+  std::vector<real_type> x(n);
+  int                    status     = 0;
+  double                 total_time = 0.0;
+  std::cout << std::setw(8) << "system" << std::setw(8) << "status"
+            << std::setw(16) << "residual" << std::setw(14) << "time [ms]" << "\n";
+  for (index_type i = 0; i < num_systems; ++i)
+  {
+    int    solver_status = 0;
+    double residual_norm = 0.0;
+
+    auto start = std::chrono::steady_clock::now();
+    if (channel.sendSystem(n, nnz, sequence.getValues(i), sequence.getRhs(i)) != 0
+        || channel.receiveSolution(n, x.data(), solver_status, residual_norm) != 0)
+    {
+      return 1;
+    }
+    double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    sequence.prefetch(i + 1);
+
+    total_time += time;
+    status = (solver_status != 0) ? 1 : status;
+    std::cout << std::setw(8) << i << std::setw(8) << solver_status
+              << std::scientific << std::setprecision(4) << std::setw(16) << residual_norm
+              << std::fixed << std::setprecision(3) << std::setw(14) << 1000.0 * time << "\n";
+  }
+  if (num_systems > 0)
+  {
+    std::cout << "Average round trip time: " << std::fixed << std::setprecision(3)
+              << 1000.0 * total_time / num_systems << " ms\n";
+  }
+
+  if (is_shutdown)
+  {
+    channel.sendShutdown();
+  }
+  return status;
+}
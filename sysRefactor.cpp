@@ -1,10 +1,17 @@
 #include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 
+#include "BinarySequence.hpp"
+#include "CsrValueUpdater.hpp"
 #include "ExampleHelper.hpp"
+#include "GramSchmidtVariants.hpp"
+#include "PatternFingerprint.hpp"
+#include "RangeTimer.hpp"
+#include "SystemPrefetcher.hpp"
 #include <resolve/LinSolverDirectKLU.hpp>
 #include <resolve/Profiling.hpp>
 #include <resolve/SystemSolver.hpp>
@@ -31,8 +38,14 @@ void printHelpInfo()
   std::cout << "Optional features:\n";
   std::cout << "\t-b <cpu|cuda|hip> \tSelects hardware backend.\n";
   std::cout << "\t-e <ext> \tSelects custom extension for input files (default 'mtx').\n";
+  std::cout << "\t-f <mtx|bin> \tSelects input format (default 'mtx'). With 'bin', -m is a binary\n";
+  std::cout << "\t\t\tsequence file created by mtxToBin.exe and -r is not used.\n";
+  std::cout << "\t-g <variant> \tSelects Gram-Schmidt variant for iterative refinement: cgs2\n";
+  std::cout << "\t\t\t(default), mgs, mgs_two_sync, mgs_pm or cgs1.\n";
   std::cout << "\t-h\tPrints this message.\n";
-  std::cout << "\t-i\tEnables iterative refinement.\n\n";
+  std::cout << "\t-i\tEnables iterative refinement.\n";
+  std::cout << "\t-p\tReads the next system in the background while the current one is solved\n";
+  std::cout << "\t\t(Matrix Market input only).\n\n";
 }
 
 using namespace ReSolve::constants;
@@ -140,18 +153,41 @@ int sysRefactor(int argc, char* argv[])
     printHelpInfo();
   }
 
+  std::string file_format("mtx");
+  opt = options.getParamFromKey("-f");
+  if (opt)
+  {
+    file_format = opt->second;
+  }
+  bool is_binary = (file_format == "bin");
+
+  bool is_prefetch = options.hasKey("-p") && !is_binary;
+
   std::string rhs_pathname("");
   opt = options.getParamFromKey("-r");
   if (opt)
   {
     rhs_pathname = opt->second;
   }
-  else
+  else if (!is_binary)
   {
     std::cout << "Incorrect input!\n";
     printHelpInfo();
   }
 
+  std::string            gs_name("cgs2");
+  GramSchmidt::GSVariant gs_variant = GramSchmidt::CGS2;
+  opt                               = options.getParamFromKey("-g");
+  if (opt)
+  {
+    gs_name = opt->second;
+    if (getGramSchmidtVariant(gs_name, gs_variant) != 0)
+    {
+      printHelpInfo();
+      return 1;
+    }
+  }
+
   std::string file_extension("");
   opt = options.getParamFromKey("-e");
   if (opt)
@@ -163,6 +199,27 @@ int sysRefactor(int argc, char* argv[])
     file_extension = "mtx";
   }
 
+  // Background reader for the next system in the series
+  SystemPrefetcher prefetcher(matrix_pathname, rhs_pathname, file_extension);
+
+  // Cached positions of matrix file entries for value updates
+  CsrValueUpdater value_updater;
+
+  // Map binary sequence file, if one is used
+  BinarySequenceReader sequence;
+  if (is_binary)
+  {
+    if (sequence.open(matrix_pathname) != 0)
+    {
+      return 1;
+    }
+    if (num_systems > sequence.getNumSystems())
+    {
+      std::cout << "Binary sequence contains only " << sequence.getNumSystems() << " systems.\n";
+      num_systems = sequence.getNumSystems();
+    }
+  }
+
   std::cout << "Family matrix file name: " << matrix_pathname
             << ", total number of matrices: " << num_systems << "\n"
             << "Family rhs file name: " << rhs_pathname
@@ -201,76 +258,144 @@ int sysRefactor(int argc, char* argv[])
     refactor = "klu";
   }
 
-  ReSolve::SystemSolver solver(&workspace,
-                               "klu",    // factorization
-                               refactor, // refactorization
-                               refactor, // triangular solve
-                               "none",   // preconditioner (always 'none' here)
-                               "none");  // iterative refinement
-
   // Disable iterative refinement temporarily for CPU backend
   if (hw_backend == "CPU")
   {
     is_iterative_refinement = false;
   }
 
-  if (is_iterative_refinement)
+  // Refactorization is set up again only on a new solver, see
+  // renewRefactorizationSolver() in RefactorizationFactors.hpp
+  std::unique_ptr<ReSolve::SystemSolver> solver;
+
+  auto createSolver = [&]()
   {
-    solver.setRefinementMethod("fgmres", "cgs2");
-    solver.getIterativeSolver().setCliParam("restart", "100");
-    if (hw_backend == "CUDA")
+    solver = std::make_unique<ReSolve::SystemSolver>(&workspace,
+                                                     "klu",    // factorization
+                                                     refactor, // refactorization
+                                                     refactor, // triangular solve
+                                                     "none",   // preconditioner (always 'none' here)
+                                                     "none");  // iterative refinement
+    if (is_iterative_refinement)
     {
-      solver.getIterativeSolver().setTol(1e-17);
+      solver->setRefinementMethod("fgmres", gs_name);
+      solver->getIterativeSolver().setCliParam("restart", "100");
+      if (hw_backend == "CUDA")
+      {
+        solver->getIterativeSolver().setTol(1e-17);
+      }
     }
-  }
+  };
+  createSolver();
+
+  // Sparsity pattern of the previous system and factorization state
+  PatternFingerprint fingerprint;
+  bool               is_refactorization_setup = false;
+  bool               is_refactorization_used  = false;
+  bool               is_refactorized          = false;
 
   RESOLVE_RANGE_PUSH(__FUNCTION__);
   for (int i = 0; i < num_systems; ++i)
   {
     std::cout << "System " << i << ":\n";
     RESOLVE_RANGE_PUSH("File input");
-    std::ostringstream matname;
-    std::ostringstream rhsname;
-    matname << matrix_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
-    rhsname << rhs_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
-    std::string matrix_pathname_full = matname.str();
-    std::string rhs_pathname_full    = rhsname.str();
-
-    // Read matrix and right-hand-side vector
-    std::ifstream mat_file(matrix_pathname_full);
-    if (!mat_file.is_open())
+    std::string matrix_pathname_full;
+    if (is_binary)
     {
-      std::cout << "Failed to open file " << matrix_pathname_full << "\n";
-      return 1;
+      std::ostringstream sysname;
+      sysname << matrix_pathname << " (system " << i << ")";
+      matrix_pathname_full = sysname.str();
+
+      // Values are copied directly from the mapped file
+      if (i == 0)
+      {
+        A       = sequence.createCsr(i);
+        vec_rhs = sequence.createVector(i);
+      }
+      else
+      {
+        if (sequence.updateMatrix(i, A) != 0)
+        {
+          return 1;
+        }
+        if (sequence.updateVector(i, vec_rhs) != 0)
+        {
+          return 1;
+        }
+      }
+      sequence.prefetch(i + 1);
     }
-    std::ifstream rhs_file(rhs_pathname_full);
-    if (!rhs_file.is_open())
+    else if (is_prefetch && (i > 0))
     {
-      std::cout << "Failed to open file " << rhs_pathname_full << "\n";
-      return 1;
+      // System i was read in the background while system i-1 was solved
+      matrix_pathname_full = prefetcher.getMatrixFileName(i);
+      int update_status = prefetcher.update(i, A, vec_rhs);
+      if (update_status != 0 && update_status != CsrValueUpdater::PATTERN_CHANGED)
+      {
+        return 1;
+      }
+    }
+    else
+    {
+      std::ostringstream matname;
+      std::ostringstream rhsname;
+      matname << matrix_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
+      rhsname << rhs_pathname << std::setfill('0') << std::setw(2) << i << "." << file_extension;
+      matrix_pathname_full          = matname.str();
+      std::string rhs_pathname_full = rhsname.str();
+
+      // Read matrix and right-hand-side vector
+      std::ifstream mat_file(matrix_pathname_full);
+      if (!mat_file.is_open())
+      {
+        std::cout << "Failed to open file " << matrix_pathname_full << "\n";
+        return 1;
+      }
+      std::ifstream rhs_file(rhs_pathname_full);
+      if (!rhs_file.is_open())
+      {
+        std::cout << "Failed to open file " << rhs_pathname_full << "\n";
+        return 1;
+      }
+
+      // Refactorization is LU-based, so need to expand symmetric matrices
+      bool is_expand_symmetric = true;
+      if (i == 0)
+      {
+        A       = io::createCsrFromFile(mat_file, is_expand_symmetric);
+        vec_rhs = io::createVectorFromFile(rhs_file);
+        value_updater.setup(mat_file, A);
+      }
+      else
+      {
+        // Pattern changes are detected by the fingerprint below
+        int update_status = value_updater.update(mat_file, A);
+        if (update_status != 0 && update_status != CsrValueUpdater::PATTERN_CHANGED)
+        {
+          return 1;
+        }
+        io::updateVectorFromFile(rhs_file, vec_rhs);
+      }
+
+      mat_file.close();
+      rhs_file.close();
+    }
+
+    // Start reading the next system while this one is being solved
+    if (is_prefetch && (i + 1 < num_systems))
+    {
+      prefetcher.prefetch(i + 1);
     }
 
-    // Refactorization is LU-based, so need to expand symmetric matrices
-    bool is_expand_symmetric = true;
     if (i == 0)
     {
-      A       = ReSolve::io::createCsrFromFile(mat_file, is_expand_symmetric);
-      vec_rhs = ReSolve::io::createVectorFromFile(rhs_file);
-      vec_x   = new vector_type(A->getNumRows());
+      vec_x = new vector_type(A->getNumRows());
       vec_x->allocate(memory::HOST);
       if (hw_backend == "CUDA" || hw_backend == "HIP")
       {
         vec_x->allocate(memory::DEVICE);
       }
     }
-    else
-    {
-      ReSolve::io::updateMatrixFromFile(mat_file, A);
-      ReSolve::io::updateVectorFromFile(rhs_file, vec_rhs);
-    }
-
-    mat_file.close();
-    rhs_file.close();
 
     // Ensure matrix data is synced to the device before any GPU operations
     if (hw_backend == "CUDA" || hw_backend == "HIP")
@@ -278,15 +403,31 @@ int sysRefactor(int argc, char* argv[])
       A->syncData(memory::DEVICE);
       vec_rhs->syncData(memory::DEVICE);
     }
+    helper.setValuesChanged();
+    RESOLVE_RANGE_POP("File input");
 
     std::cout << "CSR matrix loaded. Expanded NNZ: " << A->getNnz() << std::endl;
     printSystemInfo(matrix_pathname_full, A);
 
-    // Now call direct solver
-    if (i == 0)
+    // Choose the cheapest valid factorization path for this system
+    bool is_new_pattern = fingerprint.update(A);
+    is_refactorized     = false;
+    if (is_new_pattern)
     {
-      // Set matrix in solver after the initial matrix is loaded
-      status = solver.setMatrix(A);
+      if (i > 0)
+      {
+        std::cout << "Sparsity pattern changed, redoing symbolic analysis.\n";
+      }
+
+      // Start from a fresh solver if refactorization was set up before
+      if (is_refactorization_used)
+      {
+        createSolver();
+        is_refactorization_used = false;
+      }
+
+      // Set matrix in solver after the matrix with a new pattern is loaded
+      status = solver->setMatrix(A);
       if (status != 0)
       {
         std::cout << "Failed to set matrix in solver. Status: " << status << std::endl;
@@ -294,41 +435,91 @@ int sysRefactor(int argc, char* argv[])
       }
 
       // Analysis (symbolic factorization)
-      status = solver.analyze();
+      status = solver->analyze();
       std::cout << "Analysis on the host status: " << status << std::endl;
 
       // Numeric factorization on the host
-      status = solver.factorize();
+      status = solver->factorize();
       std::cout << "Numeric factorization on the host status: " << status << std::endl;
+
+      is_refactorization_setup = false;
     }
-    else if (i == 1)
+    else if (!is_refactorization_setup)
     {
+      if (is_refactorization_used)
+      {
+        // A previous setup failed, so start over on a new solver
+        createSolver();
+        status = solver->setMatrix(A);
+        if (status != 0)
+        {
+          std::cout << "Failed to set matrix in solver. Status: " << status << std::endl;
+          return 1;
+        }
+        status = solver->analyze();
+        std::cout << "Analysis on the host status: " << status << std::endl;
+      }
+
       // Numeric factorization on the host
-      status = solver.factorize();
+      status = solver->factorize();
       std::cout << "Numeric factorization on the host status: " << status << std::endl;
+      if (status != 0)
+      {
+        // Symbolic analysis is no longer adequate, redo it
+        status = solver->analyze();
+        std::cout << "Analysis on the host status: " << status << std::endl;
+        status = solver->factorize();
+        std::cout << "Numeric factorization on the host status: " << status << std::endl;
+      }
 
       // Set up refactorization solver
-      status = solver.refactorizationSetup();
+      status = solver->refactorizationSetup();
       std::cout << "Refactorization setup status: " << status << std::endl;
+      is_refactorization_setup = (status == 0);
+      is_refactorization_used  = true;
     }
     else
     {
       // Refactorize on the device
-      status = solver.refactorize();
+      status = solver->refactorize();
       std::cout << "Refactorization on the device status: " << status << std::endl;
+      is_refactorized = (status == 0);
+      if (status != 0)
+      {
+        // Pivoting needs to be redone. The new solver has no symbolic
+        // analysis, since SystemSolver does not expose its KLU solver.
+        std::cout << "Refactorization failed, redoing factorization.\n";
+        createSolver();
+        status = solver->setMatrix(A);
+        if (status != 0)
+        {
+          std::cout << "Failed to set matrix in solver. Status: " << status << std::endl;
+          return 1;
+        }
+        status = solver->analyze();
+        std::cout << "Analysis on the host status: " << status << std::endl;
+        status = solver->factorize();
+        std::cout << "Numeric factorization on the host status: " << status << std::endl;
+        status = solver->refactorizationSetup();
+        std::cout << "Refactorization setup status: " << status << std::endl;
+        is_refactorization_setup = (status == 0);
+      }
     }
 
-    status = solver.solve(vec_rhs, vec_x);
+    RESOLVE_RANGE_PUSH("Triangular solve");
+    status = solver->solve(vec_rhs, vec_x);
     std::cout << "Triangular solve status: " << status << std::endl;
+    RESOLVE_RANGE_POP("Triangular solve");
 
     // Print summary of results
     helper.resetSystem(A, vec_rhs, vec_x);
     helper.printShortSummary();
-    if ((i > 1) && is_iterative_refinement)
+    if (is_refactorized && is_iterative_refinement)
     {
-      helper.printIrSummary(&(solver.getIterativeSolver()));
+      helper.printIrSummary(&(solver->getIterativeSolver()));
     }
-  }
+  } // for (int i = 0; i < num_systems; ++i)
+  RESOLVE_RANGE_POP(__FUNCTION__);
 
   // Delete objects created on heap
   delete A;
@@ -10,6 +10,20 @@ echo ${ReSolve_DIR}
 export DATA_DIR=${2}
 echo ${DATA_DIR}
 
+# Optional comma-separated backends of performance regression tests (e.g. cpu,cuda)
+export PERF_BACKENDS=${3}
+
+# Optional "update" stores performance test results as new baselines
+export PERF_MODE=${4}
+
+PERF_OPTIONS=""
+if [ -n "${PERF_BACKENDS}" ]; then
+  PERF_OPTIONS="-DRESOLVE_PERF_BACKENDS=${PERF_BACKENDS}"
+  if [ "${PERF_MODE}" == "update" ]; then
+    PERF_OPTIONS="${PERF_OPTIONS} -DRESOLVE_PERF_UPDATE_BASELINES=ON"
+  fi
+fi
+
 # Locate source of the consumer test app
 export INSTALL_BUILD_CONSUME=${ReSolve_DIR}/share/examples/resolve_consumer
 echo ${INSTALL_BUILD_CONSUME}
@@ -18,7 +32,7 @@ mkdir -p ${INSTALL_BUILD_CONSUME}/build
 
 rm -rf ${INSTALL_BUILD_CONSUME}/build/* &&
 
-cmake -B ${INSTALL_BUILD_CONSUME}/build -S ${INSTALL_BUILD_CONSUME} -DRESOLVE_DATA=${DATA_DIR} -DReSolve_DIR=${ReSolve_DIR} &&
+cmake -B ${INSTALL_BUILD_CONSUME}/build -S ${INSTALL_BUILD_CONSUME} -DRESOLVE_DATA=${DATA_DIR} -DReSolve_DIR=${ReSolve_DIR} ${PERF_OPTIONS} &&
 
 cmake --build ${INSTALL_BUILD_CONSUME}/build -- -j 12 &&
 